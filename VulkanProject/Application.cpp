@@ -1,73 +1,244 @@
 #include "Application.h"
 
 #include "SimpleRenderSystem.h"
+#include "IndirectRenderSystem.h"
+#include "ClusterRenderSystem.h"
+#include "ShaderReloader.h"
+#include "Profiler.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <algorithm>
+#include <iostream>
 #include <stdexcept>
 #include <array>
 #include <cassert>
 
-Application::Application()
+Application::Application(const Settings& settings)
+	: m_Settings(settings),
+	m_JobSystem(settings.jobThreads, settings.pinThreads),
+	m_Window(settings.headless ? nullptr : std::make_unique<Window>(settings.width, settings.height, NAME)),
+	m_Device(m_Window.get())
 {
+	if (m_Settings.headless) {
+		m_Renderer = std::make_unique<Renderer>(m_Device, VkExtent2D{ m_Settings.width, m_Settings.height }, m_Settings.framesInFlight);
+	}
+	else {
+		m_Renderer = std::make_unique<Renderer>(*m_Window, m_Device, m_Settings.framesInFlight);
+	}
+
+	if (m_Settings.parallelRecord) {
+		m_Renderer->setRecordingThreadCount(m_JobSystem.workerCount());
+	}
+
 	m_LoadObjects();
+	m_StreamModels();
+	m_Device.allocator().printStats();
 }
 
 Application::~Application(){}
 
 void Application::run()
 {
-	SimpleRenderSystem simpleRenderSystem{ m_Device, m_Renderer.getSwapChainRenderPass() };
+	PROFILE_FUNCTION();
+	Profiler::setThreadName("Main");
+
+	// Declared before the systems so they unwatch it before it goes
+	std::unique_ptr<ShaderReloader> shaderReloader;
+	if (m_Settings.hotReload) {
+		shaderReloader = std::make_unique<ShaderReloader>(m_Device);
+	}
+	SimpleRenderSystem simpleRenderSystem{ m_Device, m_Renderer->getSwapChainRenderPass() };
+	IndirectRenderSystem indirectRenderSystem{ m_Device, m_Renderer->getSwapChainRenderPass(), m_Renderer->getFrameCount() };
+	simpleRenderSystem.setLodErrorPixels(m_Settings.lodErrorPixels);
+	indirectRenderSystem.setLodErrorPixels(m_Settings.lodErrorPixels);
+	// Models with meshlets are left to the cluster system, the rest still go through the other two
+	std::unique_ptr<ClusterRenderSystem> clusterRenderSystem;
+	if (m_Settings.meshlets != "off") {
+		clusterRenderSystem = std::make_unique<ClusterRenderSystem>(m_Device, m_Renderer->getSwapChainRenderPass(), m_Renderer->getFrameCount(),
+			m_Settings.meshlets == "mesh", m_Settings.backfaceCulling);
+		simpleRenderSystem.setSkipMeshletModels(true);
+		indirectRenderSystem.setSkipMeshletModels(true);
+	}
+	if (shaderReloader) {
+		simpleRenderSystem.enableHotReload(*shaderReloader);
+		indirectRenderSystem.enableHotReload(*shaderReloader);
+		if (clusterRenderSystem) {
+			clusterRenderSystem->enableHotReload(*shaderReloader);
+		}
+	}
+	uint32_t framesRendered = 0;
 
-	while (!m_Window.shouldClose())
+	m_Simulation.reset(m_Scene);
+	JobSystem::Counter simulationDone;
+	auto lastFrameTime = std::chrono::steady_clock::now();
+
+	while (!m_ShouldClose(framesRendered))
 	{
-		glfwPollEvents();
+		PROFILE_SCOPE("Frame");
+		if (m_Window) {
+			glfwPollEvents();
+			m_HandleTraceKey();
+		}
 
-		if (VkCommandBuffer commandBuffer = m_Renderer.beginFrame()) {
-			m_Renderer.beginSwapChainRenderPass(commandBuffer);
-			simpleRenderSystem.renderObjects(commandBuffer, m_Objects);
-			m_Renderer.endSwapChainRenderPass(commandBuffer);
-			m_Renderer.endFrame();
+		auto now = std::chrono::steady_clock::now();
+		float frameTime = std::min(std::chrono::duration<float>(now - lastFrameTime).count(), MAX_FRAME_TIME);
+		lastFrameTime = now;
+		// Headless runs step once per frame so captures do not depend on how fast the machine is
+		if (m_Settings.headless) {
+			frameTime = Simulation::FIXED_TIMESTEP;
+		}
+
+		// Pipelined: the steps started last frame finish here, then the next ones run on the job
+		// system while this frame records from the interpolated copy. Rendering trails by one frame.
+		m_JobSystem.wait(simulationDone);
+		// Streamed models join the scene here, while no step is running
+		if (m_AssetLoader.update() > 0) {
+			m_Simulation.writeBack(m_Scene);
+			m_Simulation.reset(m_Scene);
+		}
+		m_Simulation.interpolate(m_Transforms);
+		// Rebuilt pipelines are swapped in between frames, never while one is being recorded
+		if (shaderReloader) {
+			shaderReloader->update();
+		}
+		m_JobSystem.schedule([this, frameTime] { m_Simulation.advance(frameTime); }, &simulationDone);
+
+		if (VkCommandBuffer commandBuffer = m_Renderer->beginFrame()) {
+			FrameInfo frameInfo{ m_Renderer->getFrameIndex(), commandBuffer, m_Renderer->getCurrentFrameContext(), m_Renderer->getExtent() };
+			GpuProfiler& gpuProfiler = m_Renderer->getGpuProfiler();
+			const std::vector<RenderableComponent>& renderables = m_Scene.pool<RenderableComponent>().components();
+			bool gpuDriven = renderables.size() >= GPU_DRIVEN_OBJECT_THRESHOLD;
+
+			// Culling is a compute dispatch so it has to be recorded before the render pass begins
+			if (gpuDriven) {
+				GpuProfiler::Scope scope{ gpuProfiler, commandBuffer, "Cull" };
+				indirectRenderSystem.cullObjects(frameInfo, renderables, m_Transforms);
+			}
+			if (clusterRenderSystem) {
+				GpuProfiler::Scope scope{ gpuProfiler, commandBuffer, "ClusterCull" };
+				clusterRenderSystem->cullClusters(frameInfo, renderables, m_Transforms);
+			}
+
+			// Timestamps cannot be written inside a pass that only executes secondary buffers
+			bool recordParallel = m_Settings.parallelRecord && !gpuDriven && !clusterRenderSystem;
+			m_Renderer->beginSwapChainRenderPass(commandBuffer,
+				recordParallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+			if (gpuDriven) {
+				GpuProfiler::Scope scope{ gpuProfiler, commandBuffer, "IndirectRenderSystem" };
+				indirectRenderSystem.renderObjects(frameInfo);
+			}
+			else if (recordParallel) {
+				simpleRenderSystem.renderObjectsParallel(frameInfo, renderables, m_Transforms, m_JobSystem);
+			}
+			else {
+				GpuProfiler::Scope scope{ gpuProfiler, commandBuffer, "SimpleRenderSystem" };
+				simpleRenderSystem.renderObjects(frameInfo, renderables, m_Transforms);
+			}
+			if (clusterRenderSystem) {
+				GpuProfiler::Scope scope{ gpuProfiler, commandBuffer, "ClusterRenderSystem" };
+				clusterRenderSystem->renderClusters(frameInfo);
+			}
+			m_Renderer->endSwapChainRenderPass(commandBuffer);
+			if (clusterRenderSystem) {
+				clusterRenderSystem->finishFrame(frameInfo);
+			}
+
+			// Read back the final frame of a headless run
+			if (!m_Settings.capturePath.empty() && framesRendered + 1 == m_Settings.frameCount) {
+				m_Renderer->captureNextFrame(m_Settings.capturePath);
+			}
+			m_Renderer->endFrame();
+
+			if (framesRendered == 0) {
+				auto timeToFirstFrame = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_StartTime).count();
+				std::cout << "Time to first frame: " << timeToFirstFrame << " ms" << std::endl;
+			}
+			framesRendered++;
 		}
 	}
 
+	m_JobSystem.wait(simulationDone);
 	vkDeviceWaitIdle(m_Device.device());
+	m_Renderer->getGpuProfiler().printStats();
+	m_Renderer->printResizeStats();
+	if (clusterRenderSystem) {
+		clusterRenderSystem->printStats();
+	}
+	if (!m_Settings.tracePath.empty()) {
+		Profiler::writeChromeTrace(m_Settings.tracePath);
+	}
 }
 
 void Application::m_LoadObjects()
 {
-	std::vector<Model::Vertex> vertices{
+	Model::Builder builder{};
+	builder.loadVertices({
 		{ { 0.0f, -0.5f }, { 1.0f, 0.0f, 0.0f }},
 		{ { 0.5f, 0.5f }, { 0.0f, 1.0f, 0.0f }},
 		{ { -0.5f, 0.5f }, { 0.0f, 0.0f, 1.0f }}
-	};
-	std::shared_ptr<Model> model = std::make_shared<Model>(m_Device, vertices);
-
-	Object triangle = Object::createObject();
-	triangle.model = model;
-	triangle.colour = { 0.1f, 0.8f, 0.1f };
-	triangle.transfrom2D.translation.x = 0.2f;
-	triangle.transfrom2D.scale = { 2.0f, 0.5f };
-	triangle.transfrom2D.rotation = 0.25f * glm::two_pi<float>();   // 2pi = 360 degree rotation -> 0.25f * 360 = 90 degrees
-
-	Object triangle2 = Object::createObject();
-	triangle2.model = model;
-	triangle2.colour = { 0.8f, 0.1f, 0.1f };
-	triangle2.transfrom2D.translation.x = -0.2f;
-	triangle2.transfrom2D.scale = { 1.1f, 0.5f };
-	triangle2.transfrom2D.rotation = 0.5f * glm::two_pi<float>();
-
-	Object triangle3 = Object::createObject();
-	triangle3.model = model;
-	triangle3.colour = { 0.1f, 0.1f, 0.8f };
-	triangle3.transfrom2D.translation.x = -0.7f;
-	triangle3.transfrom2D.scale = { 0.5f, 0.5f };
-	triangle3.transfrom2D.rotation = 0.75f * glm::two_pi<float>();
-	
-	m_Objects.push_back(std::move(triangle));
-	m_Objects.push_back(std::move(triangle2));
-	m_Objects.push_back(std::move(triangle3));
+	});
+	std::shared_ptr<Model> model = std::make_shared<Model>(m_Device, builder);
+
+	Entity triangle = m_Scene.create();
+	m_Scene.add<RenderableComponent>(triangle, { model, { 0.1f, 0.8f, 0.1f } });
+	Transform2DComponent& transform = m_Scene.add<Transform2DComponent>(triangle);
+	transform.translation.x = 0.2f;
+	transform.scale = { 2.0f, 0.5f };
+	transform.rotation = 0.25f * glm::two_pi<float>();   // 2pi = 360 degree rotation -> 0.25f * 360 = 90 degrees
+	m_Scene.add<VelocityComponent>(triangle).angular = TRIANGLE_SPIN;
+
+	Entity triangle2 = m_Scene.create();
+	m_Scene.add<RenderableComponent>(triangle2, { model, { 0.8f, 0.1f, 0.1f } });
+	Transform2DComponent& transform2 = m_Scene.add<Transform2DComponent>(triangle2);
+	transform2.translation.x = -0.2f;
+	transform2.scale = { 1.1f, 0.5f };
+	transform2.rotation = 0.5f * glm::two_pi<float>();
+	m_Scene.add<VelocityComponent>(triangle2).angular = TRIANGLE_SPIN;
+
+	Entity triangle3 = m_Scene.create();
+	m_Scene.add<RenderableComponent>(triangle3, { model, { 0.1f, 0.1f, 0.8f } });
+	Transform2DComponent& transform3 = m_Scene.add<Transform2DComponent>(triangle3);
+	transform3.translation.x = -0.7f;
+	transform3.scale = { 0.5f, 0.5f };
+	transform3.rotation = 0.75f * glm::two_pi<float>();
+	m_Scene.add<VelocityComponent>(triangle3).angular = TRIANGLE_SPIN;
+}
+
+void Application::m_StreamModels()
+{
+	// Each file gets an entity now, it becomes renderable once the loader has its model on the GPU
+	const float slotWidth = LOADED_MODELS_WIDTH / std::max<size_t>(m_Settings.modelPaths.size(), 1);
+	for (size_t i = 0; i < m_Settings.modelPaths.size(); i++) {
+		Entity entity = m_Scene.create();
+		m_Scene.add<Transform2DComponent>(entity).translation.x = -0.5f * LOADED_MODELS_WIDTH + (i + 0.5f) * slotWidth;
+
+		m_AssetLoader.loadModel(m_Settings.modelPaths[i], [this, entity, slotWidth](std::shared_ptr<Model> model) {
+			// Fit the model into its slot whatever units it was authored in
+			const float scale = 0.5f * slotWidth / std::max(model->getBoundingRadius(), 1e-6f);
+			m_Scene.get<Transform2DComponent>(entity).scale = { scale, scale };
+			m_Scene.add<RenderableComponent>(entity, { std::move(model), { 1.0f, 1.0f, 1.0f } });
+		});
+	}
+}
+
+bool Application::m_ShouldClose(uint32_t framesRendered)
+{
+	if (m_Settings.frameCount > 0 && framesRendered >= m_Settings.frameCount) {
+		return true;
+	}
+	return m_Window && m_Window->shouldClose();
+}
+
+void Application::m_HandleTraceKey()
+{
+	// Dump once per press rather than every frame the key is held
+	bool keyDown = m_Window->isKeyPressed(GLFW_KEY_F12);
+	if (keyDown && !m_TraceKeyWasDown) {
+		Profiler::writeChromeTrace(m_Settings.tracePath.empty() ? DEFAULT_TRACE_FILE : m_Settings.tracePath);
+	}
+	m_TraceKeyWasDown = keyDown;
 }
@@ -3,9 +3,15 @@
 #include "Window.h"
 #include "Device.h"
 #include "Model.h"
-#include "Object.h"
+#include "Components.h"
+#include "Registry.h"
 #include "Renderer.h"
+#include "Settings.h"
+#include "JobSystem.h"
+#include "Simulation.h"
+#include "AssetLoader.h"
 
+#include <chrono>
 #include <memory>
 #include <vector>
 #include <utility>
@@ -13,7 +19,7 @@
 class Application
 {
 public:
-	Application();
+	Application(const Settings& settings);
 	~Application();
 
 	void run();
@@ -23,15 +29,35 @@ public:
 	Application& operator=(const Application&) = delete;
 
 private:
-	int WIDTH = 1920;
-	int HEIGHT = 1080;
-	static constexpr const char* NAME = "Vulkan Application";
+	// Declared first so it is set before the window, device and pipelines are created
+	std::chrono::steady_clock::time_point m_StartTime = std::chrono::steady_clock::now();
 
-	Window m_Window{ WIDTH, HEIGHT, NAME };
-	Device m_Device{ m_Window };
-	Renderer m_Renderer{ m_Window, m_Device };
-	std::vector<Object> m_Objects;
+	static constexpr const char* NAME = "Vulkan Application";
+	// Scenes with at least this many objects are culled and drawn on the GPU
+	static constexpr size_t GPU_DRIVEN_OBJECT_THRESHOLD = 1024;
+	// How fast the starting triangles spin, in radians per second
+	static constexpr float TRIANGLE_SPIN = 0.6f;
+	// Longest frame time fed to the simulation, e.g. after a breakpoint or a window drag
+	static constexpr float MAX_FRAME_TIME = 0.25f;
+	static constexpr const char* DEFAULT_TRACE_FILE = "cpu_trace.json";
+	// Fraction of the screen width a streamed model spans, shared between all of them
+	static constexpr float LOADED_MODELS_WIDTH = 1.6f;
+
+	Settings m_Settings;
+	JobSystem m_JobSystem;
+	Simulation m_Simulation{ m_JobSystem };
+	std::unique_ptr<Window> m_Window;		// Null when headless
+	Device m_Device;
+	std::unique_ptr<Renderer> m_Renderer;
+	AssetLoader m_AssetLoader{ m_Device };
+	Registry m_Scene;
+	TransformStore m_Transforms;		// Rendered transform of each renderable, only written by m_Simulation.interpolate
 
 	void m_LoadObjects();
+	void m_StreamModels();
+	bool m_ShouldClose(uint32_t framesRendered);
+	void m_HandleTraceKey();
+
+	bool m_TraceKeyWasDown = false;
 };
 
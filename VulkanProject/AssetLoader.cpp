@@ -0,0 +1,159 @@
+#include "AssetLoader.h"
+
+#include "MeshLoader.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include "Profiler.h"
+#include "VertexLayout.h"
+
+#include <iostream>
+#include <stdexcept>
+
+AssetLoader::AssetLoader(Device& device, VkDeviceSize uploadBudget)
+	: m_Device(device), m_UploadBudget(uploadBudget)
+{
+	m_Thread = std::thread(&AssetLoader::m_ParseLoop, this);
+}
+
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stopping = true;
+	}
+	m_Condition.notify_one();
+	m_Thread.join();
+}
+
+void AssetLoader::loadModel(const std::string& path, Callback onReady)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Requests.push_back({ path, std::move(onReady) });
+	}
+	m_PendingCount++;
+	m_Condition.notify_one();
+}
+
+uint32_t AssetLoader::update()
+{
+	PROFILE_FUNCTION();
+
+	// Start uploads for parsed models until this frame's budget is spent
+	VkDeviceSize uploadedBytes = 0;
+	while (uploadedBytes < m_UploadBudget) {
+		ParsedModel parsed;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (m_Parsed.empty()) {
+				break;
+			}
+			parsed = std::move(m_Parsed.front());
+			m_Parsed.pop_front();
+		}
+
+		if (parsed.error) {
+			m_PendingCount--;
+			try {
+				std::rethrow_exception(parsed.error);
+			}
+			catch (const std::exception& e) {
+				throw std::runtime_error("failed to load " + parsed.path + ": " + e.what());
+			}
+		}
+
+		std::shared_ptr<Model> model;
+		if (parsed.cache) {
+			const Model::MeshView mesh = parsed.cache->view();
+			uploadedBytes += VkDeviceSize(VertexLayout::active().stride()) * mesh.vertexCount + sizeof(uint32_t) * mesh.indexCount;
+			model = std::make_shared<Model>(m_Device, mesh);
+		}
+		else {
+			uploadedBytes += VkDeviceSize(VertexLayout::active().stride()) * parsed.builder.vertices.size() + sizeof(uint32_t) * parsed.builder.indices.size();
+			model = std::make_shared<Model>(m_Device, parsed.builder);
+		}
+		// The staging ring has copied the data by now, so the cache mapping can go
+		m_Uploading.push_back({ std::move(model), std::move(parsed.onReady) });
+	}
+
+	// Hand over every model whose copies have landed, so delivery follows upload completion rather than request order
+	uint32_t delivered = 0;
+	auto it = m_Uploading.begin();
+	while (it != m_Uploading.end()) {
+		if (it->model->isPending()) {
+			++it;
+			continue;
+		}
+		UploadingModel ready = std::move(*it);
+		it = m_Uploading.erase(it);
+		m_PendingCount--;
+		delivered++;
+		ready.onReady(std::move(ready.model));
+	}
+	return delivered;
+}
+
+void AssetLoader::m_ParseLoop()
+{
+	Profiler::setThreadName("Asset Loader");
+
+	while (true) {
+		Request request;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Condition.wait(lock, [&] { return m_Stopping || !m_Requests.empty(); });
+			if (m_Stopping) {
+				return;
+			}
+			request = std::move(m_Requests.front());
+			m_Requests.pop_front();
+		}
+
+		ParsedModel parsed;
+		parsed.path = request.path;
+		parsed.onReady = std::move(request.onReady);
+		try {
+			// A cache hit is held to the same check as a fresh parse
+			auto requireTriangles = [](size_t vertexCount, size_t indexCount) {
+				if (vertexCount < 3 || indexCount == 0) {
+					throw std::runtime_error("mesh has no triangles");
+				}
+			};
+
+			const uint64_t sourceHash = MeshCache::hashSource(request.path);
+			const std::string cachePath = MeshCache::cachePathFor(request.path);
+			parsed.cache = MeshCache::open(cachePath, sourceHash);
+			if (parsed.cache) {
+				requireTriangles(parsed.cache->header().vertexCount, parsed.cache->header().indexCount);
+			}
+			else {
+				PROFILE_SCOPE("Parse Mesh");
+				parsed.builder = MeshLoader::load(request.path);
+				requireTriangles(parsed.builder.vertices.size(), parsed.builder.indices.size());
+				// Cooked into the cache, so simplification, reordering and meshlets are only paid for on the first load
+				MeshSimplifier::generateLods(parsed.builder);
+				MeshOptimizer::optimize(parsed.builder);
+				MeshletBuilder::build(parsed.builder);
+				m_WriteCache(cachePath, sourceHash, parsed.builder);
+			}
+		}
+		catch (...) {
+			parsed.error = std::current_exception();
+		}
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Parsed.push_back(std::move(parsed));
+	}
+}
+
+void AssetLoader::m_WriteCache(const std::string& cachePath, uint64_t sourceHash, const Model::Builder& builder)
+{
+	// Only costs the next launch its fast path, e.g. when the asset folder is read-only
+	try {
+		MeshCache::write(cachePath, sourceHash, builder);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Mesh cache not written: " << e.what() << std::endl;
+	}
+}
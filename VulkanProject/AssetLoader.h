@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Device.h"
+#include "Model.h"
+#include "MeshCache.h"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streams models in without stalling the render loop. Files are parsed on a background thread, or mapped from their
+// MeshCache when one matches the source, then update()
+// creates the Models on the main thread, a few per frame, and hands each one over once its staging upload
+// has completed. Buffer creation and staging stay on the main thread since they share the graphics queue.
+class AssetLoader
+{
+public:
+	using Callback = std::function<void(std::shared_ptr<Model>)>;
+
+	// Bytes of vertex and index data turned into Models per update, at least one model is always started
+	static constexpr VkDeviceSize DEFAULT_UPLOAD_BUDGET = 8ull * 1024 * 1024;
+
+	AssetLoader(Device& device, VkDeviceSize uploadBudget = DEFAULT_UPLOAD_BUDGET);
+	~AssetLoader();
+
+	// Not copyable or movable
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	// Queues a file for loading, onReady runs inside a later update() once the model can be drawn
+	void loadModel(const std::string& path, Callback onReady);
+	// Call once per frame on the main thread. Returns how many callbacks ran, throws if a file failed to load
+	uint32_t update();
+	// Requests that have not reached their callback yet
+	size_t pendingCount() const { return m_PendingCount; }
+
+private:
+	struct Request {
+		std::string path;
+		Callback onReady;
+	};
+
+	struct ParsedModel {
+		std::string path;
+		Callback onReady;
+		Model::Builder builder;
+		std::unique_ptr<MeshCache> cache;		// Used instead of builder when set
+		std::exception_ptr error;
+	};
+
+	struct UploadingModel {
+		std::shared_ptr<Model> model;
+		Callback onReady;
+	};
+
+	Device& m_Device;
+	VkDeviceSize m_UploadBudget;
+	size_t m_PendingCount{ 0 };		// Only touched by the calling thread
+
+	// Shared with the parse thread
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	std::deque<Request> m_Requests;
+	std::deque<ParsedModel> m_Parsed;
+	bool m_Stopping{ false };
+
+	// Main thread only
+	std::vector<UploadingModel> m_Uploading;
+
+	std::thread m_Thread;
+
+	void m_ParseLoop();
+	static void m_WriteCache(const std::string& cachePath, uint64_t sourceHash, const Model::Builder& builder);
+};
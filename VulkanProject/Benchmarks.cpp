@@ -0,0 +1,704 @@
+#include "Benchmarks.h"
+
+#include "Window.h"
+#include "Device.h"
+#include "Renderer.h"
+#include "SimpleRenderSystem.h"
+#include "ThreadPool.h"
+#include "JobSystem.h"
+#include "Components.h"
+#include "Registry.h"
+#include "Simulation.h"
+#include "TransformStore.h"
+#include "MeshLoader.h"
+#include "MeshCache.h"
+#include "VertexLayout.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "StagingRing.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+	constexpr uint32_t RECORD_OBJECT_COUNT = 50000;
+	constexpr uint32_t RECORD_MODEL_COUNT = 8;
+	constexpr uint32_t WARMUP_FRAMES = 10;
+	constexpr uint32_t MEASURED_FRAMES = 100;
+
+	constexpr uint32_t JOB_TRANSFORM_COUNT = 1000000;
+	constexpr uint32_t JOB_GRAIN_SIZE = 1024;
+	constexpr uint32_t JOB_UNEVEN_TASKS = 4096;
+	constexpr uint32_t JOB_TINY_TASKS = 100000;
+	constexpr uint32_t JOB_REPEATS = 20;
+
+	constexpr uint32_t ECS_ENTITY_COUNT = 1000000;
+	constexpr uint32_t ECS_REPEATS = 10;
+
+	constexpr uint32_t TRANSFORM_COUNTS[] = { 1000, 100000, 1000000 };
+	constexpr uint32_t TRANSFORM_REPEATS = 50;
+
+	constexpr uint32_t MESH_GRID_SIZE = 512;
+	constexpr uint32_t MESH_REPEATS = 5;
+	constexpr const char* MESH_GRID_FILE = "meshcache_bench.obj";
+
+	constexpr const char* VERTEX_FORMAT_NAMES[] = { "float", "half", "snorm" };
+	constexpr uint32_t NORMAL_SAMPLES = 100000;
+
+	constexpr uint32_t RESIZE_FRAMES = 300;
+	// The window swings between 50% and 100% of --width and --height over this many frames
+	constexpr float RESIZE_PERIOD_FRAMES = 60.0f;
+
+	// Small enough to leave the drained tail early in the ring, then too big for the space after it
+	constexpr VkDeviceSize STAGING_DRAIN_SIZE = 1024 * 1024;
+	constexpr VkDeviceSize STAGING_WRAP_SIZE = StagingRing::DEFAULT_CAPACITY - 512 * 1024;
+	constexpr auto STAGING_TIMEOUT = std::chrono::seconds(10);
+
+	template <typename Func>
+	float averageMs(uint32_t repeats, Func&& func)
+	{
+		func();
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < repeats; i++) {
+			func();
+		}
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+	}
+
+	// Task i costs roughly (i % 64)^2 sin calls, so equal task counts per thread are not equal work
+	float unevenTask(uint32_t task)
+	{
+		const uint32_t iterations = (task % 64) * (task % 64);
+		float value = 0.0f;
+		for (uint32_t i = 0; i < iterations; i++) {
+			value += std::sin(static_cast<float>(i + task));
+		}
+		return value;
+	}
+
+	// Writes a MESH_GRID_SIZE^2 quad grid, about 260k vertices, as a stand-in for a large asset
+	void writeGridObj(const std::string& path)
+	{
+		std::ofstream file{ path };
+		const uint32_t side = MESH_GRID_SIZE + 1;
+		for (uint32_t y = 0; y < side; y++) {
+			for (uint32_t x = 0; x < side; x++) {
+				file << "v " << float(x) / MESH_GRID_SIZE - 0.5f << ' ' << float(y) / MESH_GRID_SIZE - 0.5f << " 0 "
+					<< float(x) / MESH_GRID_SIZE << ' ' << float(y) / MESH_GRID_SIZE << " 0.5\n";
+			}
+		}
+		for (uint32_t y = 0; y < MESH_GRID_SIZE; y++) {
+			for (uint32_t x = 0; x < MESH_GRID_SIZE; x++) {
+				const uint32_t corner = y * side + x + 1;
+				file << "f " << corner << ' ' << corner + 1 << ' ' << corner + side + 1 << ' ' << corner + side << '\n';
+			}
+		}
+	}
+
+	void printMeshStats(const char* label, const MeshOptimizer::Stats& stats, float ms)
+	{
+		std::printf("  %-22s %8.3f %8.3f %10.3f %10.3f %10.2f\n", label, stats.acmr, stats.atvr, stats.overfetch, stats.overdraw, ms);
+	}
+
+	void createScene(Device& device, std::vector<RenderableComponent>& objects, TransformStore& transforms)
+	{
+		std::vector<std::shared_ptr<Model>> models;
+		for (uint32_t i = 0; i < RECORD_MODEL_COUNT; i++) {
+			Model::Builder builder{};
+			builder.loadVertices({
+				{ { 0.0f, -0.01f }, { 1.0f, 0.0f, 0.0f }},
+				{ { 0.01f, 0.01f }, { 0.0f, 1.0f, 0.0f }},
+				{ { -0.01f, 0.01f }, { 0.0f, 0.0f, 1.0f }}
+			});
+			models.push_back(std::make_shared<Model>(device, builder));
+		}
+
+		objects.resize(RECORD_OBJECT_COUNT);
+		transforms.resize(RECORD_OBJECT_COUNT);
+		for (uint32_t i = 0; i < RECORD_OBJECT_COUNT; i++) {
+			objects[i].model = models[i % RECORD_MODEL_COUNT];
+			objects[i].colour = { 0.1f, 0.8f, 0.1f };
+
+			Transform2DComponent transform{};
+			transform.translation = { (i % 200) / 100.0f - 1.0f, (i / 200 % 200) / 100.0f - 1.0f };
+			transform.rotation = (i % 360) / 360.0f * glm::two_pi<float>();
+			transforms.set(i, transform);
+		}
+	}
+
+	struct FrameTimes {
+		double averageMs = 0.0;
+		double p99Ms = 0.0;
+		double maxMs = 0.0;
+	};
+
+	FrameTimes summarizeFrameTimes(std::vector<double> frameMs)
+	{
+		FrameTimes times{};
+		if (frameMs.empty()) {
+			return times;
+		}
+		std::sort(frameMs.begin(), frameMs.end());
+		for (double ms : frameMs) {
+			times.averageMs += ms;
+		}
+		times.averageMs /= frameMs.size();
+		times.p99Ms = frameMs[std::min(frameMs.size() - 1, frameMs.size() * 99 / 100)];
+		times.maxMs = frameMs.back();
+		return times;
+	}
+
+	// Average milliseconds spent in record, which must fill the pass started with contents
+	float measureRecording(Renderer& renderer, VkSubpassContents contents, const std::function<void(FrameInfo&)>& record)
+	{
+		double totalMs = 0.0;
+		for (uint32_t frame = 0; frame < WARMUP_FRAMES + MEASURED_FRAMES; frame++) {
+			VkCommandBuffer commandBuffer = renderer.beginFrame();
+			FrameInfo frameInfo{ renderer.getFrameIndex(), commandBuffer, renderer.getCurrentFrameContext(), renderer.getExtent() };
+			renderer.beginSwapChainRenderPass(commandBuffer, contents);
+
+			auto start = std::chrono::steady_clock::now();
+			record(frameInfo);
+			auto end = std::chrono::steady_clock::now();
+
+			renderer.endSwapChainRenderPass(commandBuffer);
+			renderer.endFrame();
+
+			if (frame >= WARMUP_FRAMES) {
+				totalMs += std::chrono::duration<double, std::milli>(end - start).count();
+			}
+		}
+		return static_cast<float>(totalMs / MEASURED_FRAMES);
+	}
+}
+
+int Benchmarks::run(const Settings& settings)
+{
+	if (settings.benchmark == "record") {
+		recordScaling(settings);
+		return EXIT_SUCCESS;
+	}
+	if (settings.benchmark == "jobs") {
+		jobScheduling(settings);
+		return EXIT_SUCCESS;
+	}
+	if (settings.benchmark == "ecs") {
+		entityIteration(settings);
+		return EXIT_SUCCESS;
+	}
+	if (settings.benchmark == "transforms") {
+		transformBuilding(settings);
+		return EXIT_SUCCESS;
+	}
+	if (settings.benchmark == "meshcache") {
+		meshCacheLoading(settings);
+		return EXIT_SUCCESS;
+	}
+	if (settings.benchmark == "vertexformats") {
+		vertexFormats(settings);
+		return EXIT_SUCCESS;
+	}
+	if (settings.benchmark == "meshopt") {
+		meshOptimization(settings);
+		return EXIT_SUCCESS;
+	}
+	if (settings.benchmark == "lod") {
+		lodGeneration(settings);
+		return EXIT_SUCCESS;
+	}
+	if (settings.benchmark == "resize") {
+		resizeStorm(settings);
+		return EXIT_SUCCESS;
+	}
+	if (settings.benchmark == "staging") {
+		return stagingRingWrap() ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	std::cout << "Unknown benchmark: " << settings.benchmark << std::endl;
+	Settings::printUsage();
+	return EXIT_FAILURE;
+}
+
+void Benchmarks::recordScaling(const Settings& settings)
+{
+	Device device{ nullptr };
+	Renderer renderer{ device, VkExtent2D{ settings.width, settings.height }, settings.framesInFlight };
+	SimpleRenderSystem renderSystem{ device, renderer.getSwapChainRenderPass() };
+	// One draw per object so there is enough recording work to split
+	renderSystem.setMinInstancedBatch(UINT32_MAX);
+	std::vector<RenderableComponent> objects;
+	TransformStore transforms;
+	createScene(device, objects, transforms);
+
+	const uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::cout << "Recording " << RECORD_OBJECT_COUNT << " draws, average of " << MEASURED_FRAMES << " frames\n";
+
+	const float inlineMs = measureRecording(renderer, VK_SUBPASS_CONTENTS_INLINE, [&](FrameInfo& frameInfo) {
+		renderSystem.renderObjects(frameInfo, objects, transforms);
+	});
+	std::printf("  %-8s %14s %10s %14s %10s\n", "threads", "thread pool ms", "speedup", "job system ms", "speedup");
+	std::printf("  %-8s %14.3f\n", "inline", inlineMs);
+
+	float singleThreadMs = 0.0f;
+	for (uint32_t threadCount = 1; threadCount <= maxThreads; threadCount++) {
+		renderer.setRecordingThreadCount(threadCount);
+
+		ThreadPool threadPool{ threadCount };
+		const float poolMs = measureRecording(renderer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, [&](FrameInfo& frameInfo) {
+			renderSystem.renderObjectsParallel(frameInfo, objects, transforms, threadPool);
+		});
+		if (threadCount == 1) {
+			singleThreadMs = poolMs;
+			std::printf("  %-8u %14.3f %9.2fx\n", threadCount, poolMs, 1.0f);
+			continue;
+		}
+
+		// The main thread is one of the job system's workers
+		JobSystem jobSystem{ threadCount - 1, settings.pinThreads };
+		const float jobMs = measureRecording(renderer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, [&](FrameInfo& frameInfo) {
+			renderSystem.renderObjectsParallel(frameInfo, objects, transforms, jobSystem);
+		});
+		std::printf("  %-8u %14.3f %9.2fx %14.3f %9.2fx\n", threadCount, poolMs, singleThreadMs / poolMs, jobMs, singleThreadMs / jobMs);
+	}
+}
+
+void Benchmarks::jobScheduling(const Settings& settings)
+{
+	std::vector<Transform2DComponent> transforms(JOB_TRANSFORM_COUNT);
+	std::vector<glm::mat2> matrices(JOB_TRANSFORM_COUNT);
+	for (uint32_t i = 0; i < JOB_TRANSFORM_COUNT; i++) {
+		transforms[i].rotation = (i % 360) / 360.0f * glm::two_pi<float>();
+	}
+	std::vector<float> unevenResults(JOB_UNEVEN_TASKS);
+	std::atomic<uint32_t> tinyTasksRun{ 0 };
+
+	auto transformRange = [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			matrices[i] = transforms[i].mat2();
+		}
+	};
+	const uint32_t transformChunks = (JOB_TRANSFORM_COUNT + JOB_GRAIN_SIZE - 1) / JOB_GRAIN_SIZE;
+
+	const uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 2u);
+	std::cout << "Average of " << JOB_REPEATS << " runs, ms (thread pool / job system)\n";
+	std::printf("  %-8s %20s %20s %20s\n", "threads", "1M transforms", "4096 uneven tasks", "100k tiny tasks");
+
+	for (uint32_t threadCount = 2; threadCount <= maxThreads; threadCount++) {
+		ThreadPool threadPool{ threadCount };
+		const float poolTransformMs = averageMs(JOB_REPEATS, [&] {
+			threadPool.run(transformChunks, [&](uint32_t chunk, uint32_t) {
+				transformRange(size_t(chunk) * JOB_GRAIN_SIZE, std::min<size_t>(size_t(chunk + 1) * JOB_GRAIN_SIZE, JOB_TRANSFORM_COUNT));
+			});
+		});
+		const float poolUnevenMs = averageMs(JOB_REPEATS, [&] {
+			threadPool.run(JOB_UNEVEN_TASKS, [&](uint32_t task, uint32_t) { unevenResults[task] = unevenTask(task); });
+		});
+		const float poolTinyMs = averageMs(JOB_REPEATS, [&] {
+			threadPool.run(JOB_TINY_TASKS, [&](uint32_t, uint32_t) { tinyTasksRun.fetch_add(1, std::memory_order_relaxed); });
+		});
+
+		JobSystem jobSystem{ threadCount - 1, settings.pinThreads };
+		const float jobTransformMs = averageMs(JOB_REPEATS, [&] {
+			jobSystem.parallelFor(JOB_TRANSFORM_COUNT, JOB_GRAIN_SIZE, transformRange);
+		});
+		const float jobUnevenMs = averageMs(JOB_REPEATS, [&] {
+			jobSystem.parallelFor(JOB_UNEVEN_TASKS, 1, [&](size_t begin, size_t) {
+				unevenResults[begin] = unevenTask(static_cast<uint32_t>(begin));
+			});
+		});
+		const float jobTinyMs = averageMs(JOB_REPEATS, [&] {
+			jobSystem.parallelFor(JOB_TINY_TASKS, 1, [&](size_t, size_t) { tinyTasksRun.fetch_add(1, std::memory_order_relaxed); });
+		});
+
+		std::printf("  %-8u %9.3f / %-8.3f %9.3f / %-8.3f %9.3f / %-8.3f\n", threadCount,
+			poolTransformMs, jobTransformMs, poolUnevenMs, jobUnevenMs, poolTinyMs, jobTinyMs);
+	}
+}
+
+void Benchmarks::transformBuilding(const Settings& settings)
+{
+	std::cout << "Building 2D instance transforms, " << TransformStore::simdName() << " against per-object mat2()\n";
+	std::printf("  %-10s %12s %12s %12s %10s %12s\n", "count", "mat2 ns", "scalar ns", "simd ns", "speedup", "max error");
+
+	for (uint32_t count : TRANSFORM_COUNTS) {
+		std::vector<Transform2DComponent> components(count);
+		TransformStore store;
+		store.resize(count);
+		for (uint32_t i = 0; i < count; i++) {
+			components[i].translation = { (i % 200) / 100.0f - 1.0f, (i / 200 % 200) / 100.0f - 1.0f };
+			components[i].scale = { 0.5f + (i % 7) * 0.1f, 0.5f + (i % 5) * 0.1f };
+			components[i].rotation = (i % 3600) / 3600.0f * glm::two_pi<float>();
+			store.set(i, components[i]);
+		}
+
+		// Same destination layout as the instance buffer so the stores are comparable
+		std::vector<SimpleRenderSystem::InstanceData> reference(count);
+		std::vector<SimpleRenderSystem::InstanceData> simd(count);
+
+		const float objectMs = averageMs(TRANSFORM_REPEATS, [&] {
+			for (uint32_t i = 0; i < count; i++) {
+				reference[i].transform = components[i].mat2();
+				reference[i].offset = components[i].translation;
+			}
+		});
+		const float scalarMs = averageMs(TRANSFORM_REPEATS, [&] {
+			store.buildMatricesScalar(0, count, reference.data(), sizeof(SimpleRenderSystem::InstanceData));
+		});
+		const float simdMs = averageMs(TRANSFORM_REPEATS, [&] {
+			store.buildMatrices(0, count, simd.data(), sizeof(SimpleRenderSystem::InstanceData));
+		});
+
+		float maxError = 0.0f;
+		for (uint32_t i = 0; i < count; i++) {
+			const glm::mat2 difference = simd[i].transform - reference[i].transform;
+			maxError = std::max({ maxError, glm::abs(difference[0].x), glm::abs(difference[0].y), glm::abs(difference[1].x), glm::abs(difference[1].y) });
+		}
+
+		const float toNs = 1000000.0f / count;
+		std::printf("  %-10u %12.2f %12.2f %12.2f %9.2fx %12.3g\n", count,
+			objectMs * toNs, scalarMs * toNs, simdMs * toNs, objectMs / simdMs, maxError);
+	}
+}
+
+void Benchmarks::entityIteration(const Settings& settings)
+{
+	Registry registry;
+	std::vector<Entity> entities;
+	entities.reserve(ECS_ENTITY_COUNT);
+
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < ECS_ENTITY_COUNT; i++) {
+		Entity entity = registry.create();
+		registry.add<Transform2DComponent>(entity).rotation = (i % 360) / 360.0f * glm::two_pi<float>();
+		// Every other entity moves, so the two-component view has to skip half of the transforms
+		if (i % 2 == 0) {
+			registry.add<VelocityComponent>(entity, { { 0.01f, 0.0f }, 0.5f });
+		}
+		entities.push_back(entity);
+	}
+	const float createMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	ComponentPool<Transform2DComponent>& transforms = registry.pool<Transform2DComponent>();
+	const float denseMs = averageMs(ECS_REPEATS, [&] {
+		for (Transform2DComponent& transform : transforms.components()) {
+			transform.rotation += 0.001f;
+		}
+	});
+	const float viewMs = averageMs(ECS_REPEATS, [&] {
+		registry.each<VelocityComponent, Transform2DComponent>([](Entity, VelocityComponent& velocity, Transform2DComponent& transform) {
+			transform.translation += velocity.linear * Simulation::FIXED_TIMESTEP;
+			transform.rotation += velocity.angular * Simulation::FIXED_TIMESTEP;
+		});
+	});
+	const float lookupMs = averageMs(ECS_REPEATS, [&] {
+		for (Entity entity : entities) {
+			registry.get<Transform2DComponent>(entity).rotation += 0.001f;
+		}
+	});
+
+	// Destroy every third entity and create replacements, reusing the freed slots
+	start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < ECS_ENTITY_COUNT; i += 3) {
+		registry.destroy(entities[i]);
+	}
+	for (uint32_t i = 0; i < ECS_ENTITY_COUNT; i += 3) {
+		Entity entity = registry.create();
+		registry.add<Transform2DComponent>(entity);
+		entities[i] = entity;
+	}
+	const float churnMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	const uint32_t churned = (ECS_ENTITY_COUNT + 2) / 3;
+	const float toNs = 1000000.0f / ECS_ENTITY_COUNT;
+	std::cout << ECS_ENTITY_COUNT << " entities, " << registry.pool<VelocityComponent>().size() << " with velocity\n";
+	std::printf("  %-34s %10.2f ms %8.2f ns/entity\n", "create with components", createMs, createMs * toNs);
+	std::printf("  %-34s %10.2f ms %8.2f ns/entity\n", "iterate Transform dense array", denseMs, denseMs * toNs);
+	std::printf("  %-34s %10.2f ms %8.2f ns/entity\n", "view<Velocity, Transform>", viewMs, viewMs * toNs);
+	std::printf("  %-34s %10.2f ms %8.2f ns/entity\n", "get<Transform> by handle", lookupMs, lookupMs * toNs);
+	std::printf("  %-34s %10.2f ms %8.2f ns/entity\n", "destroy + recreate a third", churnMs, churnMs * 1000000.0f / churned);
+}
+
+void Benchmarks::meshCacheLoading(const Settings& settings)
+{
+	std::string sourcePath = settings.modelPaths.empty() ? MESH_GRID_FILE : settings.modelPaths.front();
+	if (settings.modelPaths.empty()) {
+		writeGridObj(sourcePath);
+	}
+	const std::string cachePath = MeshCache::cachePathFor(sourcePath);
+
+	// The source stays in the OS file cache across repeats, so cold means without a MeshCache, not from disk
+	Model::Builder builder;
+	const float parseMs = averageMs(MESH_REPEATS, [&] { builder = MeshLoader::load(sourcePath); });
+	uint64_t sourceHash = 0;
+	const float hashMs = averageMs(MESH_REPEATS, [&] { sourceHash = MeshCache::hashSource(sourcePath); });
+	const float writeMs = averageMs(MESH_REPEATS, [&] { MeshCache::write(cachePath, sourceHash, builder); });
+
+	// Touch every vertex and index byte, as staging them would, or the mapping alone costs next to nothing
+	uint64_t checksum = 0;
+	const float mapMs = averageMs(MESH_REPEATS, [&] {
+		std::unique_ptr<MeshCache> cache = MeshCache::open(cachePath, sourceHash);
+		if (!cache) {
+			throw std::runtime_error("freshly written mesh cache was rejected: " + cachePath);
+		}
+		const Model::MeshView mesh = cache->view();
+		const uint8_t* vertices = static_cast<const uint8_t*>(mesh.vertices);
+		for (size_t i = 0; i < size_t(VertexLayout::active().stride()) * mesh.vertexCount; i += 64) {
+			checksum += vertices[i];
+		}
+	});
+
+	// Upload through the real staging path, waiting for the copies each time
+	Device device{ nullptr };
+	const float builderUploadMs = averageMs(MESH_REPEATS, [&] {
+		Model model{ device, builder };
+		device.flushUploads();
+		vkDeviceWaitIdle(device.device());
+	});
+	std::unique_ptr<MeshCache> cache = MeshCache::open(cachePath, sourceHash);
+	const float cacheUploadMs = averageMs(MESH_REPEATS, [&] {
+		Model model{ device, cache->view() };
+		device.flushUploads();
+		vkDeviceWaitIdle(device.device());
+	});
+
+	const float coldMs = parseMs + builderUploadMs;
+	const float warmMs = hashMs + mapMs + cacheUploadMs;
+	std::cout << sourcePath << ": " << builder.vertices.size() << " vertices, " << builder.indices.size()
+		<< " indices, average of " << MESH_REPEATS << " runs (checksum " << checksum << ")\n";
+	std::printf("  %-34s %10.2f ms\n", "parse source", parseMs);
+	std::printf("  %-34s %10.2f ms\n", "write cache", writeMs);
+	std::printf("  %-34s %10.2f ms\n", "hash source", hashMs);
+	std::printf("  %-34s %10.2f ms\n", "map and read cache", mapMs);
+	std::printf("  %-34s %10.2f ms\n", "create model from builder", builderUploadMs);
+	std::printf("  %-34s %10.2f ms\n", "create model from cache", cacheUploadMs);
+	std::printf("  %-34s %10.2f ms\n", "cold load, parse + upload", coldMs);
+	std::printf("  %-34s %10.2f ms %8.2fx\n", "warm load, hash + map + upload", warmMs, coldMs / warmMs);
+}
+
+void Benchmarks::vertexFormats(const Settings& settings)
+{
+	std::string sourcePath = settings.modelPaths.empty() ? MESH_GRID_FILE : settings.modelPaths.front();
+	if (settings.modelPaths.empty()) {
+		writeGridObj(sourcePath);
+	}
+	const Model::Builder builder = MeshLoader::load(sourcePath);
+	const size_t vertexCount = builder.vertices.size();
+
+	float largest = 0.0f;
+	for (const auto& vertex : builder.vertices) {
+		largest = std::max({ largest, std::abs(vertex.position.x), std::abs(vertex.position.y) });
+	}
+	std::cout << sourcePath << ": " << vertexCount << " vertices, largest coordinate " << largest << "\n";
+	std::printf("  %-8s %8s %12s %16s %16s %12s\n", "layout", "stride", "vertex MB", "max pos error", "rms pos error", "max colour");
+
+	for (const char* name : VERTEX_FORMAT_NAMES) {
+		const VertexLayout layout = VertexLayout::fromName(name);
+		const VertexLayout::QuantizationError error = layout.measureError(builder.vertices.data(), vertexCount);
+		std::printf("  %-8s %8u %12.2f %16.3g %16.3g %12.3g\n", name, layout.stride(),
+			double(layout.stride()) * vertexCount / (1024.0 * 1024.0), error.maxPosition, error.rmsPosition, error.maxColour);
+	}
+
+	// Directions spread evenly over the sphere on a Fibonacci spiral
+	float maxDegrees = 0.0f;
+	double sumDegrees = 0.0;
+	for (uint32_t i = 0; i < NORMAL_SAMPLES; i++) {
+		const float z = 1.0f - 2.0f * (i + 0.5f) / NORMAL_SAMPLES;
+		const float radius = std::sqrt(1.0f - z * z);
+		const float angle = i * glm::pi<float>() * (3.0f - std::sqrt(5.0f));
+		const glm::vec3 normal{ radius * std::cos(angle), radius * std::sin(angle), z };
+
+		const glm::vec3 decoded = Octahedral::unpack(Octahedral::pack(normal));
+		const float degrees = glm::degrees(std::acos(glm::clamp(glm::dot(normal, decoded), -1.0f, 1.0f)));
+		maxDegrees = std::max(maxDegrees, degrees);
+		sumDegrees += degrees;
+	}
+	std::printf("  octahedral normals, 4 bytes instead of 12: max %.4f, mean %.4f degrees over %u directions\n",
+		maxDegrees, sumDegrees / NORMAL_SAMPLES, NORMAL_SAMPLES);
+}
+
+void Benchmarks::meshOptimization(const Settings& settings)
+{
+	std::string sourcePath = settings.modelPaths.empty() ? MESH_GRID_FILE : settings.modelPaths.front();
+	if (settings.modelPaths.empty()) {
+		writeGridObj(sourcePath);
+	}
+	const Model::Builder loaded = MeshLoader::load(sourcePath);
+
+	// Triangle soup order, the worst case a converter can hand over
+	Model::Builder shuffled = loaded;
+	std::vector<uint32_t> triangles(shuffled.indices.size() / 3);
+	for (uint32_t i = 0; i < triangles.size(); i++) {
+		triangles[i] = i;
+	}
+	std::shuffle(triangles.begin(), triangles.end(), std::mt19937{ 42 });
+	for (size_t i = 0; i < triangles.size(); i++) {
+		for (uint32_t corner = 0; corner < 3; corner++) {
+			shuffled.indices[i * 3 + corner] = loaded.indices[triangles[i] * 3 + corner];
+		}
+	}
+
+	std::cout << sourcePath << ": " << loaded.vertices.size() << " vertices, " << loaded.indices.size() / 3 << " triangles, "
+		<< MeshOptimizer::DEFAULT_CACHE_SIZE << " entry FIFO, " << VertexLayout::active().stride() << " byte vertices\n";
+	std::printf("  %-22s %8s %8s %10s %10s %10s\n", "", "ACMR", "ATVR", "overfetch", "overdraw", "ms");
+
+	const Model::Builder* inputs[] = { &loaded, &shuffled };
+	const char* labels[][2] = { { "as loaded", "as loaded, optimized" }, { "shuffled", "shuffled, optimized" } };
+	for (uint32_t i = 0; i < 2; i++) {
+		printMeshStats(labels[i][0], MeshOptimizer::analyze(*inputs[i]), 0.0f);
+
+		Model::Builder optimized;
+		const float optimizeMs = averageMs(MESH_REPEATS, [&] {
+			optimized.vertices = inputs[i]->vertices;
+			optimized.indices = inputs[i]->indices;
+			MeshOptimizer::optimize(optimized);
+		});
+		printMeshStats(labels[i][1], MeshOptimizer::analyze(optimized), optimizeMs);
+	}
+}
+
+void Benchmarks::lodGeneration(const Settings& settings)
+{
+	std::string sourcePath = settings.modelPaths.empty() ? MESH_GRID_FILE : settings.modelPaths.front();
+	if (settings.modelPaths.empty()) {
+		writeGridObj(sourcePath);
+	}
+	Model::Builder builder = MeshLoader::load(sourcePath);
+
+	auto start = std::chrono::steady_clock::now();
+	MeshSimplifier::generateLods(builder);
+	const float generateMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	float boundingRadius = 0.0f;
+	for (const auto& vertex : builder.vertices) {
+		boundingRadius = std::max(boundingRadius, glm::length(vertex.position));
+	}
+	const uint32_t fullIndexCount = builder.lods.empty() ? 0 : builder.lods[0].indexCount;
+
+	std::cout << sourcePath << ": " << builder.vertices.size() << " vertices, " << builder.lods.size() << " LODs generated in "
+		<< generateMs << " ms, index buffer " << static_cast<float>(builder.indices.size()) / std::max(fullIndexCount, 1u) << "x the full mesh\n";
+	std::printf("  %-4s %10s %8s %12s %22s\n", "LOD", "triangles", "share", "error", "drawn below (pixels)");
+	for (size_t i = 0; i < builder.lods.size(); i++) {
+		const Model::Lod& lod = builder.lods[i];
+		// Model::selectLod takes this level once the mesh's diameter on screen drops to this size
+		const float drawnBelow = lod.error > 0.0f ? 2.0f * boundingRadius * settings.lodErrorPixels / lod.error : INFINITY;
+		std::printf("  %-4zu %10u %7.1f%% %12.6f %22.1f\n", i, lod.indexCount / 3, 100.0f * lod.indexCount / fullIndexCount, lod.error, drawnBelow);
+	}
+}
+
+void Benchmarks::resizeStorm(const Settings& settings)
+{
+	Window window{ static_cast<int>(settings.width), static_cast<int>(settings.height), "Resize Benchmark" };
+	Device device{ &window };
+	Renderer renderer{ window, device, settings.framesInFlight };
+	SimpleRenderSystem renderSystem{ device, renderer.getSwapChainRenderPass() };
+	std::vector<RenderableComponent> objects;
+	TransformStore transforms;
+	createScene(device, objects, transforms);
+
+	// Whole frames, including any swap chain recreation in beginFrame or endFrame
+	auto renderFrames = [&](bool resize) {
+		std::vector<double> frameMs;
+		for (uint32_t frame = 0; frame < RESIZE_FRAMES; frame++) {
+			if (resize) {
+				const float scale = 0.75f + 0.25f * std::cos(glm::two_pi<float>() * frame / RESIZE_PERIOD_FRAMES);
+				window.setSize(static_cast<int>(settings.width * scale), static_cast<int>(settings.height * scale));
+			}
+			glfwPollEvents();
+
+			auto start = std::chrono::steady_clock::now();
+			if (VkCommandBuffer commandBuffer = renderer.beginFrame()) {
+				FrameInfo frameInfo{ renderer.getFrameIndex(), commandBuffer, renderer.getCurrentFrameContext(), renderer.getExtent() };
+				renderer.beginSwapChainRenderPass(commandBuffer);
+				renderSystem.renderObjects(frameInfo, objects, transforms);
+				renderer.endSwapChainRenderPass(commandBuffer);
+				renderer.endFrame();
+			}
+			frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		return summarizeFrameTimes(std::move(frameMs));
+	};
+
+	std::cout << "Frame times over " << RESIZE_FRAMES << " frames, resizing the window every frame\n";
+	std::printf("  %-10s %10s %10s %10s %10s %10s %12s %14s\n",
+		"recreate", "steady ms", "avg ms", "p99 ms", "max ms", "swaps", "depth allocs", "recreate avg ms");
+	for (bool idle : { true, false }) {
+		renderer.setIdleOnRecreate(idle);
+		window.setSize(static_cast<int>(settings.width), static_cast<int>(settings.height));
+		const FrameTimes steady = renderFrames(false);
+
+		const Renderer::ResizeStats before = renderer.getResizeStats();
+		const FrameTimes storm = renderFrames(true);
+		const Renderer::ResizeStats& after = renderer.getResizeStats();
+		const uint32_t recreations = after.recreations - before.recreations;
+		std::printf("  %-10s %10.3f %10.3f %10.3f %10.3f %10u %12u %14.3f\n", idle ? "wait idle" : "retire",
+			steady.averageMs, storm.averageMs, storm.p99Ms, storm.maxMs, recreations,
+			after.depthAllocations - before.depthAllocations,
+			recreations > 0 ? (after.totalMs - before.totalMs) / recreations : 0.0);
+	}
+}
+
+bool Benchmarks::stagingRingWrap()
+{
+	Device device{ nullptr };
+	StagingRing ring{ device };
+	VkBuffer buffer;
+	Allocation allocation;
+	device.createBuffer(
+		StagingRing::DEFAULT_CAPACITY,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		buffer,
+		allocation);
+
+	std::vector<uint8_t> data(static_cast<size_t>(STAGING_WRAP_SIZE));
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = static_cast<uint8_t>(i * 31 + i / 4096);
+	}
+
+	// A hang is the failure being checked for, so give up on the whole process rather than wait forever
+	std::atomic<bool> finished{ false };
+	std::thread watchdog([&finished] {
+		const auto deadline = std::chrono::steady_clock::now() + STAGING_TIMEOUT;
+		while (!finished.load()) {
+			if (std::chrono::steady_clock::now() > deadline) {
+				std::cout << "staging ring wrap: FAILED, upload did not return" << std::endl;
+				std::_Exit(EXIT_FAILURE);
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	});
+
+	auto uploadAndWait = [&](VkDeviceSize size) {
+		const uint64_t ticket = ring.upload(buffer, 0, data.data(), size);
+		ring.flush();
+		while (!ring.isComplete(ticket)) {
+			std::this_thread::yield();
+		}
+	};
+	uploadAndWait(STAGING_DRAIN_SIZE);
+	uploadAndWait(STAGING_WRAP_SIZE);
+	finished = true;
+	watchdog.join();
+
+	const bool landed = std::memcmp(allocation.mappedData, data.data(), data.size()) == 0;
+	std::cout << "staging ring wrap: " << (landed ? "passed" : "FAILED, copied data differs") << std::endl;
+	device.destroyBuffer(buffer, allocation);
+	return landed;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Settings.h"
+
+// Standalone measurements selected with --bench, each renders headless and prints its results
+namespace Benchmarks
+{
+	// Returns the process exit code
+	int run(const Settings& settings);
+
+	// Time to record one frame of draws from 1 to hardware_concurrency recording threads
+	void recordScaling(const Settings& settings);
+	// JobSystem against ThreadPool on even, uneven and tiny tasks at the same thread counts
+	void jobScheduling(const Settings& settings);
+	// Registry create, dense iteration, two-component views, handle lookups and churn at 1M entities
+	void entityIteration(const Settings& settings);
+	// TransformStore::buildMatrices against Transform2DComponent::mat2 per object
+	void transformBuilding(const Settings& settings);
+	// Parsing a text mesh against mapping its MeshCache, on the first --model or a generated grid
+	void meshCacheLoading(const Settings& settings);
+	// Size and quantization error of each VertexLayout on the same mesh, plus octahedral normal error
+	void vertexFormats(const Settings& settings);
+	// Vertex cache and fetch statistics before and after MeshOptimizer, as loaded and with shuffled triangles
+	void meshOptimization(const Settings& settings);
+	// Triangles and error of each generated LOD, and the on-screen size below which it gets drawn
+	void lodGeneration(const Settings& settings);
+	// Frame times while the window is resized every frame, idling the device on recreation against retiring the
+	// old swap chain. Needs a window, unlike the others
+	void resizeStorm(const Settings& settings);
+	// Drains a StagingRing partway through, then uploads a copy that has to wrap and checks it lands. Returns
+	// false if it does not, or exits the process if the upload never returns
+	bool stagingRingWrap();
+}
@@ -0,0 +1,568 @@
+#include "ClusterRenderSystem.h"
+
+#include "Profiler.h"
+#include "VertexLayout.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	// 0: objects, 1: meshlets, 2: meshlet vertices, 3: meshlet triangles, 4: vertices, 5: indices, 6: draws, 7: stats
+	constexpr uint32_t BINDING_COUNT = 8;
+	// Guaranteed minimums of maxComputeWorkGroupCount, maxTaskWorkGroupCount and maxTaskWorkGroupTotalCount
+	constexpr uint32_t MAX_GROUPS_PER_DIMENSION = 65535;
+	constexpr uint32_t MAX_TASK_GROUPS = 1u << 22;
+	// Index values carry the cluster above the meshlet local vertex
+	constexpr uint32_t CLUSTER_SHIFT = 6;
+	static_assert((1u << CLUSTER_SHIFT) >= Model::MAX_MESHLET_VERTICES, "Meshlet vertices must fit below the cluster bits");
+
+	constexpr const char* VERTEX_SHADER = "cluster_shader.vert.spv";
+	constexpr const char* TASK_SHADER = "cluster.task.spv";
+	constexpr const char* MESH_SHADER = "cluster.mesh.spv";
+	constexpr const char* FRAGMENT_SHADER = "instanced_shader.frag.spv";
+	constexpr const char* CULL_SHADER = "cluster_cull.comp.spv";
+}
+
+struct ClusterPushConstantData {
+	uint32_t objectBase;		// First object of the Model in the object buffer
+	uint32_t objectCount;
+	uint32_t meshletCount;
+	uint32_t drawIndex;
+	uint32_t firstObject;		// Of this dispatch, relative to objectBase
+	uint32_t vertexStride;		// In 32-bit words, positions come first
+	uint32_t positionFormat;	// VertexLayout::PositionFormat
+	uint32_t backfaceCulling;
+};
+
+ClusterRenderSystem::ClusterRenderSystem(Device& device, VkRenderPass renderPass, uint32_t framesInFlight, bool useMeshShaders, bool backfaceCulling)
+	: m_Device(device), m_UseMeshShaders(useMeshShaders && device.supportsMeshShaders()), m_BackfaceCulling(backfaceCulling)
+{
+	m_GraphicsStages = m_UseMeshShaders ? VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT : VK_SHADER_STAGE_VERTEX_BIT;
+	m_MaxClustersPerDraw = (m_Device.maxDrawIndexValue() >> CLUSTER_SHIFT) + 1;
+	m_Frames.resize(framesInFlight);
+	for (auto& frame : m_Frames) {
+		m_Device.createBuffer(
+			sizeof(GpuStats),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			frame.statsBuffer,
+			frame.statsAllocation);
+	}
+	m_CreateDescriptorSetLayout();
+	m_CreatePipelineLayouts();
+	m_CreatePipelines(renderPass);
+	std::cout << "Cluster culling: " << (m_UseMeshShaders ? "task and mesh shaders" : "compute and vertex shaders") << std::endl;
+}
+
+ClusterRenderSystem::~ClusterRenderSystem()
+{
+	if (m_ShaderReloader) {
+		m_ShaderReloader->unwatch(this);
+	}
+	for (auto& frame : m_Frames) {
+		m_DestroyFrameBuffers(frame);
+		m_Device.destroyBuffer(frame.statsBuffer, frame.statsAllocation);
+	}
+	vkDestroyPipelineLayout(m_Device.device(), m_CullPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(m_Device.device(), m_PipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(m_Device.device(), m_DescriptorSetLayout, nullptr);
+}
+
+void ClusterRenderSystem::m_CreateDescriptorSetLayout()
+{
+	std::array<VkDescriptorSetLayoutBinding, BINDING_COUNT> bindings{};
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | m_GraphicsStages;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(m_Device.device(), &layoutInfo, nullptr, &m_DescriptorSetLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create descriptor set layout!");
+	}
+}
+
+void ClusterRenderSystem::m_CreatePipelineLayouts()
+{
+	VkPushConstantRange cullPushRange{};
+	cullPushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	cullPushRange.offset = 0;
+	cullPushRange.size = sizeof(ClusterPushConstantData);
+
+	VkPipelineLayoutCreateInfo cullLayoutInfo{};
+	cullLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	cullLayoutInfo.setLayoutCount = 1;
+	cullLayoutInfo.pSetLayouts = &m_DescriptorSetLayout;
+	cullLayoutInfo.pushConstantRangeCount = 1;
+	cullLayoutInfo.pPushConstantRanges = &cullPushRange;
+
+	if (vkCreatePipelineLayout(m_Device.device(), &cullLayoutInfo, nullptr, &m_CullPipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+
+	VkPushConstantRange drawPushRange{};
+	drawPushRange.stageFlags = m_GraphicsStages;
+	drawPushRange.offset = 0;
+	drawPushRange.size = sizeof(ClusterPushConstantData);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &m_DescriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &drawPushRange;
+
+	if (vkCreatePipelineLayout(m_Device.device(), &pipelineLayoutInfo, nullptr, &m_PipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+}
+
+void ClusterRenderSystem::m_CreatePipelines(VkRenderPass renderPass)
+{
+	assert(m_PipelineLayout != nullptr);
+	m_RenderPass = renderPass;
+	m_Pipeline = m_CreateDrawPipeline();
+	if (!m_UseMeshShaders) {
+		m_CullPipeline = m_CreateCullPipeline();
+	}
+}
+
+void ClusterRenderSystem::enableHotReload(ShaderReloader& shaderReloader)
+{
+	m_ShaderReloader = &shaderReloader;
+	if (m_UseMeshShaders) {
+		shaderReloader.watch<Pipeline>(this, m_Pipeline, { TASK_SHADER, MESH_SHADER, FRAGMENT_SHADER },
+			[this] { return m_CreateDrawPipeline(); });
+		return;
+	}
+	shaderReloader.watch<Pipeline>(this, m_Pipeline, { VERTEX_SHADER, FRAGMENT_SHADER },
+		[this] { return m_CreateDrawPipeline(); });
+	shaderReloader.watch<ComputePipeline>(this, m_CullPipeline, { CULL_SHADER },
+		[this] { return m_CreateCullPipeline(); });
+}
+
+std::unique_ptr<Pipeline> ClusterRenderSystem::m_CreateDrawPipeline() const
+{
+	PipelineConfigInfo pipelineConfig{};
+	Pipeline::defaultPipelineConfigInfo(pipelineConfig);
+	// Vertices are pulled from storage buffers
+	pipelineConfig.bindingDescriptions.clear();
+	pipelineConfig.attributeDescriptions.clear();
+	// The cone test only removes meshlets the rasterizer would cull anyway
+	if (m_BackfaceCulling) {
+		pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+	}
+	pipelineConfig.renderPass = m_RenderPass;
+	pipelineConfig.pipelineLayout = m_PipelineLayout;
+
+	if (m_UseMeshShaders) {
+		return std::make_unique<Pipeline>(m_Device, pipelineConfig, std::vector<ShaderStageInfo>{
+			{ VK_SHADER_STAGE_TASK_BIT_EXT, Pipeline::shaderPath(TASK_SHADER) },
+			{ VK_SHADER_STAGE_MESH_BIT_EXT, Pipeline::shaderPath(MESH_SHADER) },
+			{ VK_SHADER_STAGE_FRAGMENT_BIT, Pipeline::shaderPath(FRAGMENT_SHADER) },
+		});
+	}
+	return std::make_unique<Pipeline>(
+		m_Device,
+		pipelineConfig,
+		Pipeline::shaderPath(VERTEX_SHADER),
+		Pipeline::shaderPath(FRAGMENT_SHADER)
+	);
+}
+
+std::unique_ptr<ComputePipeline> ClusterRenderSystem::m_CreateCullPipeline() const
+{
+	return std::make_unique<ComputePipeline>(
+		m_Device,
+		m_CullPipelineLayout,
+		Pipeline::shaderPath(CULL_SHADER)
+	);
+}
+
+void ClusterRenderSystem::m_DestroyFrameBuffers(FrameResources& frame)
+{
+	if (frame.objectBuffer != VK_NULL_HANDLE) {
+		m_Device.destroyBuffer(frame.objectBuffer, frame.objectAllocation);
+		frame.objectBuffer = VK_NULL_HANDLE;
+		frame.objectCapacity = 0;
+	}
+	if (frame.indexBuffer != VK_NULL_HANDLE) {
+		m_Device.destroyBuffer(frame.indexBuffer, frame.indexAllocation);
+		frame.indexBuffer = VK_NULL_HANDLE;
+		frame.indexCapacity = 0;
+	}
+	if (frame.drawBuffer != VK_NULL_HANDLE) {
+		m_Device.destroyBuffer(frame.drawBuffer, frame.drawAllocation);
+		frame.drawBuffer = VK_NULL_HANDLE;
+		frame.drawCapacity = 0;
+	}
+}
+
+void ClusterRenderSystem::m_ReserveFrame(int frameIndex, uint32_t objectCount, VkDeviceSize indexCount, uint32_t drawCount)
+{
+	FrameResources& frame = m_Frames[frameIndex];
+
+	// This frame index has been waited on, so its old buffers are no longer in use
+	if (objectCount > frame.objectCapacity) {
+		if (frame.objectBuffer != VK_NULL_HANDLE) {
+			m_Device.destroyBuffer(frame.objectBuffer, frame.objectAllocation);
+		}
+		uint32_t capacity = std::max<uint32_t>(64, frame.objectCapacity);
+		while (capacity < objectCount) {
+			capacity *= 2;
+		}
+		m_Device.createBuffer(
+			sizeof(ClusterObject) * capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			frame.objectBuffer,
+			frame.objectAllocation);
+		frame.objectCapacity = capacity;
+	}
+
+	// Room for every meshlet of every object passing, written by the cull pass and read as the index buffer
+	if (indexCount > frame.indexCapacity) {
+		if (frame.indexBuffer != VK_NULL_HANDLE) {
+			m_Device.destroyBuffer(frame.indexBuffer, frame.indexAllocation);
+		}
+		VkDeviceSize capacity = std::max<VkDeviceSize>(65536, frame.indexCapacity);
+		while (capacity < indexCount) {
+			capacity *= 2;
+		}
+		m_Device.createBuffer(
+			sizeof(uint32_t) * capacity,
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			frame.indexBuffer,
+			frame.indexAllocation);
+		frame.indexCapacity = capacity;
+	}
+
+	if (drawCount > frame.drawCapacity) {
+		if (frame.drawBuffer != VK_NULL_HANDLE) {
+			m_Device.destroyBuffer(frame.drawBuffer, frame.drawAllocation);
+		}
+		uint32_t capacity = std::max<uint32_t>(16, frame.drawCapacity);
+		while (capacity < drawCount) {
+			capacity *= 2;
+		}
+		m_Device.createBuffer(
+			sizeof(VkDrawIndexedIndirectCommand) * capacity,
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			frame.drawBuffer,
+			frame.drawAllocation);
+		frame.drawCapacity = capacity;
+	}
+}
+
+void ClusterRenderSystem::m_ReadStats(FrameResources& frame)
+{
+	if (!frame.statsPending) {
+		return;
+	}
+	GpuStats counts;
+	std::memcpy(&counts, frame.statsAllocation.mappedData, sizeof(GpuStats));
+	m_LastFrameStats.clusters = frame.clusters;
+	m_LastFrameStats.culledClusters = counts.culledClusters;
+	m_LastFrameStats.triangles = frame.triangles;
+	m_LastFrameStats.culledTriangles = counts.culledTriangles;
+
+	m_TotalStats.clusters += m_LastFrameStats.clusters;
+	m_TotalStats.culledClusters += m_LastFrameStats.culledClusters;
+	m_TotalStats.triangles += m_LastFrameStats.triangles;
+	m_TotalStats.culledTriangles += m_LastFrameStats.culledTriangles;
+	m_StatsFrames++;
+	frame.statsPending = false;
+}
+
+void ClusterRenderSystem::cullClusters(FrameInfo& frameInfo, const std::vector<RenderableComponent>& objects, const TransformStore& transforms)
+{
+	PROFILE_FUNCTION();
+	VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+	const int frameIndex = frameInfo.frameIndex;
+	assert(transforms.size() == objects.size() && "Every object needs a transform");
+	m_ReadStats(m_Frames[frameIndex]);
+
+	// Group the objects by Model, each group owning a range of the object buffer and of the index buffer
+	m_DrawIndices.clear();
+	m_Draws.clear();
+	for (size_t i = 0; i < objects.size(); i++) {
+		Model* model = objects[i].model.get();
+		if (!model->hasMeshlets()) {
+			continue;
+		}
+		auto result = m_DrawIndices.emplace(model, static_cast<uint32_t>(m_Draws.size()));
+		if (result.second) {
+			m_Draws.push_back({ model, 0, 0, 0, VK_NULL_HANDLE });
+		}
+		m_Draws[result.first->second].objectCount++;
+	}
+	if (m_Draws.empty()) {
+		return;
+	}
+
+	uint32_t objectCount = 0;
+	VkDeviceSize indexCount = 0;
+	uint64_t clusters = 0;
+	uint64_t triangles = 0;
+	for (ModelDraw& draw : m_Draws) {
+		const uint32_t meshletCount = draw.model->getMeshletCount();
+		if (meshletCount > m_MaxClustersPerDraw) {
+			throw std::runtime_error("Too many meshlets for one cluster draw");
+		}
+		draw.objectBase = objectCount;
+		draw.indexBase = static_cast<uint32_t>(indexCount);
+		objectCount += draw.objectCount;
+		clusters += uint64_t(draw.objectCount) * meshletCount;
+		triangles += uint64_t(draw.objectCount) * draw.model->getLod(0).indexCount / 3;
+		if (!m_UseMeshShaders) {
+			indexCount += VkDeviceSize(draw.objectCount) * draw.model->getLod(0).indexCount;
+		}
+	}
+	if (indexCount > UINT32_MAX) {
+		throw std::runtime_error("Too many cluster indices for one frame");
+	}
+
+	m_ObjectOrder.resize(objectCount);
+	std::vector<uint32_t> fill(m_Draws.size());
+	for (size_t d = 0; d < m_Draws.size(); d++) {
+		fill[d] = m_Draws[d].objectBase;
+	}
+	for (uint32_t i = 0; i < objects.size(); i++) {
+		auto found = m_DrawIndices.find(objects[i].model.get());
+		if (found != m_DrawIndices.end()) {
+			m_ObjectOrder[fill[found->second]++] = i;
+		}
+	}
+
+	// Split each Model's objects across draws whose clusters all fit in the index values, the mesh shaders have no indices
+	if (!m_UseMeshShaders) {
+		std::vector<ModelDraw> split;
+		split.reserve(m_Draws.size());
+		for (const ModelDraw& draw : m_Draws) {
+			const uint32_t objectsPerDraw = m_MaxClustersPerDraw / draw.model->getMeshletCount();
+			const uint32_t indicesPerObject = draw.model->getLod(0).indexCount;
+			for (uint32_t first = 0; first < draw.objectCount; first += objectsPerDraw) {
+				split.push_back({ draw.model, draw.objectBase + first, std::min(objectsPerDraw, draw.objectCount - first),
+					draw.indexBase + first * indicesPerObject, VK_NULL_HANDLE });
+			}
+		}
+		m_Draws.swap(split);
+	}
+
+	const uint32_t drawCount = static_cast<uint32_t>(m_Draws.size());
+	m_ReserveFrame(frameIndex, objectCount, indexCount, drawCount);
+	FrameResources& frame = m_Frames[frameIndex];
+	frame.statsPending = true;
+	frame.clusters = clusters;
+	frame.triangles = triangles;
+
+	auto* objectData = static_cast<ClusterObject*>(frame.objectAllocation.mappedData);
+	const float* scaleX = transforms.scaleX();
+	const float* scaleY = transforms.scaleY();
+	for (size_t d = 0; d < m_Draws.size(); d++) {
+		ModelDraw& draw = m_Draws[d];
+		const float positionScale = draw.model->getPositionScale();
+		transforms.buildMatricesIndexed(&m_ObjectOrder[draw.objectBase], draw.objectCount, &objectData[draw.objectBase], sizeof(ClusterObject), positionScale);
+		for (uint32_t i = draw.objectBase; i < draw.objectBase + draw.objectCount; i++) {
+			const uint32_t object = m_ObjectOrder[i];
+			ClusterObject& data = objectData[i];
+			data.radiusScale = std::max(std::abs(scaleX[object]), std::abs(scaleY[object]));
+			data.boundsScale = 1.0f / positionScale;
+			data.colour = objects[object].colour;
+		}
+
+		// Bound per Model since the meshlet and vertex buffers differ, allocated fresh every frame. A Model's
+		// split draws are adjacent and share its set
+		if (d > 0 && m_Draws[d - 1].model == draw.model) {
+			draw.descriptorSet = m_Draws[d - 1].descriptorSet;
+			continue;
+		}
+		draw.descriptorSet = frameInfo.context.allocateDescriptorSet(m_DescriptorSetLayout);
+		std::array<VkDescriptorBufferInfo, BINDING_COUNT> bufferInfos{};
+		bufferInfos[0] = { frame.objectBuffer, 0, VK_WHOLE_SIZE };
+		bufferInfos[1] = { draw.model->getMeshletBuffer(), 0, VK_WHOLE_SIZE };
+		bufferInfos[2] = { draw.model->getMeshletVertexBuffer(), 0, VK_WHOLE_SIZE };
+		bufferInfos[3] = { draw.model->getMeshletTriangleBuffer(), 0, VK_WHOLE_SIZE };
+		bufferInfos[4] = { draw.model->getVertexBuffer(), 0, VK_WHOLE_SIZE };
+		// Unused by the mesh shader path, which has no index buffer
+		bufferInfos[5] = { m_UseMeshShaders ? frame.objectBuffer : frame.indexBuffer, 0, VK_WHOLE_SIZE };
+		bufferInfos[6] = { frame.drawBuffer, 0, VK_WHOLE_SIZE };
+		bufferInfos[7] = { frame.statsBuffer, 0, VK_WHOLE_SIZE };
+
+		std::array<VkWriteDescriptorSet, BINDING_COUNT> writes{};
+		for (uint32_t i = 0; i < writes.size(); i++) {
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = draw.descriptorSet;
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[i].pBufferInfo = &bufferInfos[i];
+		}
+		vkUpdateDescriptorSets(m_Device.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+
+	// Each Model's draw starts empty, the cull pass appends the triangles of every meshlet that passes
+	m_DrawCommands.resize(drawCount);
+	for (uint32_t i = 0; i < drawCount; i++) {
+		m_DrawCommands[i].indexCount = 0;
+		m_DrawCommands[i].instanceCount = 1;
+		m_DrawCommands[i].firstIndex = m_Draws[i].indexBase;
+		m_DrawCommands[i].vertexOffset = 0;
+		m_DrawCommands[i].firstInstance = 0;
+	}
+
+	// vkCmdUpdateBuffer is limited to 64KiB per call
+	const VkDeviceSize drawBytes = sizeof(VkDrawIndexedIndirectCommand) * drawCount;
+	const auto* drawData = reinterpret_cast<const char*>(m_DrawCommands.data());
+	for (VkDeviceSize offset = 0; offset < drawBytes; offset += 65536) {
+		const VkDeviceSize chunk = std::min<VkDeviceSize>(65536, drawBytes - offset);
+		vkCmdUpdateBuffer(commandBuffer, frame.drawBuffer, offset, chunk, drawData + offset);
+	}
+	vkCmdFillBuffer(commandBuffer, frame.statsBuffer, 0, sizeof(GpuStats), 0);
+
+	const VkPipelineStageFlags cullStage = m_UseMeshShaders ? VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	std::array<VkBufferMemoryBarrier, 2> resetBarriers{};
+	for (auto& barrier : resetBarriers) {
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.offset = 0;
+	}
+	resetBarriers[0].buffer = frame.drawBuffer;
+	resetBarriers[0].size = drawBytes;
+	resetBarriers[1].buffer = frame.statsBuffer;
+	resetBarriers[1].size = sizeof(GpuStats);
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, cullStage,
+		0, 0, nullptr, static_cast<uint32_t>(resetBarriers.size()), resetBarriers.data(), 0, nullptr);
+
+	// The task shader culls while drawing
+	if (m_UseMeshShaders) {
+		return;
+	}
+
+	const uint32_t vertexStride = VertexLayout::active().stride() / sizeof(uint32_t);
+	const uint32_t positionFormat = static_cast<uint32_t>(VertexLayout::active().position);
+	m_CullPipeline->bind(commandBuffer);
+	for (uint32_t d = 0; d < drawCount; d++) {
+		const ModelDraw& draw = m_Draws[d];
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullPipelineLayout, 0, 1, &draw.descriptorSet, 0, nullptr);
+		// x walks the meshlets, y the objects, split into dispatches when there are too many objects
+		const uint32_t meshletGroups = (draw.model->getMeshletCount() + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE;
+		for (uint32_t first = 0; first < draw.objectCount; first += MAX_GROUPS_PER_DIMENSION) {
+			ClusterPushConstantData push{ draw.objectBase, draw.objectCount, draw.model->getMeshletCount(), d, first,
+				vertexStride, positionFormat, m_BackfaceCulling ? 1u : 0u };
+			vkCmdPushConstants(commandBuffer, m_CullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ClusterPushConstantData), &push);
+			vkCmdDispatch(commandBuffer, meshletGroups, std::min(MAX_GROUPS_PER_DIMENSION, draw.objectCount - first), 1);
+		}
+	}
+
+	// Draw commands are read as indirect arguments, the indices by the input assembler
+	std::array<VkBufferMemoryBarrier, 2> cullBarriers{};
+	for (auto& barrier : cullBarriers) {
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.offset = 0;
+	}
+	cullBarriers[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	cullBarriers[0].buffer = frame.drawBuffer;
+	cullBarriers[0].size = drawBytes;
+	cullBarriers[1].dstAccessMask = VK_ACCESS_INDEX_READ_BIT;
+	cullBarriers[1].buffer = frame.indexBuffer;
+	cullBarriers[1].size = sizeof(uint32_t) * indexCount;
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		0, 0, nullptr, static_cast<uint32_t>(cullBarriers.size()), cullBarriers.data(), 0, nullptr);
+}
+
+void ClusterRenderSystem::renderClusters(FrameInfo& frameInfo)
+{
+	PROFILE_FUNCTION();
+	if (m_Draws.empty()) {
+		return;
+	}
+	VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+	FrameResources& frame = m_Frames[frameInfo.frameIndex];
+	const uint32_t vertexStride = VertexLayout::active().stride() / sizeof(uint32_t);
+	const uint32_t positionFormat = static_cast<uint32_t>(VertexLayout::active().position);
+
+	m_Pipeline->bind(commandBuffer);
+	if (!m_UseMeshShaders) {
+		vkCmdBindIndexBuffer(commandBuffer, frame.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+	}
+
+	for (uint32_t d = 0; d < m_Draws.size(); d++) {
+		const ModelDraw& draw = m_Draws[d];
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1, &draw.descriptorSet, 0, nullptr);
+		ClusterPushConstantData push{ draw.objectBase, draw.objectCount, draw.model->getMeshletCount(), d, 0,
+			vertexStride, positionFormat, m_BackfaceCulling ? 1u : 0u };
+
+		if (!m_UseMeshShaders) {
+			vkCmdPushConstants(commandBuffer, m_PipelineLayout, m_GraphicsStages, 0, sizeof(ClusterPushConstantData), &push);
+			vkCmdDrawIndexedIndirect(commandBuffer, frame.drawBuffer, sizeof(VkDrawIndexedIndirectCommand) * d, 1, sizeof(VkDrawIndexedIndirectCommand));
+			continue;
+		}
+
+		// One task workgroup per TASK_WORKGROUP_SIZE meshlets of one object
+		const uint32_t meshletGroups = (draw.model->getMeshletCount() + TASK_WORKGROUP_SIZE - 1) / TASK_WORKGROUP_SIZE;
+		assert(meshletGroups <= MAX_GROUPS_PER_DIMENSION);
+		const uint32_t objectsPerDraw = std::min(MAX_GROUPS_PER_DIMENSION, MAX_TASK_GROUPS / meshletGroups);
+		for (uint32_t first = 0; first < draw.objectCount; first += objectsPerDraw) {
+			push.firstObject = first;
+			vkCmdPushConstants(commandBuffer, m_PipelineLayout, m_GraphicsStages, 0, sizeof(ClusterPushConstantData), &push);
+			m_Device.cmdDrawMeshTasks(commandBuffer, meshletGroups, std::min(objectsPerDraw, draw.objectCount - first), 1);
+		}
+	}
+}
+
+void ClusterRenderSystem::finishFrame(FrameInfo& frameInfo)
+{
+	if (m_Draws.empty()) {
+		return;
+	}
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = m_Frames[frameInfo.frameIndex].statsBuffer;
+	barrier.offset = 0;
+	barrier.size = sizeof(GpuStats);
+	vkCmdPipelineBarrier(frameInfo.commandBuffer,
+		m_UseMeshShaders ? VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+		0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void ClusterRenderSystem::printStats() const
+{
+	if (m_StatsFrames == 0) {
+		return;
+	}
+	auto percent = [](uint64_t part, uint64_t whole) { return whole > 0 ? 100.0 * part / whole : 0.0; };
+	std::cout << "Cluster culling over " << m_StatsFrames << " frames: "
+		<< m_TotalStats.culledClusters / m_StatsFrames << " of " << m_TotalStats.clusters / m_StatsFrames << " clusters ("
+		<< percent(m_TotalStats.culledClusters, m_TotalStats.clusters) << "%) and "
+		<< m_TotalStats.culledTriangles / m_StatsFrames << " of " << m_TotalStats.triangles / m_StatsFrames << " triangles ("
+		<< percent(m_TotalStats.culledTriangles, m_TotalStats.triangles) << "%) culled per frame" << std::endl;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "Pipeline.h"
+#include "ComputePipeline.h"
+#include "Device.h"
+#include "FrameContext.h"
+#include "Model.h"
+#include "Components.h"
+#include "TransformStore.h"
+#include "ShaderReloader.h"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Draws models with meshlets, culling each meshlet on its own against the frustum and, with backface culling on,
+// against its normal cone. Without VK_EXT_mesh_shader a compute pass writes the surviving meshlets' triangles into
+// an index buffer and the vertex shader pulls its vertices from storage buffers, one indirect draw per Model.
+// With it a task shader culls and a mesh shader emits the meshlets directly. Only LOD 0 has meshlets.
+class ClusterRenderSystem
+{
+public:
+	// Matches ClusterObject in the cluster shaders (std430), starts with a PackedTransform2D
+	struct ClusterObject {
+		glm::vec4 transform;		// mat2 columns packed as (c0.x, c0.y, c1.x, c1.y), position scale included
+		glm::vec2 offset;
+		float radiusScale;			// Largest axis scale, for meshlet radii
+		float boundsScale;			// Takes meshlet bounds into the units of the stored positions
+		glm::vec3 colour;
+		uint32_t padding;
+	};
+
+	// Meshlets and triangles tested and culled in one frame
+	struct Stats {
+		uint64_t clusters = 0;
+		uint64_t culledClusters = 0;
+		uint64_t triangles = 0;
+		uint64_t culledTriangles = 0;
+	};
+
+	static constexpr uint32_t CULL_WORKGROUP_SIZE = 64;
+	// Matches local_size_x of cluster.task, one thread per meshlet
+	static constexpr uint32_t TASK_WORKGROUP_SIZE = 32;
+
+	ClusterRenderSystem(Device& device, VkRenderPass renderPass, uint32_t framesInFlight, bool useMeshShaders, bool backfaceCulling);
+	~ClusterRenderSystem();
+
+	// Not copyable or movable
+	ClusterRenderSystem(const ClusterRenderSystem&) = delete;
+	ClusterRenderSystem& operator=(const ClusterRenderSystem&) = delete;
+
+	// Rebuilds the pipelines when their shaders change, until this system is destroyed
+	void enableHotReload(ShaderReloader& shaderReloader);
+
+	// Records the culling dispatch for every object whose Model has meshlets, must be called outside the render pass
+	void cullClusters(FrameInfo& frameInfo, const std::vector<RenderableComponent>& objects, const TransformStore& transforms);
+	// Records the draws for the objects passed to the last cullClusters call
+	void renderClusters(FrameInfo& frameInfo);
+	// Makes this frame's culling counts readable once it completes, must be called after the render pass
+	void finishFrame(FrameInfo& frameInfo);
+
+	bool usesMeshShaders() const { return m_UseMeshShaders; }
+	// Counts are read back when a frame slot comes round again, so they trail by the number of frames in flight
+	const Stats& getLastFrameStats() const { return m_LastFrameStats; }
+	void printStats() const;
+
+private:
+	// Matches Stats in the cluster shaders
+	struct GpuStats {
+		uint32_t culledClusters;
+		uint32_t culledTriangles;
+	};
+
+	struct FrameResources {
+		VkBuffer objectBuffer = VK_NULL_HANDLE;
+		Allocation objectAllocation;
+		VkBuffer indexBuffer = VK_NULL_HANDLE;
+		Allocation indexAllocation;
+		VkBuffer drawBuffer = VK_NULL_HANDLE;
+		Allocation drawAllocation;
+		VkBuffer statsBuffer = VK_NULL_HANDLE;
+		Allocation statsAllocation;
+		uint32_t objectCapacity = 0;
+		VkDeviceSize indexCapacity = 0;
+		uint32_t drawCapacity = 0;
+		// Totals of the frame last recorded into this slot, paired with its GPU counts on read back
+		bool statsPending = false;
+		uint64_t clusters = 0;
+		uint64_t triangles = 0;
+	};
+
+	// One per distinct Model, more when its clusters overflow the index values. Its objects are contiguous in the object buffer
+	struct ModelDraw {
+		Model* model;
+		uint32_t objectBase;
+		uint32_t objectCount;
+		uint32_t indexBase;
+		VkDescriptorSet descriptorSet;
+	};
+
+	Device& m_Device;
+	bool m_UseMeshShaders;
+	bool m_BackfaceCulling;
+	uint32_t m_MaxClustersPerDraw;		// That the index values of one draw can name
+	VkShaderStageFlags m_GraphicsStages;
+	std::unique_ptr<Pipeline> m_Pipeline;
+	std::unique_ptr<ComputePipeline> m_CullPipeline;		// Null with mesh shaders, the task shader culls
+	VkDescriptorSetLayout m_DescriptorSetLayout;
+	VkPipelineLayout m_PipelineLayout;
+	VkPipelineLayout m_CullPipelineLayout;
+	VkRenderPass m_RenderPass;
+	ShaderReloader* m_ShaderReloader = nullptr;
+	std::vector<FrameResources> m_Frames;
+
+	std::unordered_map<Model*, uint32_t> m_DrawIndices;
+	std::vector<ModelDraw> m_Draws;
+	std::vector<uint32_t> m_ObjectOrder;
+	std::vector<VkDrawIndexedIndirectCommand> m_DrawCommands;
+	Stats m_LastFrameStats;
+	Stats m_TotalStats;
+	uint32_t m_StatsFrames = 0;
+
+	void m_CreateDescriptorSetLayout();
+	void m_CreatePipelineLayouts();
+	void m_CreatePipelines(VkRenderPass renderPass);
+	std::unique_ptr<Pipeline> m_CreateDrawPipeline() const;
+	std::unique_ptr<ComputePipeline> m_CreateCullPipeline() const;
+	void m_ReserveFrame(int frameIndex, uint32_t objectCount, VkDeviceSize indexCount, uint32_t drawCount);
+	void m_ReadStats(FrameResources& frame);
+	void m_DestroyFrameBuffers(FrameResources& frame);
+};
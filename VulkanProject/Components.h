@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Model.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <memory>
+
+// Built-in components stored in the Registry
+
+struct Transform2DComponent {
+	glm::vec2 translation{};
+	glm::vec2 scale{ 1.0f ,1.0f };
+	float rotation = 0.0f;				// Will use RADIANS
+	
+	glm::mat2 mat2() const {
+		const float sin = glm::sin(rotation);
+		const float cos = glm::cos(rotation);
+		glm::mat2 rotMat = { {cos, sin}, {-sin, cos} };
+
+		glm::mat2 scaleMat{ {scale.x, 0.0f}, {0.0f, scale.y} };
+		return rotMat * scaleMat;
+	};
+};
+
+// Drawn by the render systems, every Renderable entity also needs a Transform2DComponent
+struct RenderableComponent {
+	std::shared_ptr<Model> model{};
+	glm::vec3 colour{};
+};
+
+// Applied by the Simulation each fixed step
+struct VelocityComponent {
+	glm::vec2 linear{};					// NDC units per second
+	float angular = 0.0f;				// Radians per second
+};
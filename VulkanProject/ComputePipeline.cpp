@@ -0,0 +1,64 @@
+#include "ComputePipeline.h"
+
+#include "Pipeline.h"
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <cassert>
+
+ComputePipeline::ComputePipeline(Device& device, VkPipelineLayout pipelineLayout, const std::string& computeFilePath)
+	: m_Device(device)
+{
+	m_CreateComputePipeline(pipelineLayout, computeFilePath);
+}
+
+ComputePipeline::~ComputePipeline()
+{
+	vkDestroyShaderModule(m_Device.device(), m_ComputeShaderModule, nullptr);
+	vkDestroyPipeline(m_Device.device(), m_ComputePipeline, nullptr);
+}
+
+void ComputePipeline::bind(VkCommandBuffer commandBuffer)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ComputePipeline);
+}
+
+void ComputePipeline::m_CreateComputePipeline(VkPipelineLayout pipelineLayout, const std::string& computeFilePath)
+{
+	assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline: no pipelineLayout provided");
+	std::vector<char> computeCode = Pipeline::readFile(computeFilePath);
+	Pipeline::checkSpirv(computeCode, computeFilePath);
+
+	VkShaderModuleCreateInfo moduleInfo{};
+	moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	moduleInfo.codeSize = computeCode.size();
+	moduleInfo.pCode = reinterpret_cast<const uint32_t*>(computeCode.data());
+
+	if (vkCreateShaderModule(m_Device.device(), &moduleInfo, nullptr, &m_ComputeShaderModule) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create shader module");
+	}
+
+	VkPipelineShaderStageCreateInfo stageInfo{};
+	stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	stageInfo.module = m_ComputeShaderModule;
+	stageInfo.pName = "main";
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = stageInfo;
+	pipelineInfo.layout = pipelineLayout;
+	pipelineInfo.basePipelineIndex = -1;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+	auto createStart = std::chrono::high_resolution_clock::now();
+	if (vkCreateComputePipelines(m_Device.device(), m_Device.pipelineCache(), 1, &pipelineInfo, nullptr, &m_ComputePipeline) != VK_SUCCESS)
+	{
+		vkDestroyShaderModule(m_Device.device(), m_ComputeShaderModule, nullptr);
+		throw std::runtime_error("Failed to create compute pipeline");
+	}
+	auto createTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - createStart).count();
+	std::cout << "Created pipeline " << computeFilePath << " in " << createTime << " ms" << std::endl;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Device.h"
+
+#include <string>
+#include <vector>
+
+class ComputePipeline
+{
+public:
+	ComputePipeline(Device& device, VkPipelineLayout pipelineLayout, const std::string& computeFilePath);
+	~ComputePipeline();
+
+	// Not copyable or movable
+	ComputePipeline(const ComputePipeline&) = delete;
+	ComputePipeline& operator=(const ComputePipeline&) = delete;
+
+	void bind(VkCommandBuffer commandBuffer);
+
+private:
+	Device& m_Device;
+	VkPipeline m_ComputePipeline;
+	VkShaderModule m_ComputeShaderModule;
+
+	void m_CreateComputePipeline(VkPipelineLayout pipelineLayout, const std::string& computeFilePath);
+};
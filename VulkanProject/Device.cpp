@@ -1,8 +1,14 @@
 #include "Device.h"
 
+#include "StagingRing.h"
+
 // std headers
+#include <cassert>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <set>
 #include <unordered_set>
 
@@ -48,16 +54,34 @@ void DestroyDebugUtilsMessengerEXT(
 }
 
 // class member functions
-Device::Device(Window& m_Window) : m_Window{ m_Window } {
+Device::Device(Window* window) : m_Window{ window } {
+    if (isHeadless()) {
+        m_DeviceExtensions.clear();
+    }
     createInstance();
     setupDebugMessenger();
     createSurface();
     pickPhysicalDevice();
+    detectOptionalFeatures();
     createLogicalDevice();
+    createTimelines();
     createCommandPool();
+    createAllocator();
+    createStagingRing();
+    createPipelineCache();
 }
 
 Device::~Device() {
+    vkDeviceWaitIdle(m_Device);
+    flushDeferredDestruction();
+    savePipelineCache();
+    vkDestroyPipelineCache(m_Device, m_PipelineCache, nullptr);
+    m_StagingRing.reset();
+    m_Allocator.reset();
+    vkDestroySemaphore(m_Device, m_GraphicsTimeline.semaphore, nullptr);
+    if (m_ComputeTimeline.semaphore != m_GraphicsTimeline.semaphore) {
+        vkDestroySemaphore(m_Device, m_ComputeTimeline.semaphore, nullptr);
+    }
     vkDestroyCommandPool(m_Device, m_CommandPool, nullptr);
     vkDestroyDevice(m_Device, nullptr);
 
@@ -65,7 +89,9 @@ Device::~Device() {
         DestroyDebugUtilsMessengerEXT(m_Instance, m_DebugMessenger, nullptr);
     }
 
-    vkDestroySurfaceKHR(m_Instance, m_Surface, nullptr);
+    if (m_Surface != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(m_Instance, m_Surface, nullptr);
+    }
     vkDestroyInstance(m_Instance, nullptr);
 }
 
@@ -80,7 +106,8 @@ void Device::createInstance() {
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    // The highest version used, optional features such as mesh shaders need it and are only enabled on devices that have it
+    appInfo.apiVersion = VK_API_VERSION_1_2;
 
     VkInstanceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -135,11 +162,52 @@ void Device::pickPhysicalDevice() {
     std::cout << "physical device: " << properties.deviceName << std::endl;
 }
 
+void Device::detectOptionalFeatures() {
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(m_PhysicalDevice, &supportedFeatures);
+    m_FullDrawIndexUint32 = supportedFeatures.fullDrawIndexUint32 == VK_TRUE;
+
+    // Mesh shaders need SPIR-V 1.4, core from Vulkan 1.2
+    if (VK_API_VERSION_MAJOR(properties.apiVersion) == 1 && VK_API_VERSION_MINOR(properties.apiVersion) < 2) {
+        return;
+    }
+
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(m_PhysicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(m_PhysicalDevice, nullptr, &extensionCount, availableExtensions.data());
+    bool hasMeshShaderExtension = false;
+    for (const auto& extension : availableExtensions) {
+        hasMeshShaderExtension |= std::strcmp(extension.extensionName, VK_EXT_MESH_SHADER_EXTENSION_NAME) == 0;
+    }
+    if (!hasMeshShaderExtension) {
+        return;
+    }
+
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &meshShaderFeatures;
+    vkGetPhysicalDeviceFeatures2(m_PhysicalDevice, &features);
+
+    m_MeshShaderSupported = meshShaderFeatures.taskShader && meshShaderFeatures.meshShader;
+    if (m_MeshShaderSupported) {
+        m_DeviceExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+    }
+    std::cout << "mesh shaders: " << (m_MeshShaderSupported ? "supported" : "not supported") << std::endl;
+}
+
+void Device::cmdDrawMeshTasks(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) {
+    assert(m_CmdDrawMeshTasks && "Mesh shaders are not supported by this device");
+    m_CmdDrawMeshTasks(commandBuffer, groupCountX, groupCountY, groupCountZ);
+}
+
 void Device::createLogicalDevice() {
     QueueFamilyIndices indices = findQueueFamilies(m_PhysicalDevice);
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily, indices.computeFamily };
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -153,6 +221,7 @@ void Device::createLogicalDevice() {
 
     VkPhysicalDeviceFeatures deviceFeatures = {};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
+    deviceFeatures.fullDrawIndexUint32 = m_FullDrawIndexUint32 ? VK_TRUE : VK_FALSE;
 
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -161,6 +230,20 @@ void Device::createLogicalDevice() {
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
     createInfo.pEnabledFeatures = &deviceFeatures;
+
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12Features.timelineSemaphore = VK_TRUE;
+    createInfo.pNext = &vulkan12Features;
+
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    if (m_MeshShaderSupported) {
+        meshShaderFeatures.taskShader = VK_TRUE;
+        meshShaderFeatures.meshShader = VK_TRUE;
+        vulkan12Features.pNext = &meshShaderFeatures;
+    }
+
     createInfo.enabledExtensionCount = static_cast<uint32_t>(m_DeviceExtensions.size());
     createInfo.ppEnabledExtensionNames = m_DeviceExtensions.data();
 
@@ -180,6 +263,11 @@ void Device::createLogicalDevice() {
 
     vkGetDeviceQueue(m_Device, indices.graphicsFamily, 0, &m_GraphicsQueue);
     vkGetDeviceQueue(m_Device, indices.presentFamily, 0, &m_PresentQueue);
+    vkGetDeviceQueue(m_Device, indices.computeFamily, 0, &m_ComputeQueue);
+
+    if (m_MeshShaderSupported) {
+        m_CmdDrawMeshTasks = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(vkGetDeviceProcAddr(m_Device, "vkCmdDrawMeshTasksEXT"));
+    }
 }
 
 void Device::createCommandPool() {
@@ -196,15 +284,113 @@ void Device::createCommandPool() {
     }
 }
 
-void Device::createSurface() { m_Window.createWindowSurface(m_Instance, &m_Surface); }
+void Device::createAllocator() {
+    m_Allocator = std::make_unique<MemoryAllocator>(m_PhysicalDevice, m_Device);
+
+    // Integrated GPUs read host visible memory at full speed, so staging copies are pure overhead
+    if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU ||
+        properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU) {
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vkGetPhysicalDeviceMemoryProperties(m_PhysicalDevice, &memProperties);
+        const VkMemoryPropertyFlags unifiedFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+            if ((memProperties.memoryTypes[i].propertyFlags & unifiedFlags) == unifiedFlags) {
+                m_UnifiedMemory = true;
+                break;
+            }
+        }
+    }
+}
+
+void Device::createStagingRing() { m_StagingRing = std::make_unique<StagingRing>(*this); }
+
+void Device::createPipelineCache() {
+    std::vector<char> cacheData;
+    std::ifstream file(PIPELINE_CACHE_FILE, std::ios::ate | std::ios::binary);
+    if (file.is_open()) {
+        cacheData.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(cacheData.data(), cacheData.size());
+        if (!file || !isPipelineCacheCompatible(cacheData)) {
+            std::cout << "Discarding stale or corrupt pipeline cache " << PIPELINE_CACHE_FILE << std::endl;
+            cacheData.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo = {};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = cacheData.size();
+    cacheInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+    // The driver may still refuse data that passed the header check, fall back to an empty cache
+    if (vkCreatePipelineCache(m_Device, &cacheInfo, nullptr, &m_PipelineCache) != VK_SUCCESS) {
+        cacheInfo.initialDataSize = 0;
+        cacheInfo.pInitialData = nullptr;
+        if (vkCreatePipelineCache(m_Device, &cacheInfo, nullptr, &m_PipelineCache) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+    }
+    else if (!cacheData.empty()) {
+        std::cout << "Loaded pipeline cache (" << cacheData.size() << " bytes)" << std::endl;
+    }
+}
+
+void Device::savePipelineCache() {
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(m_Device, m_PipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+        return;
+    }
+    std::vector<char> cacheData(dataSize);
+    if (vkGetPipelineCacheData(m_Device, m_PipelineCache, &dataSize, cacheData.data()) != VK_SUCCESS) {
+        return;
+    }
+
+    // Write next to the real file then swap, so a crash mid-write never leaves a truncated cache
+    const std::string tempPath = std::string(PIPELINE_CACHE_FILE) + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cout << "Failed to write pipeline cache " << tempPath << std::endl;
+            return;
+        }
+        file.write(cacheData.data(), dataSize);
+        if (!file) {
+            return;
+        }
+    }
+    std::remove(PIPELINE_CACHE_FILE);
+    std::rename(tempPath.c_str(), PIPELINE_CACHE_FILE);
+}
+
+bool Device::isPipelineCacheCompatible(const std::vector<char>& cacheData) {
+    VkPipelineCacheHeaderVersionOne header;
+    if (cacheData.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, cacheData.data(), sizeof(header));
+
+    return header.headerSize >= sizeof(header) &&
+        header.headerSize <= cacheData.size() &&
+        header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+        header.vendorID == properties.vendorID &&
+        header.deviceID == properties.deviceID &&
+        std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void Device::createSurface() {
+    if (!isHeadless()) {
+        m_Window->createWindowSurface(m_Instance, &m_Surface);
+    }
+}
 
 bool Device::isDeviceSuitable(VkPhysicalDevice device) {
     QueueFamilyIndices indices = findQueueFamilies(device);
 
     bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-    bool swapChainAdequate = false;
-    if (extensionsSupported) {
+    bool swapChainAdequate = isHeadless();
+    if (extensionsSupported && !isHeadless()) {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
     }
@@ -212,8 +398,22 @@ bool Device::isDeviceSuitable(VkPhysicalDevice device) {
     VkPhysicalDeviceFeatures supportedFeatures;
     vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
+    // Frame synchronisation is built on timeline semaphores, core from Vulkan 1.2
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    bool timelineSemaphoresSupported = false;
+    if (VK_API_VERSION_MAJOR(deviceProperties.apiVersion) > 1 || VK_API_VERSION_MINOR(deviceProperties.apiVersion) >= 2) {
+        VkPhysicalDeviceVulkan12Features vulkan12Features{};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &vulkan12Features;
+        vkGetPhysicalDeviceFeatures2(device, &features);
+        timelineSemaphoresSupported = vulkan12Features.timelineSemaphore;
+    }
+
     return indices.isComplete() && extensionsSupported && swapChainAdequate &&
-        supportedFeatures.samplerAnisotropy;
+        supportedFeatures.samplerAnisotropy && timelineSemaphoresSupported;
 }
 
 void Device::populateDebugMessengerCreateInfo(
@@ -264,11 +464,13 @@ bool Device::checkValidationLayerSupport() {
 }
 
 std::vector<const char*> Device::getRequiredExtensions() {
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    std::vector<const char*> extensions;
+    if (!isHeadless()) {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     if (enableValidationLayers) {
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -331,23 +533,41 @@ QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice device) {
 
     int i = 0;
     for (const auto& queueFamily : queueFamilies) {
-        if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT &&
+            !indices.graphicsFamilyHasValue) {
             indices.graphicsFamily = i;
             indices.graphicsFamilyHasValue = true;
         }
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_Surface, &presentSupport);
-        if (queueFamily.queueCount > 0 && presentSupport) {
+        if (!isHeadless()) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_Surface, &presentSupport);
+        }
+        if (queueFamily.queueCount > 0 && presentSupport && !indices.presentFamilyHasValue) {
             indices.presentFamily = i;
             indices.presentFamilyHasValue = true;
         }
-        if (indices.isComplete()) {
-            break;
+        // Prefer a compute family without graphics so async compute can overlap the frame
+        if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT &&
+            !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+            indices.computeFamily = i;
+            indices.computeFamilyHasValue = true;
         }
 
         i++;
     }
 
+    // Nothing is presented when headless, the present queue just aliases the graphics queue
+    if (isHeadless() && indices.graphicsFamilyHasValue) {
+        indices.presentFamily = indices.graphicsFamily;
+        indices.presentFamilyHasValue = true;
+    }
+
+    // Every graphics family on a conformant device also supports compute
+    if (!indices.computeFamilyHasValue && indices.graphicsFamilyHasValue) {
+        indices.computeFamily = indices.graphicsFamily;
+        indices.computeFamilyHasValue = true;
+    }
+
     return indices;
 }
 
@@ -395,16 +615,7 @@ VkFormat Device::findSupportedFormat(
 }
 
 uint32_t Device::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(m_PhysicalDevice, &memProperties);
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) &&
-            (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
-        }
-    }
-
-    throw std::runtime_error("failed to find suitable memory type!");
+    return m_Allocator->findMemoryType(typeFilter, properties);
 }
 
 void Device::createBuffer(
@@ -412,7 +623,7 @@ void Device::createBuffer(
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer& buffer,
-    VkDeviceMemory& bufferMemory) {
+    Allocation& bufferAllocation) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
@@ -426,18 +637,53 @@ void Device::createBuffer(
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(m_Device, buffer, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+    bufferAllocation = m_Allocator->allocate(memRequirements, properties, true);
 
-    if (vkAllocateMemory(m_Device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate vertex buffer memory!");
+    if (vkBindBufferMemory(m_Device, buffer, bufferAllocation.memory, bufferAllocation.offset) != VK_SUCCESS) {
+        throw std::runtime_error("failed to bind buffer memory!");
     }
+}
+
+void Device::destroyBuffer(VkBuffer buffer, Allocation& bufferAllocation) {
+    vkDestroyBuffer(m_Device, buffer, nullptr);
+    m_Allocator->free(bufferAllocation);
+}
+
+uint64_t Device::createDeviceLocalBuffer(
+    VkDeviceSize size,
+    VkBufferUsageFlags usage,
+    const void* data,
+    VkBuffer& buffer,
+    Allocation& bufferAllocation) {
+    if (m_UnifiedMemory) {
+        createBuffer(
+            size,
+            usage,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            buffer,
+            bufferAllocation);
+        memcpy(bufferAllocation.mappedData, data, static_cast<size_t>(size));
+        return 0;
+    }
+
+    createBuffer(
+        size,
+        usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        buffer,
+        bufferAllocation);
+    return m_StagingRing->upload(buffer, 0, data, size);
+}
 
-    vkBindBufferMemory(m_Device, buffer, bufferMemory, 0);
+uint64_t Device::uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size) {
+    return m_StagingRing->upload(dstBuffer, dstOffset, data, size);
 }
 
+void Device::flushUploads() { m_StagingRing->flush(); }
+
+bool Device::isUploadComplete(uint64_t ticket) { return m_StagingRing->isComplete(ticket); }
+
 VkCommandBuffer Device::beginSingleTimeCommands() {
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -464,8 +710,7 @@ void Device::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
-    vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(m_GraphicsQueue);
+    waitForTimeline(QueueType::Graphics, submit(QueueType::Graphics, submitInfo));
 
     vkFreeCommandBuffers(m_Device, m_CommandPool, 1, &commandBuffer);
 }
@@ -513,7 +758,7 @@ void Device::createImageWithInfo(
     const VkImageCreateInfo& imageInfo,
     VkMemoryPropertyFlags properties,
     VkImage& image,
-    VkDeviceMemory& imageMemory) {
+    Allocation& imageAllocation) {
     if (vkCreateImage(m_Device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
         throw std::runtime_error("failed to create image!");
     }
@@ -521,16 +766,190 @@ void Device::createImageWithInfo(
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(m_Device, image, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+    imageAllocation = m_Allocator->allocate(
+        memRequirements,
+        properties,
+        imageInfo.tiling == VK_IMAGE_TILING_LINEAR);
 
-    if (vkAllocateMemory(m_Device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate image memory!");
+    if (vkBindImageMemory(m_Device, image, imageAllocation.memory, imageAllocation.offset) != VK_SUCCESS) {
+        throw std::runtime_error("failed to bind image memory!");
     }
+}
 
-    if (vkBindImageMemory(m_Device, image, imageMemory, 0) != VK_SUCCESS) {
-        throw std::runtime_error("failed to bind image memory!");
+void Device::destroyImage(VkImage image, Allocation& imageAllocation) {
+    vkDestroyImage(m_Device, image, nullptr);
+    m_Allocator->free(imageAllocation);
+}
+
+void Device::deferDestroy(std::function<void()> destroy) {
+    std::lock_guard<std::mutex> lock(m_DeletionMutex);
+    m_UnstampedDeletions.push_back(std::move(destroy));
+}
+
+void Device::deferDestroyBuffer(VkBuffer buffer, Allocation& bufferAllocation) {
+    Allocation allocation = bufferAllocation;
+    deferDestroy([this, buffer, allocation]() mutable { destroyBuffer(buffer, allocation); });
+}
+
+void Device::deferDestroyImage(VkImage image, Allocation& imageAllocation) {
+    Allocation allocation = imageAllocation;
+    deferDestroy([this, image, allocation]() mutable { destroyImage(image, allocation); });
+}
+
+void Device::deferDestroyImageView(VkImageView imageView) {
+    deferDestroy([this, imageView]() { vkDestroyImageView(m_Device, imageView, nullptr); });
+}
+
+void Device::deferDestroyFramebuffer(VkFramebuffer framebuffer) {
+    deferDestroy([this, framebuffer]() { vkDestroyFramebuffer(m_Device, framebuffer, nullptr); });
+}
+
+void Device::deferDestroyPipeline(VkPipeline pipeline) {
+    deferDestroy([this, pipeline]() { vkDestroyPipeline(m_Device, pipeline, nullptr); });
+}
+
+void Device::markFrameSubmitted(uint64_t timelineValue) {
+    std::lock_guard<std::mutex> lock(m_DeletionMutex);
+    for (auto& destroy : m_UnstampedDeletions) {
+        m_DeletionQueue.push_back({ timelineValue, std::move(destroy) });
+    }
+    m_UnstampedDeletions.clear();
+}
+
+void Device::collectGarbage() {
+    const uint64_t completed = completedValue(QueueType::Graphics);
+
+    // Destroyed outside the lock, a destructor may release more objects
+    std::vector<DeferredDestroy> expired;
+    {
+        std::lock_guard<std::mutex> lock(m_DeletionMutex);
+        while (!m_DeletionQueue.empty() && m_DeletionQueue.front().timelineValue <= completed) {
+            expired.push_back(std::move(m_DeletionQueue.front()));
+            m_DeletionQueue.pop_front();
+        }
+    }
+    for (DeferredDestroy& entry : expired) {
+        entry.destroy();
+    }
+}
+
+void Device::flushDeferredDestruction() {
+    // Destroying an object can queue another, so keep going until nothing is left
+    for (;;) {
+        std::deque<DeferredDestroy> remaining;
+        std::vector<std::function<void()>> unstamped;
+        {
+            std::lock_guard<std::mutex> lock(m_DeletionMutex);
+            remaining.swap(m_DeletionQueue);
+            unstamped.swap(m_UnstampedDeletions);
+        }
+        if (remaining.empty() && unstamped.empty()) {
+            return;
+        }
+        for (DeferredDestroy& entry : remaining) {
+            entry.destroy();
+        }
+        for (auto& destroy : unstamped) {
+            destroy();
+        }
+    }
+}
+
+void Device::createTimelines() {
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+
+    m_GraphicsTimeline.queue = m_GraphicsQueue;
+    if (vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &m_GraphicsTimeline.semaphore) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timeline semaphore!");
+    }
+
+    // Submissions to one queue must signal its values in order, so a shared queue shares its timeline
+    m_ComputeTimeline.queue = m_ComputeQueue;
+    if (m_ComputeQueue == m_GraphicsQueue) {
+        m_ComputeTimeline.semaphore = m_GraphicsTimeline.semaphore;
+    }
+    else if (vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &m_ComputeTimeline.semaphore) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timeline semaphore!");
     }
-}
\ No newline at end of file
+}
+
+Device::QueueTimeline& Device::timelineFor(QueueType queue) {
+    if (queue == QueueType::Compute && m_ComputeTimeline.semaphore != m_GraphicsTimeline.semaphore) {
+        return m_ComputeTimeline;
+    }
+    return m_GraphicsTimeline;
+}
+
+uint64_t Device::submit(
+    QueueType queue,
+    const VkSubmitInfo& submitInfo,
+    const std::vector<TimelinePoint>& waits,
+    VkPipelineStageFlags waitStages) {
+    std::lock_guard<std::mutex> lock(m_SubmitMutex);
+    QueueTimeline& timeline = timelineFor(queue);
+
+    // Binary semaphores take no value, zero keeps the value arrays lined up with the semaphores
+    std::vector<VkSemaphore> waitSemaphores(submitInfo.pWaitSemaphores, submitInfo.pWaitSemaphores + submitInfo.waitSemaphoreCount);
+    std::vector<VkPipelineStageFlags> waitStageMasks(submitInfo.pWaitDstStageMask, submitInfo.pWaitDstStageMask + submitInfo.waitSemaphoreCount);
+    std::vector<uint64_t> waitValues(submitInfo.waitSemaphoreCount, 0);
+    for (const TimelinePoint& wait : waits) {
+        waitSemaphores.push_back(timelineFor(wait.queue).semaphore);
+        waitStageMasks.push_back(waitStages);
+        waitValues.push_back(wait.value);
+    }
+
+    std::vector<VkSemaphore> signalSemaphores(submitInfo.pSignalSemaphores, submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+    std::vector<uint64_t> signalValues(submitInfo.signalSemaphoreCount, 0);
+    const uint64_t value = timeline.submittedValue + 1;
+    signalSemaphores.push_back(timeline.semaphore);
+    signalValues.push_back(value);
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+    timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+    VkSubmitInfo timelineSubmit = submitInfo;
+    timelineSubmit.pNext = &timelineInfo;
+    timelineSubmit.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+    timelineSubmit.pWaitSemaphores = waitSemaphores.data();
+    timelineSubmit.pWaitDstStageMask = waitStageMasks.data();
+    timelineSubmit.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+    timelineSubmit.pSignalSemaphores = signalSemaphores.data();
+
+    if (vkQueueSubmit(timeline.queue, 1, &timelineSubmit, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit command buffers!");
+    }
+    timeline.submittedValue = value;
+    return value;
+}
+
+uint64_t Device::submittedValue(QueueType queue) {
+    std::lock_guard<std::mutex> lock(m_SubmitMutex);
+    return timelineFor(queue).submittedValue;
+}
+
+uint64_t Device::completedValue(QueueType queue) {
+    uint64_t value = 0;
+    vkGetSemaphoreCounterValue(m_Device, timelineFor(queue).semaphore, &value);
+    return value;
+}
+
+void Device::waitForTimeline(QueueType queue, uint64_t value) {
+    VkSemaphore semaphore = timelineFor(queue).semaphore;
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &semaphore;
+    waitInfo.pValues = &value;
+    vkWaitSemaphores(m_Device, &waitInfo, std::numeric_limits<uint64_t>::max());
+}
@@ -1,11 +1,18 @@
 #pragma once
 
 #include "Window.h"
+#include "MemoryAllocator.h"
 
 // std lib headers
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+class StagingRing;
 
 struct SwapChainSupportDetails {
     VkSurfaceCapabilitiesKHR capabilities;
@@ -16,13 +23,28 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
     uint32_t graphicsFamily;
     uint32_t presentFamily;
+    uint32_t computeFamily;
     bool graphicsFamilyHasValue = false;
     bool presentFamilyHasValue = false;
+    bool computeFamilyHasValue = false;
     bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
+enum class QueueType {
+    Graphics,
+    Compute
+};
+
+// A value on one queue's timeline semaphore
+struct TimelinePoint {
+    QueueType queue;
+    uint64_t value;
+};
+
 class Device {
 public:
+    static constexpr const char* PIPELINE_CACHE_FILE = "pipeline_cache.bin";
+
 #ifdef NDEBUG
     const bool enableValidationLayers = false;
 #else
@@ -31,7 +53,8 @@ public:
 
     VkPhysicalDeviceProperties properties;
 
-    Device(Window& m_Window);
+    // Pass a null window to run headless, without a surface or swapchain extension
+    Device(Window* window);
     ~Device();
 
     // Not copyable or movable
@@ -42,9 +65,23 @@ public:
 
     VkCommandPool getCommandPool() { return m_CommandPool; }
     VkDevice device() { return m_Device; }
+    VkPhysicalDevice physicalDevice() { return m_PhysicalDevice; }
     VkSurfaceKHR surface() { return m_Surface; }
+    bool isHeadless() const { return m_Window == nullptr; }
     VkQueue graphicsQueue() { return m_GraphicsQueue; }
     VkQueue presentQueue() { return m_PresentQueue; }
+    VkQueue computeQueue() { return m_ComputeQueue; }
+    MemoryAllocator& allocator() { return *m_Allocator; }
+    VkPipelineCache pipelineCache() { return m_PipelineCache; }
+    bool hasUnifiedMemory() { return m_UnifiedMemory; }
+    // VK_EXT_mesh_shader with task and mesh shaders, enabled whenever the device has it
+    bool supportsMeshShaders() const { return m_MeshShaderSupported; }
+    // Largest usable index value, 2^24 - 1 unless fullDrawIndexUint32 could be enabled
+    uint32_t maxDrawIndexValue() const {
+        return m_FullDrawIndexUint32 ? properties.limits.maxDrawIndexedIndexValue
+            : std::min<uint32_t>(properties.limits.maxDrawIndexedIndexValue, (1u << 24) - 1);
+    }
+    void cmdDrawMeshTasks(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
 
     SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(m_PhysicalDevice); }
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -58,7 +95,19 @@ public:
         VkBufferUsageFlags usage,
         VkMemoryPropertyFlags properties,
         VkBuffer& buffer,
-        VkDeviceMemory& bufferMemory);
+        Allocation& bufferAllocation);
+    void destroyBuffer(VkBuffer buffer, Allocation& bufferAllocation);
+    // Creates a buffer the GPU reads from device local memory, filled with data via the staging ring.
+    // Returns the upload ticket to pass to isUploadComplete, 0 when the data is already in place
+    uint64_t createDeviceLocalBuffer(
+        VkDeviceSize size,
+        VkBufferUsageFlags usage,
+        const void* data,
+        VkBuffer& buffer,
+        Allocation& bufferAllocation);
+    uint64_t uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+    void flushUploads();
+    bool isUploadComplete(uint64_t ticket);
     VkCommandBuffer beginSingleTimeCommands();
     void endSingleTimeCommands(VkCommandBuffer commandBuffer);
     void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
@@ -69,29 +118,91 @@ public:
         const VkImageCreateInfo& imageInfo,
         VkMemoryPropertyFlags properties,
         VkImage& image,
-        VkDeviceMemory& imageMemory);
+        Allocation& imageAllocation);
+    void destroyImage(VkImage image, Allocation& imageAllocation);
+
+    // Every queue has a timeline semaphore that each submission to it signals with the next value, shared when
+    // graphics and compute are the same queue. submit returns the value, binary semaphores in submitInfo are kept
+    // for acquire and present and waits adds dependencies on other work. Safe to call from any thread
+    uint64_t submit(
+        QueueType queue,
+        const VkSubmitInfo& submitInfo,
+        const std::vector<TimelinePoint>& waits = {},
+        VkPipelineStageFlags waitStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    uint64_t submittedValue(QueueType queue);
+    uint64_t completedValue(QueueType queue);
+    void waitForTimeline(QueueType queue, uint64_t value);
+
+    // Deferred destruction, for objects a frame in flight may still be using. Each one waits for the graphics
+    // timeline value of the next frame submitted, as any frame using it is submitted by then. Safe to call from any thread
+    void deferDestroy(std::function<void()> destroy);
+    void deferDestroyBuffer(VkBuffer buffer, Allocation& bufferAllocation);
+    void deferDestroyImage(VkImage image, Allocation& imageAllocation);
+    void deferDestroyImageView(VkImageView imageView);
+    void deferDestroyFramebuffer(VkFramebuffer framebuffer);
+    void deferDestroyPipeline(VkPipeline pipeline);
+    // Called by Renderer after submitting a frame, everything released since the previous one waits for timelineValue
+    void markFrameSubmitted(uint64_t timelineValue);
+    // Destroys everything whose graphics timeline value has been reached
+    void collectGarbage();
+    // Destroys everything still queued, the device must be idle
+    void flushDeferredDestruction();
 
 private:
     VkInstance m_Instance;
     VkDebugUtilsMessengerEXT m_DebugMessenger;
     VkPhysicalDevice m_PhysicalDevice = VK_NULL_HANDLE;
-    Window& m_Window;
+    Window* m_Window;
     VkCommandPool m_CommandPool;
 
     VkDevice m_Device;
-    VkSurfaceKHR m_Surface;
+    VkSurfaceKHR m_Surface = VK_NULL_HANDLE;
     VkQueue m_GraphicsQueue;
     VkQueue m_PresentQueue;
+    VkQueue m_ComputeQueue;
+    std::unique_ptr<MemoryAllocator> m_Allocator;
+    std::unique_ptr<StagingRing> m_StagingRing;
+    bool m_UnifiedMemory = false;
+    bool m_MeshShaderSupported = false;
+    bool m_FullDrawIndexUint32 = false;
+    PFN_vkCmdDrawMeshTasksEXT m_CmdDrawMeshTasks = nullptr;
+    VkPipelineCache m_PipelineCache = VK_NULL_HANDLE;
+
+    struct QueueTimeline {
+        VkQueue queue = VK_NULL_HANDLE;
+        VkSemaphore semaphore = VK_NULL_HANDLE;
+        uint64_t submittedValue = 0;
+    };
+    // Queue submission is externally synchronised, this also keeps each timeline's values in submission order
+    std::mutex m_SubmitMutex;
+    QueueTimeline m_GraphicsTimeline;
+    QueueTimeline m_ComputeTimeline;
+
+    struct DeferredDestroy {
+        uint64_t timelineValue;
+        std::function<void()> destroy;
+    };
+    // Values only grow, so the oldest releases are always at the front
+    std::mutex m_DeletionMutex;
+    std::vector<std::function<void()>> m_UnstampedDeletions;
+    std::deque<DeferredDestroy> m_DeletionQueue;
 
     const std::vector<const char*> m_ValidationLayers = { "VK_LAYER_KHRONOS_validation" };
-    const std::vector<const char*> m_DeviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+    std::vector<const char*> m_DeviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
     void createInstance();
     void setupDebugMessenger();
     void createSurface();
     void pickPhysicalDevice();
+    void detectOptionalFeatures();
     void createLogicalDevice();
     void createCommandPool();
+    void createAllocator();
+    void createStagingRing();
+    void createPipelineCache();
+    void createTimelines();
+    void savePipelineCache();
+    QueueTimeline& timelineFor(QueueType queue);
 
     // helper functions
     bool isDeviceSuitable(VkPhysicalDevice device);
@@ -102,4 +213,5 @@ private:
     void hasGflwRequiredInstanceExtensions();
     bool checkDeviceExtensionSupport(VkPhysicalDevice device);
     SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
+    bool isPipelineCacheCompatible(const std::vector<char>& cacheData);
 };
\ No newline at end of file
@@ -0,0 +1,214 @@
+#include "FrameContext.h"
+
+#include "Profiler.h"
+
+#include <array>
+#include <cassert>
+#include <stdexcept>
+
+FrameContext::FrameContext(Device& device)
+	: m_Device(device)
+{
+	m_CreateCommandBuffer();
+	m_CreateSyncObjects();
+	m_DescriptorPools.push_back(m_CreateDescriptorPool());
+	m_UploadArena = std::make_unique<UploadArena>(
+		m_Device,
+		UPLOAD_ARENA_SIZE,
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+}
+
+FrameContext::~FrameContext()
+{
+	m_UploadArena.reset();
+	for (auto& threadPool : m_ThreadPools) {
+		vkDestroyCommandPool(m_Device.device(), threadPool.pool, nullptr);
+	}
+	for (VkDescriptorPool pool : m_DescriptorPools) {
+		vkDestroyDescriptorPool(m_Device.device(), pool, nullptr);
+	}
+	vkDestroySemaphore(m_Device.device(), m_RenderFinishedSemaphore, nullptr);
+	vkDestroySemaphore(m_Device.device(), m_ImageAvailableSemaphore, nullptr);
+	vkDestroyCommandPool(m_Device.device(), m_CommandPool, nullptr);
+}
+
+void FrameContext::waitAndReset()
+{
+	{
+		PROFILE_SCOPE("Wait For Frame Timeline");
+		m_Device.waitForTimeline(QueueType::Graphics, m_SubmittedValue);
+	}
+
+	// Resetting the whole pool is cheaper than resetting its command buffers one by one
+	vkResetCommandPool(m_Device.device(), m_CommandPool, 0);
+	for (auto& threadPool : m_ThreadPools) {
+		vkResetCommandPool(m_Device.device(), threadPool.pool, 0);
+		threadPool.used = 0;
+	}
+	for (VkDescriptorPool pool : m_DescriptorPools) {
+		vkResetDescriptorPool(m_Device.device(), pool, 0);
+	}
+	m_CurrentDescriptorPool = 0;
+	m_UploadArena->reset();
+}
+
+VkDescriptorSet FrameContext::allocateDescriptorSet(VkDescriptorSetLayout layout)
+{
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+
+	VkDescriptorSet descriptorSet;
+	while (true) {
+		allocInfo.descriptorPool = m_DescriptorPools[m_CurrentDescriptorPool];
+		const VkResult result = vkAllocateDescriptorSets(m_Device.device(), &allocInfo, &descriptorSet);
+		if (result == VK_SUCCESS) {
+			return descriptorSet;
+		}
+		if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+			throw std::runtime_error("failed to allocate descriptor sets!");
+		}
+
+		// Kept after the reset, so a scene only grows the pools once
+		if (++m_CurrentDescriptorPool == m_DescriptorPools.size()) {
+			m_DescriptorPools.push_back(m_CreateDescriptorPool());
+		}
+	}
+}
+
+void FrameContext::reserveRecordingThreads(uint32_t threadCount)
+{
+	while (m_ThreadPools.size() < threadCount) {
+		ThreadCommandPool threadPool{};
+		m_CreateCommandPool(threadPool.pool);
+		m_ThreadPools.push_back(std::move(threadPool));
+	}
+}
+
+void FrameContext::setRenderPassInheritance(VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent)
+{
+	m_InheritedRenderPass = renderPass;
+	m_InheritedFramebuffer = framebuffer;
+	m_InheritedExtent = extent;
+}
+
+VkCommandBuffer FrameContext::beginSecondaryCommandBuffer(uint32_t threadIndex)
+{
+	assert(threadIndex < m_ThreadPools.size() && "Recording thread has no command pool, call reserveRecordingThreads first");
+	assert(m_InheritedRenderPass != VK_NULL_HANDLE && "Secondary command buffers need the render pass to have begun");
+
+	ThreadCommandPool& threadPool = m_ThreadPools[threadIndex];
+	// Buffers are kept across frames, resetting the pool only rewinds them
+	if (threadPool.used == threadPool.buffers.size()) {
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandPool = threadPool.pool;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		if (vkAllocateCommandBuffers(m_Device.device(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate secondary command buffer!");
+		}
+		threadPool.buffers.push_back(commandBuffer);
+	}
+	VkCommandBuffer commandBuffer = threadPool.buffers[threadPool.used++];
+
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = m_InheritedRenderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = m_InheritedFramebuffer;
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to begin recording secondary command buffer!");
+	}
+
+	// Dynamic state is not inherited from the primary buffer
+	VkViewport viewport{};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = static_cast<float>(m_InheritedExtent.width);
+	viewport.height = static_cast<float>(m_InheritedExtent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	VkRect2D scissor{ {0, 0}, m_InheritedExtent };
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	return commandBuffer;
+}
+
+void FrameContext::m_CreateCommandPool(VkCommandPool& pool)
+{
+	QueueFamilyIndices queueFamilyIndices = m_Device.findPhysicalQueueFamilies();
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	if (vkCreateCommandPool(m_Device.device(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create command pool!");
+	}
+}
+
+void FrameContext::m_CreateCommandBuffer()
+{
+	m_CreateCommandPool(m_CommandPool);
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = m_CommandPool;
+	allocInfo.commandBufferCount = 1;
+
+	if (vkAllocateCommandBuffers(m_Device.device(), &allocInfo, &m_CommandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate command buffers!");
+	}
+}
+
+void FrameContext::m_CreateSyncObjects()
+{
+	// Binary, acquire and present cannot use timeline semaphores
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	if (vkCreateSemaphore(m_Device.device(), &semaphoreInfo, nullptr, &m_ImageAvailableSemaphore) != VK_SUCCESS ||
+		vkCreateSemaphore(m_Device.device(), &semaphoreInfo, nullptr, &m_RenderFinishedSemaphore) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create synchronization objects for a frame!");
+	}
+}
+
+VkDescriptorPool FrameContext::m_CreateDescriptorPool()
+{
+	std::array<VkDescriptorPoolSize, 3> poolSizes{};
+	poolSizes[0] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, DESCRIPTOR_POOL_SETS };
+	poolSizes[1] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, DESCRIPTOR_POOL_SETS * 8 };	// ClusterRenderSystem binds 8 per Model
+	poolSizes[2] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, DESCRIPTOR_POOL_SETS };
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = DESCRIPTOR_POOL_SETS;
+
+	VkDescriptorPool pool;
+	if (vkCreateDescriptorPool(m_Device.device(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create descriptor pool!");
+	}
+	return pool;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Device.h"
+#include "UploadArena.h"
+
+#include <memory>
+#include <vector>
+
+// Everything one frame in flight needs to record and submit its work. Renderer owns one per frame in
+// flight, independent of the SwapChain, so none of it is rebuilt when the swapchain is recreated.
+class FrameContext
+{
+public:
+	static constexpr uint32_t MIN_FRAMES_IN_FLIGHT = 1;
+	static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+	static constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+	static constexpr VkDeviceSize UPLOAD_ARENA_SIZE = 1024 * 1024;
+	static constexpr uint32_t DESCRIPTOR_POOL_SETS = 64;
+
+	FrameContext(Device& device);
+	~FrameContext();
+
+	// Not copyable or movable
+	FrameContext(const FrameContext&) = delete;
+	FrameContext& operator=(const FrameContext&) = delete;
+
+	// Waits for this frame's previous submission, then recycles its command pool, arena and descriptors
+	void waitAndReset();
+
+	VkCommandBuffer commandBuffer() { return m_CommandBuffer; }
+	// Graphics timeline value this frame's last submission signals, 0 before the first
+	uint64_t submittedValue() const { return m_SubmittedValue; }
+	void setSubmittedValue(uint64_t value) { m_SubmittedValue = value; }
+	VkSemaphore imageAvailableSemaphore() { return m_ImageAvailableSemaphore; }
+	VkSemaphore renderFinishedSemaphore() { return m_RenderFinishedSemaphore; }
+	UploadArena& uploadArena() { return *m_UploadArena; }
+	// Sets are only valid until the frame is reset. Another pool is added whenever the current ones run out
+	VkDescriptorSet allocateDescriptorSet(VkDescriptorSetLayout layout);
+
+	// Creates one secondary command pool per recording thread, call from the main thread only
+	void reserveRecordingThreads(uint32_t threadCount);
+	uint32_t recordingThreadCount() const { return static_cast<uint32_t>(m_ThreadPools.size()); }
+	// The render pass and framebuffer secondary buffers continue, set when the frame's render pass begins
+	void setRenderPassInheritance(VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent);
+	// Begins a secondary buffer from threadIndex's pool with viewport and scissor already set.
+	// Safe to call concurrently as long as each thread uses its own index.
+	VkCommandBuffer beginSecondaryCommandBuffer(uint32_t threadIndex);
+
+private:
+	// Command pools are externally synchronised, so every recording thread gets its own
+	struct ThreadCommandPool {
+		VkCommandPool pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> buffers;
+		uint32_t used = 0;
+	};
+
+	Device& m_Device;
+	VkCommandPool m_CommandPool;
+	VkCommandBuffer m_CommandBuffer;
+	uint64_t m_SubmittedValue{ 0 };
+	VkSemaphore m_ImageAvailableSemaphore;
+	VkSemaphore m_RenderFinishedSemaphore;
+	std::vector<VkDescriptorPool> m_DescriptorPools;
+	size_t m_CurrentDescriptorPool{ 0 };
+	std::unique_ptr<UploadArena> m_UploadArena;
+	std::vector<ThreadCommandPool> m_ThreadPools;
+	VkRenderPass m_InheritedRenderPass{ VK_NULL_HANDLE };
+	VkFramebuffer m_InheritedFramebuffer{ VK_NULL_HANDLE };
+	VkExtent2D m_InheritedExtent{};
+
+	void m_CreateCommandPool(VkCommandPool& pool);
+	void m_CreateCommandBuffer();
+	void m_CreateSyncObjects();
+	VkDescriptorPool m_CreateDescriptorPool();
+};
+
+// What a render system needs to record into the current frame
+struct FrameInfo {
+	int frameIndex;
+	VkCommandBuffer commandBuffer;
+	FrameContext& context;
+	VkExtent2D extent;				// Of the render target, for choosing LODs by projected size
+};
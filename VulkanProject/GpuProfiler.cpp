@@ -0,0 +1,179 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+GpuProfiler::GpuProfiler(Device& device, uint32_t framesInFlight)
+	: m_Device(device)
+{
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(m_Device.physicalDevice(), &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(m_Device.physicalDevice(), &familyCount, families.data());
+	const uint32_t validBits = families[m_Device.findPhysicalQueueFamilies().graphicsFamily].timestampValidBits;
+
+	// Without timestamps on graphics and compute queues every call becomes a no-op
+	m_Supported = m_Device.properties.limits.timestampComputeAndGraphics && validBits > 0;
+	if (!m_Supported) {
+		std::cout << "GPU timestamps are not supported, GPU profiling is disabled" << std::endl;
+		return;
+	}
+
+	m_TimestampPeriod = m_Device.properties.limits.timestampPeriod;
+	m_TimestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+
+	m_Frames.resize(framesInFlight);
+	for (auto& frame : m_Frames) {
+		VkQueryPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		poolInfo.queryCount = MAX_SCOPES_PER_FRAME * 2;
+
+		if (vkCreateQueryPool(m_Device.device(), &poolInfo, nullptr, &frame.queryPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create timestamp query pool!");
+		}
+		frame.scopes.reserve(MAX_SCOPES_PER_FRAME);
+	}
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	for (auto& frame : m_Frames) {
+		vkDestroyQueryPool(m_Device.device(), frame.queryPool, nullptr);
+	}
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, int frameIndex)
+{
+	if (!m_Supported) {
+		return;
+	}
+
+	m_CurrentFrame = frameIndex;
+	Frame& frame = m_Frames[frameIndex];
+	m_CollectResults(frame);
+
+	frame.scopes.clear();
+	frame.queryCount = 0;
+	vkCmdResetQueryPool(commandBuffer, frame.queryPool, 0, MAX_SCOPES_PER_FRAME * 2);
+}
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char* name)
+{
+	if (!m_Supported || m_CurrentFrame < 0) {
+		return UINT32_MAX;
+	}
+
+	Frame& frame = m_Frames[m_CurrentFrame];
+	if (frame.scopes.size() >= MAX_SCOPES_PER_FRAME) {
+		return UINT32_MAX;
+	}
+
+	ScopeQuery scope{ name, frame.queryCount++, UINT32_MAX };
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, scope.beginQuery);
+	frame.scopes.push_back(scope);
+	return static_cast<uint32_t>(frame.scopes.size() - 1);
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t scopeIndex)
+{
+	if (scopeIndex == UINT32_MAX) {
+		return;
+	}
+
+	Frame& frame = m_Frames[m_CurrentFrame];
+	ScopeQuery& scope = frame.scopes[scopeIndex];
+	scope.endQuery = frame.queryCount++;
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.queryPool, scope.endQuery);
+}
+
+void GpuProfiler::m_CollectResults(Frame& frame)
+{
+	if (frame.queryCount == 0) {
+		return;
+	}
+
+	// The frame has already been waited on, so the results should be ready without blocking
+	std::vector<uint64_t> timestamps(frame.queryCount);
+	VkResult result = vkGetQueryPoolResults(
+		m_Device.device(),
+		frame.queryPool,
+		0,
+		frame.queryCount,
+		timestamps.size() * sizeof(uint64_t),
+		timestamps.data(),
+		sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS) {
+		return;
+	}
+
+	for (const auto& scope : frame.scopes) {
+		if (scope.endQuery == UINT32_MAX) {
+			continue;
+		}
+		const uint64_t ticks = (timestamps[scope.endQuery] - timestamps[scope.beginQuery]) & m_TimestampMask;
+		const float milliseconds = static_cast<float>(ticks) * m_TimestampPeriod / 1000000.0f;
+
+		ScopeHistory& history = m_FindHistory(scope.name);
+		if (history.samples.size() < HISTORY_SIZE) {
+			history.samples.push_back(milliseconds);
+		}
+		else {
+			history.samples[history.next] = milliseconds;
+		}
+		history.next = (history.next + 1) % HISTORY_SIZE;
+	}
+}
+
+GpuProfiler::ScopeHistory& GpuProfiler::m_FindHistory(const char* name)
+{
+	for (auto& history : m_History) {
+		if (history.name == name || std::strcmp(history.name, name) == 0) {
+			return history;
+		}
+	}
+	m_History.push_back({ name, {}, 0 });
+	m_History.back().samples.reserve(HISTORY_SIZE);
+	return m_History.back();
+}
+
+std::vector<GpuProfiler::ScopeStats> GpuProfiler::getStats() const
+{
+	std::vector<ScopeStats> stats;
+	for (const auto& history : m_History) {
+		if (history.samples.empty()) {
+			continue;
+		}
+
+		ScopeStats scopeStats{ history.name, history.samples[0], 0.0f, history.samples[0], 0 };
+		for (float sample : history.samples) {
+			scopeStats.minMs = std::min(scopeStats.minMs, sample);
+			scopeStats.maxMs = std::max(scopeStats.maxMs, sample);
+			scopeStats.avgMs += sample;
+		}
+		scopeStats.sampleCount = static_cast<uint32_t>(history.samples.size());
+		scopeStats.avgMs /= static_cast<float>(scopeStats.sampleCount);
+		stats.push_back(scopeStats);
+	}
+	return stats;
+}
+
+void GpuProfiler::printStats() const
+{
+	if (!m_Supported) {
+		return;
+	}
+
+	std::cout << "GPU timings over the last " << HISTORY_SIZE << " frames (ms, min / avg / max):" << std::endl;
+	std::cout << std::fixed << std::setprecision(3);
+	for (const auto& scope : getStats()) {
+		std::cout << "\t" << std::left << std::setw(24) << scope.name << std::right
+			<< scope.minMs << " / " << scope.avgMs << " / " << scope.maxMs << std::endl;
+	}
+	std::cout << std::defaultfloat;
+}
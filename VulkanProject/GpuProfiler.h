@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Device.h"
+
+#include <cstdint>
+#include <vector>
+
+// Measures GPU time between pairs of timestamps written into the frame's command buffer.
+// Each frame in flight has its own query pool, read back once that frame's timeline value has been
+// waited on, so reading results never stalls the GPU.
+class GpuProfiler
+{
+public:
+	static constexpr uint32_t MAX_SCOPES_PER_FRAME = 32;
+	static constexpr uint32_t HISTORY_SIZE = 240;		// Frames kept for the rolling statistics
+
+	struct ScopeStats {
+		const char* name;
+		float minMs;
+		float avgMs;
+		float maxMs;
+		uint32_t sampleCount;
+	};
+
+	// Opens a scope on construction and closes it when it goes out of scope
+	class Scope {
+	public:
+		Scope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name)
+			: m_Profiler(profiler), m_CommandBuffer(commandBuffer), m_Index(profiler.beginScope(commandBuffer, name)) {}
+		~Scope() { m_Profiler.endScope(m_CommandBuffer, m_Index); }
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		GpuProfiler& m_Profiler;
+		VkCommandBuffer m_CommandBuffer;
+		uint32_t m_Index;
+	};
+
+	GpuProfiler(Device& device, uint32_t framesInFlight);
+	~GpuProfiler();
+
+	// Not copyable or movable
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	bool isSupported() const { return m_Supported; }
+
+	// Collects the previous results for this frame index and resets its queries, call outside a render pass
+	void beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+	// Scope names must outlive the profiler, string literals are expected
+	uint32_t beginScope(VkCommandBuffer commandBuffer, const char* name);
+	void endScope(VkCommandBuffer commandBuffer, uint32_t scopeIndex);
+
+	std::vector<ScopeStats> getStats() const;
+	void printStats() const;
+
+private:
+	struct ScopeQuery {
+		const char* name;
+		uint32_t beginQuery;
+		uint32_t endQuery;
+	};
+
+	struct Frame {
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		std::vector<ScopeQuery> scopes;
+		uint32_t queryCount = 0;
+	};
+
+	struct ScopeHistory {
+		const char* name;
+		std::vector<float> samples;		// Ring buffer of the last HISTORY_SIZE timings in ms
+		uint32_t next = 0;
+	};
+
+	Device& m_Device;
+	bool m_Supported = false;
+	float m_TimestampPeriod = 1.0f;		// Nanoseconds per timestamp tick
+	uint64_t m_TimestampMask = ~0ull;
+	std::vector<Frame> m_Frames;
+	std::vector<ScopeHistory> m_History;
+	int m_CurrentFrame = -1;
+
+	void m_CollectResults(Frame& frame);
+	ScopeHistory& m_FindHistory(const char* name);
+};
@@ -0,0 +1,428 @@
+#include "IndirectRenderSystem.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <array>
+#include <cassert>
+
+static constexpr const char* VERTEX_SHADER = "indirect_shader.vert.spv";
+static constexpr const char* FRAGMENT_SHADER = "instanced_shader.frag.spv";
+static constexpr const char* CULL_SHADER = "cull.comp.spv";
+
+struct CullPushConstantData {
+	uint32_t objectCount;
+};
+
+struct DrawPushConstantData {
+	uint32_t visibleBase;
+};
+
+IndirectRenderSystem::IndirectRenderSystem(Device& device, VkRenderPass renderPass, uint32_t framesInFlight)
+	: m_Device(device)
+{
+	m_Frames.resize(framesInFlight);
+	m_CreateDescriptorSets();
+	m_CreatePipelineLayouts();
+	m_CreatePipelines(renderPass);
+}
+
+IndirectRenderSystem::~IndirectRenderSystem()
+{
+	if (m_ShaderReloader) {
+		m_ShaderReloader->unwatch(this);
+	}
+	for (auto& frame : m_Frames) {
+		m_DestroyFrameBuffers(frame);
+	}
+	vkDestroyPipelineLayout(m_Device.device(), m_CullPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(m_Device.device(), m_PipelineLayout, nullptr);
+	vkDestroyDescriptorPool(m_Device.device(), m_DescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(m_Device.device(), m_DescriptorSetLayout, nullptr);
+}
+
+void IndirectRenderSystem::m_CreateDescriptorSets()
+{
+	// 0: object data, 1: draw commands, 2: visible object indices
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+	}
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(m_Device.device(), &layoutInfo, nullptr, &m_DescriptorSetLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create descriptor set layout!");
+	}
+
+	const uint32_t setCount = static_cast<uint32_t>(m_Frames.size());
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = static_cast<uint32_t>(bindings.size()) * setCount;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = setCount;
+
+	if (vkCreateDescriptorPool(m_Device.device(), &poolInfo, nullptr, &m_DescriptorPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create descriptor pool!");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(setCount, m_DescriptorSetLayout);
+	std::vector<VkDescriptorSet> sets(setCount);
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = m_DescriptorPool;
+	allocInfo.descriptorSetCount = setCount;
+	allocInfo.pSetLayouts = layouts.data();
+
+	if (vkAllocateDescriptorSets(m_Device.device(), &allocInfo, sets.data()) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate descriptor sets!");
+	}
+	for (uint32_t i = 0; i < setCount; i++) {
+		m_Frames[i].descriptorSet = sets[i];
+	}
+}
+
+void IndirectRenderSystem::m_CreatePipelineLayouts()
+{
+	VkPushConstantRange cullPushRange{};
+	cullPushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	cullPushRange.offset = 0;
+	cullPushRange.size = sizeof(CullPushConstantData);
+
+	VkPipelineLayoutCreateInfo cullLayoutInfo{};
+	cullLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	cullLayoutInfo.setLayoutCount = 1;
+	cullLayoutInfo.pSetLayouts = &m_DescriptorSetLayout;
+	cullLayoutInfo.pushConstantRangeCount = 1;
+	cullLayoutInfo.pPushConstantRanges = &cullPushRange;
+
+	if (vkCreatePipelineLayout(m_Device.device(), &cullLayoutInfo, nullptr, &m_CullPipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+
+	VkPushConstantRange drawPushRange{};
+	drawPushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	drawPushRange.offset = 0;
+	drawPushRange.size = sizeof(DrawPushConstantData);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &m_DescriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &drawPushRange;
+
+	if (vkCreatePipelineLayout(m_Device.device(), &pipelineLayoutInfo, nullptr, &m_PipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+}
+
+void IndirectRenderSystem::m_CreatePipelines(VkRenderPass renderPass)
+{
+	assert(m_PipelineLayout != nullptr);
+	m_RenderPass = renderPass;
+	m_Pipeline = m_CreateDrawPipeline();
+	m_CullPipeline = m_CreateCullPipeline();
+}
+
+void IndirectRenderSystem::enableHotReload(ShaderReloader& shaderReloader)
+{
+	m_ShaderReloader = &shaderReloader;
+	shaderReloader.watch<Pipeline>(this, m_Pipeline, { VERTEX_SHADER, FRAGMENT_SHADER },
+		[this] { return m_CreateDrawPipeline(); });
+	shaderReloader.watch<ComputePipeline>(this, m_CullPipeline, { CULL_SHADER },
+		[this] { return m_CreateCullPipeline(); });
+}
+
+std::unique_ptr<Pipeline> IndirectRenderSystem::m_CreateDrawPipeline() const
+{
+	PipelineConfigInfo pipelineConfig{};
+	Pipeline::defaultPipelineConfigInfo(pipelineConfig);
+	pipelineConfig.renderPass = m_RenderPass;
+	pipelineConfig.pipelineLayout = m_PipelineLayout;
+	return std::make_unique<Pipeline>(
+		m_Device,
+		pipelineConfig,
+		Pipeline::shaderPath(VERTEX_SHADER),
+		Pipeline::shaderPath(FRAGMENT_SHADER)
+	);
+}
+
+std::unique_ptr<ComputePipeline> IndirectRenderSystem::m_CreateCullPipeline() const
+{
+	return std::make_unique<ComputePipeline>(
+		m_Device,
+		m_CullPipelineLayout,
+		Pipeline::shaderPath(CULL_SHADER)
+	);
+}
+
+void IndirectRenderSystem::m_DestroyFrameBuffers(FrameResources& frame)
+{
+	if (frame.objectBuffer != VK_NULL_HANDLE) {
+		m_Device.destroyBuffer(frame.objectBuffer, frame.objectAllocation);
+		m_Device.destroyBuffer(frame.visibleBuffer, frame.visibleAllocation);
+		frame.objectBuffer = VK_NULL_HANDLE;
+		frame.visibleBuffer = VK_NULL_HANDLE;
+		frame.objectCapacity = 0;
+	}
+	if (frame.drawBuffer != VK_NULL_HANDLE) {
+		m_Device.destroyBuffer(frame.drawBuffer, frame.drawAllocation);
+		frame.drawBuffer = VK_NULL_HANDLE;
+		frame.drawCapacity = 0;
+	}
+}
+
+void IndirectRenderSystem::m_ReserveFrame(int frameIndex, uint32_t objectCount, uint32_t drawCount)
+{
+	FrameResources& frame = m_Frames[frameIndex];
+	bool rebind = false;
+
+	// This frame index has been waited on, so its old buffers are no longer in use
+	if (objectCount > frame.objectCapacity) {
+		if (frame.objectBuffer != VK_NULL_HANDLE) {
+			m_Device.destroyBuffer(frame.objectBuffer, frame.objectAllocation);
+			m_Device.destroyBuffer(frame.visibleBuffer, frame.visibleAllocation);
+		}
+
+		uint32_t capacity = std::max<uint32_t>(1024, frame.objectCapacity);
+		while (capacity < objectCount) {
+			capacity *= 2;
+		}
+
+		// Written by the CPU every frame, read once by the cull pass and once per visible vertex
+		m_Device.createBuffer(
+			sizeof(ObjectData) * capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			frame.objectBuffer,
+			frame.objectAllocation);
+		m_Device.createBuffer(
+			sizeof(uint32_t) * capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			frame.visibleBuffer,
+			frame.visibleAllocation);
+		frame.objectCapacity = capacity;
+		rebind = true;
+	}
+
+	if (drawCount > frame.drawCapacity) {
+		if (frame.drawBuffer != VK_NULL_HANDLE) {
+			m_Device.destroyBuffer(frame.drawBuffer, frame.drawAllocation);
+		}
+
+		uint32_t capacity = std::max<uint32_t>(16, frame.drawCapacity);
+		while (capacity < drawCount) {
+			capacity *= 2;
+		}
+
+		m_Device.createBuffer(
+			sizeof(VkDrawIndexedIndirectCommand) * capacity,
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			frame.drawBuffer,
+			frame.drawAllocation);
+		frame.drawCapacity = capacity;
+		rebind = true;
+	}
+
+	if (!rebind) {
+		return;
+	}
+
+	std::array<VkDescriptorBufferInfo, 3> bufferInfos{};
+	bufferInfos[0] = { frame.objectBuffer, 0, VK_WHOLE_SIZE };
+	bufferInfos[1] = { frame.drawBuffer, 0, VK_WHOLE_SIZE };
+	bufferInfos[2] = { frame.visibleBuffer, 0, VK_WHOLE_SIZE };
+
+	std::array<VkWriteDescriptorSet, 3> writes{};
+	for (uint32_t i = 0; i < writes.size(); i++) {
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = frame.descriptorSet;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &bufferInfos[i];
+	}
+	vkUpdateDescriptorSets(m_Device.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void IndirectRenderSystem::cullObjects(FrameInfo& frameInfo, const std::vector<RenderableComponent>& objects, const TransformStore& transforms)
+{
+	PROFILE_FUNCTION();
+	VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+	const int frameIndex = frameInfo.frameIndex;
+	assert(transforms.size() == objects.size() && "Every object needs a transform");
+	// One draw per LOD of each distinct Model, each owning a contiguous range of the visible index list
+	m_DrawIndices.clear();
+	m_DrawModels.clear();
+	m_DrawLods.clear();
+	m_DrawBases.clear();
+	m_ObjectDraws.resize(objects.size());
+	std::vector<uint32_t> drawSizes;
+	for (size_t i = 0; i < objects.size(); i++) {
+		Model* model = objects[i].model.get();
+		if (m_SkipMeshletModels && model->hasMeshlets()) {
+			m_ObjectDraws[i] = NO_DRAW;
+			continue;
+		}
+		assert(model->hasIndexBuffer() && "IndirectRenderSystem only draws indexed models");
+		auto result = m_DrawIndices.emplace(model, static_cast<uint32_t>(m_DrawModels.size()));
+		if (result.second) {
+			for (uint32_t lod = 0; lod < model->getLodCount(); lod++) {
+				m_DrawModels.push_back(model);
+				m_DrawLods.push_back(lod);
+				drawSizes.push_back(0);
+			}
+		}
+
+		// Picked on the CPU, the cull shader only tests visibility
+		uint32_t lod = 0;
+		if (model->getLodCount() > 1) {
+			lod = model->selectLod(Model::pixelsPerUnit(frameInfo.extent, transforms.scaleX()[i], transforms.scaleY()[i]), m_LodErrorPixels);
+		}
+		m_ObjectDraws[i] = result.first->second + lod;
+		drawSizes[m_ObjectDraws[i]]++;
+	}
+
+	uint32_t base = 0;
+	for (uint32_t size : drawSizes) {
+		m_DrawBases.push_back(base);
+		base += size;
+	}
+
+	// Also covers a scene left entirely to ClusterRenderSystem
+	if (m_DrawModels.empty()) {
+		return;
+	}
+
+	const uint32_t objectCount = static_cast<uint32_t>(objects.size());
+	const uint32_t drawCount = static_cast<uint32_t>(m_DrawModels.size());
+	m_ReserveFrame(frameIndex, objectCount, drawCount);
+	FrameResources& frame = m_Frames[frameIndex];
+
+	auto* objectData = static_cast<ObjectData*>(frame.objectAllocation.mappedData);
+	transforms.buildMatrices(0, objectCount, objectData, sizeof(ObjectData));
+	const float* scaleX = transforms.scaleX();
+	const float* scaleY = transforms.scaleY();
+	for (uint32_t i = 0; i < objectCount; i++) {
+		auto& object = objects[i];
+		const glm::vec2 scale = glm::abs(glm::vec2(scaleX[i], scaleY[i]));
+		const uint32_t drawIndex = m_ObjectDraws[i];
+
+		ObjectData& data = objectData[i];
+		if (drawIndex == NO_DRAW) {
+			data.drawIndex = NO_DRAW;
+			continue;
+		}
+		// Normalized positions need their scale in the matrix, rebuilt rather than read back from mapped memory
+		if (object.model->getPositionScale() != 1.0f) {
+			transforms.buildMatricesIndexed(&i, 1, &data, sizeof(ObjectData), object.model->getPositionScale());
+		}
+		data.radius = object.model->getBoundingRadius() * std::max(scale.x, scale.y);
+		data.drawIndex = drawIndex;
+		data.colour = object.colour;
+		data.visibleBase = m_DrawBases[drawIndex];
+	}
+
+	// Reset every draw to zero instances, the cull pass counts them back up
+	m_DrawCommands.resize(drawCount);
+	for (uint32_t i = 0; i < drawCount; i++) {
+		const Model::Lod& lod = m_DrawModels[i]->getLod(m_DrawLods[i]);
+		m_DrawCommands[i].indexCount = lod.indexCount;
+		m_DrawCommands[i].instanceCount = 0;
+		m_DrawCommands[i].firstIndex = lod.firstIndex;
+		m_DrawCommands[i].vertexOffset = 0;
+		m_DrawCommands[i].firstInstance = 0;
+	}
+
+	// vkCmdUpdateBuffer is limited to 64KiB per call
+	const VkDeviceSize drawBytes = sizeof(VkDrawIndexedIndirectCommand) * drawCount;
+	const auto* drawData = reinterpret_cast<const char*>(m_DrawCommands.data());
+	for (VkDeviceSize offset = 0; offset < drawBytes; offset += 65536) {
+		const VkDeviceSize chunk = std::min<VkDeviceSize>(65536, drawBytes - offset);
+		vkCmdUpdateBuffer(commandBuffer, frame.drawBuffer, offset, chunk, drawData + offset);
+	}
+
+	VkBufferMemoryBarrier resetBarrier{};
+	resetBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	resetBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	resetBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	resetBarrier.buffer = frame.drawBuffer;
+	resetBarrier.offset = 0;
+	resetBarrier.size = drawBytes;
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 0, nullptr, 1, &resetBarrier, 0, nullptr);
+
+	m_CullPipeline->bind(commandBuffer);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullPipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+	CullPushConstantData push{ objectCount };
+	vkCmdPushConstants(commandBuffer, m_CullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstantData), &push);
+	vkCmdDispatch(commandBuffer, (objectCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+	// Draw commands are read as indirect arguments, visible indices by the vertex shader
+	std::array<VkBufferMemoryBarrier, 2> cullBarriers{};
+	for (auto& barrier : cullBarriers) {
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.offset = 0;
+	}
+	cullBarriers[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	cullBarriers[0].buffer = frame.drawBuffer;
+	cullBarriers[0].size = drawBytes;
+	cullBarriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	cullBarriers[1].buffer = frame.visibleBuffer;
+	cullBarriers[1].size = sizeof(uint32_t) * objectCount;
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+		0, 0, nullptr, static_cast<uint32_t>(cullBarriers.size()), cullBarriers.data(), 0, nullptr);
+}
+
+void IndirectRenderSystem::renderObjects(FrameInfo& frameInfo)
+{
+	PROFILE_FUNCTION();
+	if (m_DrawModels.empty()) {
+		return;
+	}
+	VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+	FrameResources& frame = m_Frames[frameInfo.frameIndex];
+
+	m_Pipeline->bind(commandBuffer);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+
+	// Culled models and unused LODs still issue their draw, the GPU skips it since instanceCount is zero
+	Model* boundModel = nullptr;
+	for (uint32_t i = 0; i < m_DrawModels.size(); i++) {
+		DrawPushConstantData push{ m_DrawBases[i] };
+		vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawPushConstantData), &push);
+		// A Model's LODs share its buffers and sit next to each other in the draw list
+		if (m_DrawModels[i] != boundModel) {
+			m_DrawModels[i]->bind(commandBuffer);
+			boundModel = m_DrawModels[i];
+		}
+		vkCmdDrawIndexedIndirect(commandBuffer, frame.drawBuffer, sizeof(VkDrawIndexedIndirectCommand) * i, 1, sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
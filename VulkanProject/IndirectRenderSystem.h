@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Pipeline.h"
+#include "ComputePipeline.h"
+#include "Device.h"
+#include "FrameContext.h"
+#include "Model.h"
+#include "Components.h"
+#include "TransformStore.h"
+#include "ShaderReloader.h"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Draws large scenes without a per-object CPU loop in the command buffer. Object data lives in a
+// storage buffer, a compute pass culls it and fills one VkDrawIndexedIndirectCommand per Model LOD,
+// and the render pass issues one indirect draw per Model LOD.
+class IndirectRenderSystem
+{
+public:
+	// Matches ObjectData in cull.comp and indirect_shader.vert (std430), starts with a PackedTransform2D
+	struct ObjectData {
+		glm::vec4 transform;		// mat2 columns packed as (c0.x, c0.y, c1.x, c1.y)
+		glm::vec2 offset;
+		float radius;				// Bounding radius in NDC after scale
+		uint32_t drawIndex;
+		glm::vec3 colour;
+		uint32_t visibleBase;		// First slot of this object's draw in the visible index list
+	};
+
+	static constexpr uint32_t CULL_WORKGROUP_SIZE = 64;
+	// drawIndex of objects the cull pass skips
+	static constexpr uint32_t NO_DRAW = 0xFFFFFFFF;
+
+	IndirectRenderSystem(Device& device, VkRenderPass renderPass, uint32_t framesInFlight);
+	~IndirectRenderSystem();
+
+	// Not copyable or movable
+	IndirectRenderSystem(const IndirectRenderSystem&) = delete;
+	IndirectRenderSystem& operator=(const IndirectRenderSystem&) = delete;
+
+	// Rebuilds the pipelines when their shaders change, until this system is destroyed
+	void enableHotReload(ShaderReloader& shaderReloader);
+
+	// Records the culling dispatch, must be called outside the render pass
+	void cullObjects(FrameInfo& frameInfo, const std::vector<RenderableComponent>& objects, const TransformStore& transforms);
+	// Records the indirect draws produced by the last cullObjects call
+	void renderObjects(FrameInfo& frameInfo);
+
+	// Screen space error allowed when picking each object's LOD
+	void setLodErrorPixels(float lodErrorPixels) { m_LodErrorPixels = lodErrorPixels; }
+	// Leaves models with meshlets to ClusterRenderSystem
+	void setSkipMeshletModels(bool skip) { m_SkipMeshletModels = skip; }
+
+private:
+	// Scene buffers are kept per frame in flight and only reallocated when the scene outgrows them
+	struct FrameResources {
+		VkBuffer objectBuffer = VK_NULL_HANDLE;
+		Allocation objectAllocation;
+		VkBuffer drawBuffer = VK_NULL_HANDLE;
+		Allocation drawAllocation;
+		VkBuffer visibleBuffer = VK_NULL_HANDLE;
+		Allocation visibleAllocation;
+		uint32_t objectCapacity = 0;
+		uint32_t drawCapacity = 0;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	};
+
+	Device& m_Device;
+	std::unique_ptr<Pipeline> m_Pipeline;
+	std::unique_ptr<ComputePipeline> m_CullPipeline;
+	VkDescriptorSetLayout m_DescriptorSetLayout;
+	VkDescriptorPool m_DescriptorPool;
+	VkPipelineLayout m_PipelineLayout;
+	VkPipelineLayout m_CullPipelineLayout;
+	VkRenderPass m_RenderPass;
+	ShaderReloader* m_ShaderReloader = nullptr;
+	std::vector<FrameResources> m_Frames;
+
+	// Draw list built by cullObjects, one entry per LOD of each distinct Model. m_DrawIndices holds the first one
+	std::unordered_map<Model*, uint32_t> m_DrawIndices;
+	std::vector<Model*> m_DrawModels;
+	std::vector<uint32_t> m_DrawLods;
+	std::vector<uint32_t> m_DrawBases;
+	std::vector<VkDrawIndexedIndirectCommand> m_DrawCommands;
+	std::vector<uint32_t> m_ObjectDraws;
+	float m_LodErrorPixels{ Model::DEFAULT_LOD_ERROR_PIXELS };
+	bool m_SkipMeshletModels = false;
+
+	void m_CreateDescriptorSets();
+	void m_CreatePipelineLayouts();
+	void m_CreatePipelines(VkRenderPass renderPass);
+	std::unique_ptr<Pipeline> m_CreateDrawPipeline() const;
+	std::unique_ptr<ComputePipeline> m_CreateCullPipeline() const;
+	void m_ReserveFrame(int frameIndex, uint32_t objectCount, uint32_t drawCount);
+	void m_DestroyFrameBuffers(FrameResources& frame);
+};
@@ -0,0 +1,273 @@
+#include "JobSystem.h"
+
+#include "Profiler.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#endif
+
+#include <string>
+
+namespace
+{
+	// Set on every thread that runs jobs, so schedule knows which deque is its own
+	thread_local const JobSystem* t_JobSystem = nullptr;
+	thread_local uint32_t t_WorkerIndex = UINT32_MAX;
+
+	// Spins before sleeping so short gaps between batches do not pay for a wake-up
+	constexpr uint32_t IDLE_SPINS = 64;
+}
+
+JobSystem::JobSystem(uint32_t threadCount, bool pinThreads)
+{
+	if (threadCount == 0) {
+		const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	for (uint32_t i = 0; i < threadCount + 1; i++) {
+		m_Queues.push_back(std::make_unique<WorkerQueue>());
+	}
+
+	t_JobSystem = this;
+	t_WorkerIndex = 0;
+	if (pinThreads) {
+		m_PinCurrentThread(0);
+	}
+
+	m_Threads.reserve(threadCount);
+	for (uint32_t i = 1; i <= threadCount; i++) {
+		m_Threads.emplace_back(&JobSystem::m_WorkerLoop, this, i, pinThreads);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+		m_Stopping = true;
+	}
+	m_WakeCondition.notify_all();
+	for (auto& thread : m_Threads) {
+		thread.join();
+	}
+
+	if (t_JobSystem == this) {
+		t_JobSystem = nullptr;
+		t_WorkerIndex = UINT32_MAX;
+	}
+}
+
+uint32_t JobSystem::currentWorkerIndex() const
+{
+	return t_JobSystem == this ? t_WorkerIndex : UINT32_MAX;
+}
+
+void JobSystem::schedule(Job job, Counter* counter)
+{
+	if (counter) {
+		counter->m_Pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Threads outside the system spread their jobs round robin, workers keep them local
+	uint32_t queueIndex = currentWorkerIndex();
+	if (queueIndex == UINT32_MAX) {
+		queueIndex = m_NextExternalQueue.fetch_add(1, std::memory_order_relaxed) % workerCount();
+	}
+	m_Push(queueIndex, std::move(job), counter);
+}
+
+void JobSystem::scheduleAfter(Counter& dependency, Job job, Counter* counter)
+{
+	if (counter) {
+		counter->m_Pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	{
+		// m_Finish takes the continuations under the same lock after the count reaches zero,
+		// so a job added here either sees zero or is picked up by m_Finish
+		std::lock_guard<std::mutex> lock(dependency.m_Mutex);
+		if (!dependency.isDone()) {
+			dependency.m_Continuations.emplace_back(std::move(job), counter);
+			return;
+		}
+	}
+
+	uint32_t queueIndex = currentWorkerIndex();
+	if (queueIndex == UINT32_MAX) {
+		queueIndex = m_NextExternalQueue.fetch_add(1, std::memory_order_relaxed) % workerCount();
+	}
+	m_Push(queueIndex, std::move(job), counter);
+}
+
+void JobSystem::wait(Counter& counter)
+{
+	PROFILE_FUNCTION();
+	const uint32_t workerIndex = currentWorkerIndex();
+	while (!counter.isDone()) {
+		// Help out rather than block, a thread outside the system can only steal
+		if (!m_TryRunJob(workerIndex == UINT32_MAX ? 0 : workerIndex)) {
+			std::this_thread::yield();
+		}
+	}
+
+	// The finishing thread may still hold the counter's lock, the caller is free to destroy it after this
+	{
+		std::lock_guard<std::mutex> lock(counter.m_Mutex);
+	}
+
+	std::lock_guard<std::mutex> lock(m_ExceptionMutex);
+	if (m_Exception) {
+		std::exception_ptr exception = m_Exception;
+		m_Exception = nullptr;
+		std::rethrow_exception(exception);
+	}
+}
+
+void JobSystem::parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& func)
+{
+	if (count == 0) {
+		return;
+	}
+	grainSize = std::max<size_t>(grainSize, 1);
+
+	// A single chunk is not worth a round trip through the queues
+	if (count <= grainSize) {
+		func(0, count);
+		return;
+	}
+
+	Counter counter;
+	for (size_t begin = 0; begin < count; begin += grainSize) {
+		const size_t end = std::min(begin + grainSize, count);
+		schedule([&func, begin, end] { func(begin, end); }, &counter);
+	}
+	wait(counter);
+}
+
+void JobSystem::m_WorkerLoop(uint32_t workerIndex, bool pin)
+{
+	t_JobSystem = this;
+	t_WorkerIndex = workerIndex;
+	Profiler::setThreadName("Job Worker " + std::to_string(workerIndex));
+	if (pin) {
+		m_PinCurrentThread(workerIndex);
+	}
+
+	uint32_t idleSpins = 0;
+	while (!m_Stopping) {
+		if (m_TryRunJob(workerIndex)) {
+			idleSpins = 0;
+			continue;
+		}
+
+		if (++idleSpins < IDLE_SPINS) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_SleepMutex);
+		m_WakeCondition.wait(lock, [&] { return m_Stopping || m_QueuedJobs.load() > 0; });
+		idleSpins = 0;
+	}
+}
+
+void JobSystem::m_Push(uint32_t queueIndex, Job job, Counter* counter)
+{
+	WorkerQueue& queue = *m_Queues[queueIndex];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.emplace_back(std::move(job), counter);
+	}
+	m_QueuedJobs.fetch_add(1);
+
+	// Taking the sleep lock orders this against a worker that has just checked m_QueuedJobs
+	{
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+	}
+	m_WakeCondition.notify_one();
+}
+
+bool JobSystem::m_TryRunJob(uint32_t workerIndex)
+{
+	std::pair<Job, Counter*> job;
+	if (!m_PopOrSteal(workerIndex, job)) {
+		return false;
+	}
+	m_QueuedJobs.fetch_sub(1);
+
+	try {
+		job.first();
+	}
+	catch (...) {
+		std::lock_guard<std::mutex> lock(m_ExceptionMutex);
+		if (!m_Exception) {
+			m_Exception = std::current_exception();
+		}
+	}
+
+	if (job.second) {
+		m_Finish(job.second, workerIndex);
+	}
+	return true;
+}
+
+bool JobSystem::m_PopOrSteal(uint32_t workerIndex, std::pair<Job, Counter*>& out)
+{
+	{
+		WorkerQueue& own = *m_Queues[workerIndex];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.jobs.empty()) {
+			out = std::move(own.jobs.back());
+			own.jobs.pop_back();
+			return true;
+		}
+	}
+
+	// Steal the oldest job of another queue, starting next to our own so thieves spread out
+	const uint32_t queueCount = workerCount();
+	for (uint32_t i = 1; i < queueCount; i++) {
+		WorkerQueue& victim = *m_Queues[(workerIndex + i) % queueCount];
+		std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+		if (lock.owns_lock() && !victim.jobs.empty()) {
+			out = std::move(victim.jobs.front());
+			victim.jobs.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::m_Finish(Counter* counter, uint32_t workerIndex)
+{
+	// Decrementing under the lock means a waiter that sees zero can still take the lock once to know
+	// this thread is done touching the counter, and scheduleAfter never misses the transition
+	std::vector<std::pair<Job, Counter*>> continuations;
+	{
+		std::lock_guard<std::mutex> lock(counter->m_Mutex);
+		if (counter->m_Pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			continuations.swap(counter->m_Continuations);
+		}
+	}
+	for (auto& continuation : continuations) {
+		m_Push(workerIndex, std::move(continuation.first), continuation.second);
+	}
+}
+
+void JobSystem::m_PinCurrentThread(uint32_t core)
+{
+	const uint32_t coreCount = std::max(std::thread::hardware_concurrency(), 1u);
+	core %= coreCount;
+#ifdef _WIN32
+	SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core);
+#elif defined(__linux__)
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	CPU_SET(core, &cpuSet);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#endif
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing scheduler. Every thread that runs jobs has its own deque: the owner pushes and pops at
+// the back (newest first, still warm in cache) and idle threads steal from the front of the others.
+// The thread that creates the JobSystem takes part as worker 0 whenever it waits on a Counter.
+class JobSystem
+{
+public:
+	using Job = std::function<void()>;
+
+	// Tracks a group of jobs. Jobs scheduled after a Counter run once everything added to it has finished.
+	// Pass it to wait() before destroying it, a job may still be finishing when isDone() turns true.
+	class Counter
+	{
+	public:
+		Counter() = default;
+
+		// Not copyable or movable, jobs hold a pointer to it
+		Counter(const Counter&) = delete;
+		Counter& operator=(const Counter&) = delete;
+
+		bool isDone() const { return m_Pending.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class JobSystem;
+
+		std::atomic<uint32_t> m_Pending{ 0 };
+		std::mutex m_Mutex;
+		std::vector<std::pair<Job, Counter*>> m_Continuations;
+	};
+
+	// threadCount 0 uses one worker per hardware thread, less the creating thread.
+	// pinThreads locks worker i to core i + 1, leaving core 0 to the creating thread.
+	explicit JobSystem(uint32_t threadCount = 0, bool pinThreads = false);
+	~JobSystem();
+
+	// Not copyable or movable
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// Background threads plus the creating thread
+	uint32_t workerCount() const { return static_cast<uint32_t>(m_Queues.size()); }
+	// Index of the calling thread below workerCount(), UINT32_MAX when it is not part of this JobSystem
+	uint32_t currentWorkerIndex() const;
+
+	// counter, when given, is incremented now and decremented once the job has run
+	void schedule(Job job, Counter* counter = nullptr);
+	// Runs job after everything added to dependency so far has finished
+	void scheduleAfter(Counter& dependency, Job job, Counter* counter = nullptr);
+	// Runs other jobs until counter reaches zero, then rethrows the first exception a job threw
+	void wait(Counter& counter);
+
+	// Calls func(begin, end) over [0, count) in chunks of at most grainSize and waits for all of them
+	void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& func);
+
+	// Span form, calls func(first, count) for each chunk of the array
+	template <typename T, typename Func>
+	void parallelFor(T* data, size_t count, size_t grainSize, Func&& func)
+	{
+		parallelFor(count, grainSize, [&](size_t begin, size_t end) { func(data + begin, end - begin); });
+	}
+
+private:
+	struct WorkerQueue {
+		std::mutex mutex;
+		std::deque<std::pair<Job, Counter*>> jobs;
+	};
+
+	std::vector<std::unique_ptr<WorkerQueue>> m_Queues;
+	std::vector<std::thread> m_Threads;
+	std::atomic<uint32_t> m_QueuedJobs{ 0 };
+	std::atomic<uint32_t> m_NextExternalQueue{ 0 };
+	std::atomic<bool> m_Stopping{ false };
+	std::mutex m_SleepMutex;
+	std::condition_variable m_WakeCondition;
+	std::mutex m_ExceptionMutex;
+	std::exception_ptr m_Exception;
+
+	void m_WorkerLoop(uint32_t workerIndex, bool pin);
+	void m_Push(uint32_t queueIndex, Job job, Counter* counter);
+	bool m_TryRunJob(uint32_t workerIndex);
+	bool m_PopOrSteal(uint32_t workerIndex, std::pair<Job, Counter*>& out);
+	void m_Finish(Counter* counter, uint32_t workerIndex);
+	static void m_PinCurrentThread(uint32_t core);
+};
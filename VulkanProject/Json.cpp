@@ -0,0 +1,286 @@
+#include "Json.h"
+
+#include <cstdlib>
+#include <stdexcept>
+
+class JsonParser
+{
+public:
+	explicit JsonParser(const std::string& text) : m_Text(text) {}
+
+	JsonValue parseDocument()
+	{
+		JsonValue value = m_ParseValue();
+		m_SkipWhitespace();
+		if (m_Position != m_Text.size()) {
+			m_Fail("trailing characters");
+		}
+		return value;
+	}
+
+private:
+	const std::string& m_Text;
+	size_t m_Position{ 0 };
+
+	[[noreturn]] void m_Fail(const char* message)
+	{
+		throw std::runtime_error(std::string("JSON parse error at offset ") + std::to_string(m_Position) + ": " + message);
+	}
+
+	void m_SkipWhitespace()
+	{
+		while (m_Position < m_Text.size() && (m_Text[m_Position] == ' ' || m_Text[m_Position] == '\t' ||
+			m_Text[m_Position] == '\n' || m_Text[m_Position] == '\r')) {
+			m_Position++;
+		}
+	}
+
+	bool m_Consume(char expected)
+	{
+		m_SkipWhitespace();
+		if (m_Position < m_Text.size() && m_Text[m_Position] == expected) {
+			m_Position++;
+			return true;
+		}
+		return false;
+	}
+
+	void m_Expect(char expected)
+	{
+		if (!m_Consume(expected)) {
+			m_Fail("unexpected character");
+		}
+	}
+
+	bool m_ConsumeWord(const char* word)
+	{
+		const size_t length = std::char_traits<char>::length(word);
+		if (m_Text.compare(m_Position, length, word) == 0) {
+			m_Position += length;
+			return true;
+		}
+		return false;
+	}
+
+	JsonValue m_ParseValue()
+	{
+		m_SkipWhitespace();
+		if (m_Position >= m_Text.size()) {
+			m_Fail("unexpected end of input");
+		}
+
+		JsonValue value;
+		const char c = m_Text[m_Position];
+		if (c == '{') {
+			m_Position++;
+			value.m_Type = JsonValue::Type::Object;
+			if (m_Consume('}')) {
+				return value;
+			}
+			do {
+				m_SkipWhitespace();
+				if (m_Position >= m_Text.size() || m_Text[m_Position] != '"') {
+					m_Fail("expected a member name");
+				}
+				std::string key = m_ParseString();
+				m_Expect(':');
+				value.m_Object[key] = m_ParseValue();
+			} while (m_Consume(','));
+			m_Expect('}');
+		}
+		else if (c == '[') {
+			m_Position++;
+			value.m_Type = JsonValue::Type::Array;
+			if (m_Consume(']')) {
+				return value;
+			}
+			do {
+				value.m_Array.push_back(m_ParseValue());
+			} while (m_Consume(','));
+			m_Expect(']');
+		}
+		else if (c == '"') {
+			value.m_Type = JsonValue::Type::String;
+			value.m_String = m_ParseString();
+		}
+		else if (m_ConsumeWord("true")) {
+			value.m_Type = JsonValue::Type::Bool;
+			value.m_Bool = true;
+		}
+		else if (m_ConsumeWord("false")) {
+			value.m_Type = JsonValue::Type::Bool;
+		}
+		else if (m_ConsumeWord("null")) {
+			value.m_Type = JsonValue::Type::Null;
+		}
+		else if (c == '-' || (c >= '0' && c <= '9')) {
+			const char* start = m_Text.c_str() + m_Position;
+			char* end = nullptr;
+			value.m_Type = JsonValue::Type::Number;
+			value.m_Number = std::strtod(start, &end);
+			m_Position += end - start;
+		}
+		else {
+			m_Fail("unexpected character");
+		}
+		return value;
+	}
+
+	std::string m_ParseString()
+	{
+		m_Position++;		// Opening quote
+		std::string result;
+		while (m_Position < m_Text.size() && m_Text[m_Position] != '"') {
+			char c = m_Text[m_Position++];
+			if (c != '\\') {
+				result += c;
+				continue;
+			}
+			if (m_Position >= m_Text.size()) {
+				break;
+			}
+			c = m_Text[m_Position++];
+			switch (c) {
+			case 'b': result += '\b'; break;
+			case 'f': result += '\f'; break;
+			case 'n': result += '\n'; break;
+			case 'r': result += '\r'; break;
+			case 't': result += '\t'; break;
+			case 'u': m_AppendCodepoint(result); break;
+			default: result += c; break;
+			}
+		}
+		if (m_Position >= m_Text.size()) {
+			m_Fail("unterminated string");
+		}
+		m_Position++;		// Closing quote
+		return result;
+	}
+
+	uint32_t m_ParseHex4()
+	{
+		if (m_Position + 4 > m_Text.size()) {
+			m_Fail("truncated \\u escape");
+		}
+		const uint32_t codepoint = static_cast<uint32_t>(std::strtoul(m_Text.substr(m_Position, 4).c_str(), nullptr, 16));
+		m_Position += 4;
+		return codepoint;
+	}
+
+	void m_AppendCodepoint(std::string& out)
+	{
+		uint32_t codepoint = m_ParseHex4();
+		// Surrogate pair
+		if (codepoint >= 0xD800 && codepoint <= 0xDBFF && m_Text.compare(m_Position, 2, "\\u") == 0) {
+			m_Position += 2;
+			codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (m_ParseHex4() - 0xDC00);
+		}
+
+		// UTF-8 encode
+		if (codepoint < 0x80) {
+			out += static_cast<char>(codepoint);
+		}
+		else if (codepoint < 0x800) {
+			out += static_cast<char>(0xC0 | (codepoint >> 6));
+			out += static_cast<char>(0x80 | (codepoint & 0x3F));
+		}
+		else if (codepoint < 0x10000) {
+			out += static_cast<char>(0xE0 | (codepoint >> 12));
+			out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (codepoint & 0x3F));
+		}
+		else {
+			out += static_cast<char>(0xF0 | (codepoint >> 18));
+			out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+			out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (codepoint & 0x3F));
+		}
+	}
+};
+
+JsonValue JsonValue::parse(const std::string& text)
+{
+	return JsonParser(text).parseDocument();
+}
+
+bool JsonValue::asBool() const
+{
+	if (m_Type != Type::Bool) {
+		throw std::runtime_error("JSON value is not a bool");
+	}
+	return m_Bool;
+}
+
+double JsonValue::asNumber() const
+{
+	if (m_Type != Type::Number) {
+		throw std::runtime_error("JSON value is not a number");
+	}
+	return m_Number;
+}
+
+uint32_t JsonValue::asUint() const
+{
+	const double number = asNumber();
+	if (number < 0.0 || number > static_cast<double>(UINT32_MAX)) {
+		throw std::runtime_error("JSON number is out of range for an unsigned index");
+	}
+	return static_cast<uint32_t>(number);
+}
+
+const std::string& JsonValue::asString() const
+{
+	if (m_Type != Type::String) {
+		throw std::runtime_error("JSON value is not a string");
+	}
+	return m_String;
+}
+
+const std::vector<JsonValue>& JsonValue::asArray() const
+{
+	if (m_Type != Type::Array) {
+		throw std::runtime_error("JSON value is not an array");
+	}
+	return m_Array;
+}
+
+bool JsonValue::has(const std::string& key) const
+{
+	return m_Type == Type::Object && m_Object.count(key) > 0;
+}
+
+const JsonValue& JsonValue::operator[](const std::string& key) const
+{
+	if (m_Type != Type::Object) {
+		throw std::runtime_error("JSON value is not an object");
+	}
+	auto it = m_Object.find(key);
+	if (it == m_Object.end()) {
+		throw std::runtime_error("JSON object has no member \"" + key + "\"");
+	}
+	return it->second;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const
+{
+	const std::vector<JsonValue>& array = asArray();
+	if (index >= array.size()) {
+		throw std::runtime_error("JSON array index out of range");
+	}
+	return array[index];
+}
+
+size_t JsonValue::size() const
+{
+	return m_Type == Type::Array ? m_Array.size() : m_Type == Type::Object ? m_Object.size() : 0;
+}
+
+uint32_t JsonValue::getUint(const std::string& key, uint32_t fallback) const
+{
+	return has(key) ? (*this)[key].asUint() : fallback;
+}
+
+std::string JsonValue::getString(const std::string& key, const std::string& fallback) const
+{
+	return has(key) ? (*this)[key].asString() : fallback;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Minimal JSON document, enough to read glTF. Parse errors and wrong-type access throw std::runtime_error.
+class JsonValue
+{
+public:
+	enum class Type { Null, Bool, Number, String, Array, Object };
+
+	static JsonValue parse(const std::string& text);
+
+	Type type() const { return m_Type; }
+	bool isNull() const { return m_Type == Type::Null; }
+
+	bool asBool() const;
+	double asNumber() const;
+	uint32_t asUint() const;
+	const std::string& asString() const;
+	const std::vector<JsonValue>& asArray() const;
+
+	// Object members, has() is false for non-objects
+	bool has(const std::string& key) const;
+	const JsonValue& operator[](const std::string& key) const;
+	// Array elements
+	const JsonValue& operator[](size_t index) const;
+	size_t size() const;
+
+	// Shorthand for optional members
+	uint32_t getUint(const std::string& key, uint32_t fallback) const;
+	std::string getString(const std::string& key, const std::string& fallback) const;
+
+private:
+	Type m_Type{ Type::Null };
+	bool m_Bool{ false };
+	double m_Number{ 0.0 };
+	std::string m_String;
+	std::vector<JsonValue> m_Array;
+	std::map<std::string, JsonValue> m_Object;
+
+	friend class JsonParser;
+};
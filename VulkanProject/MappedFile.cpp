@@ -0,0 +1,89 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::unique_ptr<MappedFile> MappedFile::open(const std::string& path)
+{
+	std::unique_ptr<MappedFile> file{ new MappedFile() };
+
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return nullptr;
+	}
+	file->m_File = handle;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(handle, &size)) {
+		return nullptr;
+	}
+	file->m_Size = static_cast<size_t>(size.QuadPart);
+	// Empty files cannot be mapped, they are still valid
+	if (file->m_Size == 0) {
+		return file;
+	}
+
+	file->m_Mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!file->m_Mapping) {
+		return nullptr;
+	}
+	file->m_Data = static_cast<const uint8_t*>(MapViewOfFile(file->m_Mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!file->m_Data) {
+		return nullptr;
+	}
+#else
+	file->m_Descriptor = ::open(path.c_str(), O_RDONLY);
+	if (file->m_Descriptor < 0) {
+		return nullptr;
+	}
+
+	struct stat status;
+	if (fstat(file->m_Descriptor, &status) != 0) {
+		return nullptr;
+	}
+	file->m_Size = static_cast<size_t>(status.st_size);
+	if (file->m_Size == 0) {
+		return file;
+	}
+
+	void* data = mmap(nullptr, file->m_Size, PROT_READ, MAP_PRIVATE, file->m_Descriptor, 0);
+	if (data == MAP_FAILED) {
+		return nullptr;
+	}
+	file->m_Data = static_cast<const uint8_t*>(data);
+	madvise(data, file->m_Size, MADV_SEQUENTIAL);
+#endif
+
+	return file;
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+	if (m_Data) {
+		UnmapViewOfFile(m_Data);
+	}
+	if (m_Mapping) {
+		CloseHandle(m_Mapping);
+	}
+	if (m_File) {
+		CloseHandle(m_File);
+	}
+#else
+	if (m_Data) {
+		munmap(const_cast<uint8_t*>(m_Data), m_Size);
+	}
+	if (m_Descriptor >= 0) {
+		close(m_Descriptor);
+	}
+#endif
+}
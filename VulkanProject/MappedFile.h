@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages are read in by the OS as they are touched,
+// so nothing is copied until the data is actually used.
+class MappedFile
+{
+public:
+	// Null when the file cannot be opened or mapped
+	static std::unique_ptr<MappedFile> open(const std::string& path);
+	~MappedFile();
+
+	// Not copyable or movable
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const uint8_t* data() const { return m_Data; }
+	size_t size() const { return m_Size; }
+
+private:
+	MappedFile() = default;
+
+	const uint8_t* m_Data{ nullptr };
+	size_t m_Size{ 0 };
+#ifdef _WIN32
+	void* m_File{ nullptr };
+	void* m_Mapping{ nullptr };
+#else
+	int m_Descriptor{ -1 };
+#endif
+};
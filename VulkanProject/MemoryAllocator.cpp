@@ -0,0 +1,293 @@
+#include "MemoryAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+float MemoryAllocator::Stats::fragmentation() const
+{
+	const VkDeviceSize freeBytes = reservedBytes - usedBytes;
+	if (freeBytes == 0) {
+		return 0.0f;
+	}
+	return 1.0f - static_cast<float>(largestFreeRange) / static_cast<float>(freeBytes);
+}
+
+MemoryAllocator::MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize)
+	: m_Device(device), m_BlockSize(blockSize)
+{
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_MemoryProperties);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	m_BufferImageGranularity = properties.limits.bufferImageGranularity;
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+	for (uint32_t i = 0; i < m_Blocks.size(); i++) {
+		if (m_Blocks[i] == nullptr) {
+			continue;
+		}
+		if (!m_Blocks[i]->allocations.empty()) {
+			std::cerr << "memory block " << i << " destroyed with " << m_Blocks[i]->allocations.size()
+				<< " live allocation(s)" << std::endl;
+		}
+		m_DestroyBlock(i);
+	}
+}
+
+Allocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear)
+{
+	const uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+	const VkDeviceSize alignment = requirements.alignment > 0 ? requirements.alignment : 1;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	uint32_t blockId = UINT32_MAX;
+	VkDeviceSize offset = 0;
+
+	if (requirements.size > m_BlockSize / 2) {
+		// Large resources get their own memory so they don't waste most of a shared block
+		blockId = m_CreateBlock(memoryTypeIndex, requirements.size, true);
+		m_Blocks[blockId]->allocations[0] = { requirements.size, linear };
+		m_Blocks[blockId]->freeRanges.clear();
+	}
+	else {
+		for (uint32_t i = 0; i < m_Blocks.size(); i++) {
+			Block* block = m_Blocks[i].get();
+			if (block == nullptr || block->dedicated || block->memoryTypeIndex != memoryTypeIndex) {
+				continue;
+			}
+			if (m_TryAllocate(*block, requirements.size, alignment, linear, offset)) {
+				blockId = i;
+				break;
+			}
+		}
+
+		if (blockId == UINT32_MAX) {
+			blockId = m_CreateBlock(memoryTypeIndex, m_BlockSize, false);
+			if (!m_TryAllocate(*m_Blocks[blockId], requirements.size, alignment, linear, offset)) {
+				throw std::runtime_error("failed to place allocation in a new memory block!");
+			}
+		}
+	}
+
+	const Block& block = *m_Blocks[blockId];
+	Allocation allocation{};
+	allocation.memory = block.memory;
+	allocation.offset = offset;
+	allocation.size = requirements.size;
+	allocation.memoryTypeIndex = memoryTypeIndex;
+	allocation.blockId = blockId;
+	if (block.mappedData != nullptr) {
+		allocation.mappedData = static_cast<char*>(block.mappedData) + offset;
+	}
+	return allocation;
+}
+
+void MemoryAllocator::free(Allocation& allocation)
+{
+	if (!allocation.isValid()) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	assert(allocation.blockId < m_Blocks.size() && m_Blocks[allocation.blockId] != nullptr && "Freeing an allocation from an unknown block");
+	Block& block = *m_Blocks[allocation.blockId];
+
+	if (block.dedicated) {
+		m_DestroyBlock(allocation.blockId);
+		allocation = {};
+		return;
+	}
+
+	auto allocationIt = block.allocations.find(allocation.offset);
+	assert(allocationIt != block.allocations.end() && "Freeing an allocation that is not live");
+	VkDeviceSize offset = allocationIt->first;
+	VkDeviceSize size = allocationIt->second.size;
+	block.allocations.erase(allocationIt);
+
+	// Coalesce with the free ranges on either side
+	auto next = block.freeRanges.lower_bound(offset);
+	if (next != block.freeRanges.end() && next->first == offset + size) {
+		size += next->second;
+		next = block.freeRanges.erase(next);
+	}
+	if (next != block.freeRanges.begin() && std::prev(next)->first + std::prev(next)->second == offset) {
+		std::prev(next)->second += size;
+	}
+	else {
+		block.freeRanges[offset] = size;
+	}
+
+	// Keep one empty block per memory type around so alloc/free churn doesn't hit the driver
+	if (block.allocations.empty()) {
+		for (uint32_t i = 0; i < m_Blocks.size(); i++) {
+			const Block* other = m_Blocks[i].get();
+			if (i != allocation.blockId && other != nullptr && !other->dedicated &&
+				other->memoryTypeIndex == block.memoryTypeIndex) {
+				m_DestroyBlock(allocation.blockId);
+				break;
+			}
+		}
+	}
+
+	allocation = {};
+}
+
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1 << i)) &&
+			(m_MemoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+MemoryAllocator::Stats MemoryAllocator::getStats()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	Stats stats{};
+	for (const auto& block : m_Blocks) {
+		if (block == nullptr) {
+			continue;
+		}
+		stats.blockCount++;
+		stats.dedicatedBlockCount += block->dedicated ? 1 : 0;
+		stats.allocationCount += static_cast<uint32_t>(block->allocations.size());
+		stats.reservedBytes += block->size;
+		for (const auto& allocation : block->allocations) {
+			stats.usedBytes += allocation.second.size;
+		}
+		stats.freeRangeCount += static_cast<uint32_t>(block->freeRanges.size());
+		for (const auto& range : block->freeRanges) {
+			stats.largestFreeRange = std::max(stats.largestFreeRange, range.second);
+		}
+	}
+	return stats;
+}
+
+void MemoryAllocator::printStats()
+{
+	const Stats stats = getStats();
+	std::cout << "device memory: " << stats.allocationCount << " allocation(s) in "
+		<< stats.blockCount << " block(s) (" << stats.dedicatedBlockCount << " dedicated)" << std::endl;
+	std::cout << "\tused " << stats.usedBytes / 1024 << " KiB of " << stats.reservedBytes / 1024 << " KiB reserved" << std::endl;
+	std::cout << "\t" << stats.freeRangeCount << " free range(s), largest " << stats.largestFreeRange / 1024
+		<< " KiB, fragmentation " << stats.fragmentation() * 100.0f << "%" << std::endl;
+}
+
+uint32_t MemoryAllocator::m_CreateBlock(uint32_t memoryTypeIndex, VkDeviceSize size, bool dedicated)
+{
+	auto block = std::make_unique<Block>();
+	block->size = size;
+	block->memoryTypeIndex = memoryTypeIndex;
+	block->dedicated = dedicated;
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	if (vkAllocateMemory(m_Device, &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate device memory block!");
+	}
+
+	// A VkDeviceMemory can only be mapped once, so host visible blocks stay mapped for their lifetime
+	if (m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		if (vkMapMemory(m_Device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mappedData) != VK_SUCCESS) {
+			throw std::runtime_error("failed to map device memory block!");
+		}
+	}
+
+	block->freeRanges[0] = size;
+
+	for (uint32_t i = 0; i < m_Blocks.size(); i++) {
+		if (m_Blocks[i] == nullptr) {
+			m_Blocks[i] = std::move(block);
+			return i;
+		}
+	}
+	m_Blocks.push_back(std::move(block));
+	return static_cast<uint32_t>(m_Blocks.size() - 1);
+}
+
+void MemoryAllocator::m_DestroyBlock(uint32_t blockId)
+{
+	// Freeing the memory implicitly unmaps it
+	vkFreeMemory(m_Device, m_Blocks[blockId]->memory, nullptr);
+	m_Blocks[blockId].reset();
+}
+
+bool MemoryAllocator::m_TryAllocate(Block& block, VkDeviceSize size, VkDeviceSize alignment, bool linear, VkDeviceSize& outOffset)
+{
+	auto best = block.freeRanges.end();
+	VkDeviceSize bestOffset = 0;
+
+	// Best fit: the smallest free range the request fits in
+	for (auto range = block.freeRanges.begin(); range != block.freeRanges.end(); ++range) {
+		const VkDeviceSize rangeEnd = range->first + range->second;
+		if (range->second < size) {
+			continue;
+		}
+
+		VkDeviceSize offset = alignUp(range->first, alignment);
+
+		// Linear and optimal resources must not share a bufferImageGranularity page
+		auto next = block.allocations.lower_bound(range->first);
+		if (next != block.allocations.begin()) {
+			auto previous = std::prev(next);
+			if (previous->second.linear != linear && m_OnSamePage(previous->first + previous->second.size, offset)) {
+				offset = alignUp(offset, m_BufferImageGranularity);
+			}
+		}
+		if (offset + size > rangeEnd) {
+			continue;
+		}
+		if (next != block.allocations.end() && next->second.linear != linear && m_OnSamePage(offset + size, next->first)) {
+			continue;
+		}
+
+		if (best == block.freeRanges.end() || range->second < best->second) {
+			best = range;
+			bestOffset = offset;
+		}
+	}
+
+	if (best == block.freeRanges.end()) {
+		return false;
+	}
+
+	const VkDeviceSize rangeStart = best->first;
+	const VkDeviceSize rangeEnd = best->first + best->second;
+	block.freeRanges.erase(best);
+	if (bestOffset > rangeStart) {
+		block.freeRanges[rangeStart] = bestOffset - rangeStart;
+	}
+	if (bestOffset + size < rangeEnd) {
+		block.freeRanges[bestOffset + size] = rangeEnd - (bestOffset + size);
+	}
+	block.allocations[bestOffset] = { size, linear };
+
+	outOffset = bestOffset;
+	return true;
+}
+
+bool MemoryAllocator::m_OnSamePage(VkDeviceSize endOfFirst, VkDeviceSize startOfSecond) const
+{
+	const VkDeviceSize pageMask = ~(m_BufferImageGranularity - 1);
+	return ((endOfFirst - 1) & pageMask) == (startOfSecond & pageMask);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// A sub-range of a VkDeviceMemory block handed out by the MemoryAllocator
+struct Allocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void* mappedData = nullptr;			// Points at offset inside the block, null unless host visible
+	uint32_t memoryTypeIndex = 0;
+	uint32_t blockId = UINT32_MAX;
+
+	bool isValid() const { return memory != VK_NULL_HANDLE; }
+};
+
+// Places buffers and images into large per-memory-type blocks instead of one vkAllocateMemory each
+class MemoryAllocator
+{
+public:
+	static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+	struct Stats {
+		uint32_t blockCount = 0;
+		uint32_t dedicatedBlockCount = 0;
+		uint32_t allocationCount = 0;
+		VkDeviceSize reservedBytes = 0;		// Sum of all VkDeviceMemory block sizes
+		VkDeviceSize usedBytes = 0;			// Sum of live allocation sizes
+		uint32_t freeRangeCount = 0;
+		VkDeviceSize largestFreeRange = 0;
+
+		// 0 when all free space is one contiguous range, approaching 1 as it splinters
+		float fragmentation() const;
+	};
+
+	MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+	~MemoryAllocator();
+
+	// Not copyable or movable
+	MemoryAllocator(const MemoryAllocator&) = delete;
+	MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+	// linear is true for buffers and linear-tiled images, false for optimal-tiled images
+	Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear);
+	void free(Allocation& allocation);
+
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+	Stats getStats();
+	void printStats();
+
+private:
+	struct Suballocation {
+		VkDeviceSize size;
+		bool linear;
+	};
+
+	struct Block {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeIndex = 0;
+		void* mappedData = nullptr;
+		bool dedicated = false;
+		std::map<VkDeviceSize, VkDeviceSize> freeRanges;		// offset -> size
+		std::map<VkDeviceSize, Suballocation> allocations;		// offset -> allocation
+	};
+
+	VkDevice m_Device;
+	VkPhysicalDeviceMemoryProperties m_MemoryProperties;
+	VkDeviceSize m_BufferImageGranularity;
+	VkDeviceSize m_BlockSize;
+	std::vector<std::unique_ptr<Block>> m_Blocks;
+	std::mutex m_Mutex;
+
+	uint32_t m_CreateBlock(uint32_t memoryTypeIndex, VkDeviceSize size, bool dedicated);
+	void m_DestroyBlock(uint32_t blockId);
+	bool m_TryAllocate(Block& block, VkDeviceSize size, VkDeviceSize alignment, bool linear, VkDeviceSize& outOffset);
+	bool m_OnSamePage(VkDeviceSize endOfFirst, VkDeviceSize startOfSecond) const;
+};
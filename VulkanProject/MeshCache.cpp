@@ -0,0 +1,219 @@
+#include "MeshCache.h"
+
+#include "MeshLoader.h"
+#include "Profiler.h"
+#include "VertexLayout.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+	constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+	constexpr uint64_t FNV_PRIME = 1099511628211ull;
+	constexpr uint64_t SECTION_ALIGNMENT = 16;
+
+	uint64_t alignUp(uint64_t value)
+	{
+		return (value + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+	}
+}
+
+std::unique_ptr<MeshCache> MeshCache::open(const std::string& cachePath, uint64_t sourceHash)
+{
+	PROFILE_FUNCTION();
+	std::unique_ptr<MappedFile> file = MappedFile::open(cachePath);
+	if (!file || file->size() < sizeof(Header)) {
+		return nullptr;
+	}
+
+	const Header& header = *reinterpret_cast<const Header*>(file->data());
+	if (header.magic != MAGIC || header.version != VERSION || header.sourceHash != sourceHash || !m_LayoutMatches(header)) {
+		return nullptr;
+	}
+
+	// Guard against truncated files before anything reads through the offsets
+	const uint64_t indexSize = header.indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	if ((header.indexType != VK_INDEX_TYPE_UINT16 && header.indexType != VK_INDEX_TYPE_UINT32) ||
+		header.vertexOffset % SECTION_ALIGNMENT != 0 || header.indexOffset % SECTION_ALIGNMENT != 0 ||
+		header.vertexOffset + uint64_t(header.vertexCount) * header.vertexStride > file->size() ||
+		header.indexOffset + uint64_t(header.indexCount) * indexSize > file->size() || header.lodCount > MAX_LODS ||
+		header.meshletOffset + uint64_t(header.meshletCount) * sizeof(Model::Meshlet) > file->size() ||
+		header.meshletVertexOffset + uint64_t(header.meshletVertexCount) * sizeof(uint32_t) > file->size() ||
+		header.meshletTriangleOffset + header.meshletTriangleBytes > file->size()) {
+		return nullptr;
+	}
+	for (uint32_t i = 0; i < header.lodCount; i++) {
+		if (uint64_t(header.lods[i].firstIndex) + header.lods[i].indexCount > header.indexCount) {
+			return nullptr;
+		}
+	}
+
+	return std::unique_ptr<MeshCache>(new MeshCache(std::move(file)));
+}
+
+void MeshCache::write(const std::string& cachePath, uint64_t sourceHash, const Model::Builder& builder)
+{
+	PROFILE_FUNCTION();
+	Header header{};
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.sourceHash = sourceHash;
+	const VertexLayout& layout = VertexLayout::active();
+	header.vertexStride = layout.stride();
+
+	const std::vector<VkVertexInputAttributeDescription> attributes = Model::Vertex::getAttributeDescriptions();
+	header.attributeCount = static_cast<uint32_t>(attributes.size());
+	if (header.attributeCount > MAX_ATTRIBUTES) {
+		throw std::runtime_error("vertex layout has too many attributes for the mesh cache");
+	}
+	for (uint32_t i = 0; i < header.attributeCount; i++) {
+		header.attributes[i] = { attributes[i].location, static_cast<uint32_t>(attributes[i].format), attributes[i].offset };
+	}
+
+	header.vertexCount = static_cast<uint32_t>(builder.vertices.size());
+	header.indexCount = static_cast<uint32_t>(builder.indices.size());
+	header.lodCount = static_cast<uint32_t>(std::min<size_t>(builder.lods.size(), MAX_LODS));
+	std::copy(builder.lods.begin(), builder.lods.begin() + header.lodCount, header.lods);
+	header.boundsMin = glm::vec2{ std::numeric_limits<float>::max() };
+	header.boundsMax = glm::vec2{ std::numeric_limits<float>::lowest() };
+	for (const auto& vertex : builder.vertices) {
+		header.boundingRadius = std::max(header.boundingRadius, glm::length(vertex.position));
+		header.boundsMin = glm::min(header.boundsMin, vertex.position);
+		header.boundsMax = glm::max(header.boundsMax, vertex.position);
+	}
+
+	header.positionScale = layout.positionScale(builder.vertices.data(), builder.vertices.size());
+	std::vector<uint8_t> packedVertices(size_t(header.vertexStride) * builder.vertices.size());
+	layout.pack(builder.vertices.data(), builder.vertices.size(), header.positionScale, packedVertices.data());
+
+	// Stored in the narrowest type Model would pick, so it can upload the section as is
+	std::vector<uint16_t> shortIndices;
+	const void* indexData = builder.indices.data();
+	uint64_t indexBytes = sizeof(uint32_t) * builder.indices.size();
+	header.indexType = VK_INDEX_TYPE_UINT32;
+	if (builder.vertices.size() <= std::numeric_limits<uint16_t>::max()) {
+		shortIndices.assign(builder.indices.begin(), builder.indices.end());
+		indexData = shortIndices.data();
+		indexBytes = sizeof(uint16_t) * shortIndices.size();
+		header.indexType = VK_INDEX_TYPE_UINT16;
+	}
+
+	header.meshletCount = static_cast<uint32_t>(builder.meshlets.size());
+	header.meshletVertexCount = static_cast<uint32_t>(builder.meshletVertices.size());
+	header.meshletTriangleBytes = static_cast<uint32_t>(builder.meshletTriangles.size());
+
+	const uint64_t vertexBytes = packedVertices.size();
+	const uint64_t meshletBytes = sizeof(Model::Meshlet) * builder.meshlets.size();
+	const uint64_t meshletVertexBytes = sizeof(uint32_t) * builder.meshletVertices.size();
+	header.vertexOffset = alignUp(sizeof(Header));
+	header.indexOffset = alignUp(header.vertexOffset + vertexBytes);
+	header.meshletOffset = alignUp(header.indexOffset + indexBytes);
+	header.meshletVertexOffset = alignUp(header.meshletOffset + meshletBytes);
+	header.meshletTriangleOffset = alignUp(header.meshletVertexOffset + meshletVertexBytes);
+
+	// Write beside the old file and swap, a reader never maps a half-written cache
+	const std::string temporaryPath = cachePath + ".tmp";
+	{
+		std::ofstream file{ temporaryPath, std::ios::binary | std::ios::trunc };
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to create mesh cache: " + temporaryPath);
+		}
+
+		const char padding[SECTION_ALIGNMENT] = {};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+		file.write(padding, header.vertexOffset - sizeof(Header));
+		file.write(reinterpret_cast<const char*>(packedVertices.data()), vertexBytes);
+		file.write(padding, header.indexOffset - header.vertexOffset - vertexBytes);
+		file.write(static_cast<const char*>(indexData), indexBytes);
+		file.write(padding, header.meshletOffset - header.indexOffset - indexBytes);
+		file.write(reinterpret_cast<const char*>(builder.meshlets.data()), meshletBytes);
+		file.write(padding, header.meshletVertexOffset - header.meshletOffset - meshletBytes);
+		file.write(reinterpret_cast<const char*>(builder.meshletVertices.data()), meshletVertexBytes);
+		file.write(padding, header.meshletTriangleOffset - header.meshletVertexOffset - meshletVertexBytes);
+		file.write(reinterpret_cast<const char*>(builder.meshletTriangles.data()), header.meshletTriangleBytes);
+		if (!file) {
+			throw std::runtime_error("failed to write mesh cache: " + temporaryPath);
+		}
+	}
+
+	std::remove(cachePath.c_str());
+	if (std::rename(temporaryPath.c_str(), cachePath.c_str()) != 0) {
+		std::remove(temporaryPath.c_str());
+		throw std::runtime_error("failed to replace mesh cache: " + cachePath);
+	}
+}
+
+std::string MeshCache::cachePathFor(const std::string& sourcePath)
+{
+	return sourcePath + ".meshcache";
+}
+
+uint64_t MeshCache::hashFile(const std::string& path)
+{
+	PROFILE_FUNCTION();
+	std::unique_ptr<MappedFile> file = MappedFile::open(path);
+	if (!file) {
+		throw std::runtime_error("failed to open file: " + path);
+	}
+
+	uint64_t hash = FNV_OFFSET_BASIS;
+	const uint8_t* data = file->data();
+	for (size_t i = 0; i < file->size(); i++) {
+		hash = (hash ^ data[i]) * FNV_PRIME;
+	}
+	return hash;
+}
+
+uint64_t MeshCache::hashSource(const std::string& path)
+{
+	uint64_t hash = hashFile(path);
+	for (const std::string& dependency : MeshLoader::dependencies(path)) {
+		hash = (hash ^ hashFile(dependency)) * FNV_PRIME;
+	}
+	return hash;
+}
+
+Model::MeshView MeshCache::view() const
+{
+	const Header& cached = header();
+	Model::MeshView mesh{};
+	mesh.vertices = m_File->data() + cached.vertexOffset;
+	mesh.vertexCount = cached.vertexCount;
+	mesh.indices = cached.indexCount > 0 ? m_File->data() + cached.indexOffset : nullptr;
+	mesh.indexCount = cached.indexCount;
+	mesh.indexType = static_cast<VkIndexType>(cached.indexType);
+	mesh.boundingRadius = cached.boundingRadius;
+	mesh.positionScale = cached.positionScale;
+	mesh.lods = cached.lodCount > 0 ? cached.lods : nullptr;
+	mesh.lodCount = cached.lodCount;
+	if (cached.meshletCount > 0) {
+		mesh.meshlets = reinterpret_cast<const Model::Meshlet*>(m_File->data() + cached.meshletOffset);
+		mesh.meshletCount = cached.meshletCount;
+		mesh.meshletVertices = reinterpret_cast<const uint32_t*>(m_File->data() + cached.meshletVertexOffset);
+		mesh.meshletVertexCount = cached.meshletVertexCount;
+		mesh.meshletTriangles = m_File->data() + cached.meshletTriangleOffset;
+		mesh.meshletTriangleBytes = cached.meshletTriangleBytes;
+	}
+	return mesh;
+}
+
+bool MeshCache::m_LayoutMatches(const Header& header)
+{
+	const std::vector<VkVertexInputAttributeDescription> attributes = Model::Vertex::getAttributeDescriptions();
+	if (header.vertexStride != VertexLayout::active().stride() || header.attributeCount != attributes.size()) {
+		return false;
+	}
+	for (uint32_t i = 0; i < header.attributeCount; i++) {
+		if (header.attributes[i].location != attributes[i].location ||
+			header.attributes[i].format != static_cast<uint32_t>(attributes[i].format) ||
+			header.attributes[i].offset != attributes[i].offset) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "Model.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Cooked binary mesh: a header, then the vertices, indices and meshlets exactly as the GPU buffers hold them,
+// vertices packed in the active VertexLayout.
+// A cache file is memory mapped and handed to Model as a MeshView, so a warm load does no parsing or conversion.
+// It is tied to the source by a hash of its contents and of every buffer file it references, and to the
+// VertexLayout by a copy of the attributes,
+// a mismatch in either makes open() treat the file as stale.
+class MeshCache
+{
+public:
+	static constexpr uint32_t MAGIC = 0x434D4B56;		// "VKMC"
+	static constexpr uint32_t VERSION = 5;
+	static constexpr uint32_t MAX_ATTRIBUTES = 8;
+	static constexpr uint32_t MAX_LODS = 8;
+
+	struct Attribute {
+		uint32_t location;
+		uint32_t format;		// VkFormat
+		uint32_t offset;
+	};
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t vertexStride;
+		uint32_t attributeCount;
+		Attribute attributes[MAX_ATTRIBUTES];
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t indexType;		// VkIndexType
+		uint32_t lodCount;		// 0 for a mesh without LODs
+		Model::Lod lods[MAX_LODS];		// Ranges of the index section
+		float boundingRadius;
+		float positionScale;		// Model::getPositionScale
+		glm::vec2 boundsMin;
+		glm::vec2 boundsMax;
+		uint64_t vertexOffset;		// From the start of the file
+		uint64_t indexOffset;
+		uint32_t meshletCount;		// 0 when the mesh was cooked without meshlets
+		uint32_t meshletVertexCount;
+		uint32_t meshletTriangleBytes;
+		uint64_t meshletOffset;
+		uint64_t meshletVertexOffset;
+		uint64_t meshletTriangleOffset;
+	};
+
+	// Maps cachePath, null when it is missing, damaged, built from a different source or for another vertex layout
+	static std::unique_ptr<MeshCache> open(const std::string& cachePath, uint64_t sourceHash);
+	// Cooks builder into cachePath, replacing the old file only once the new one is complete
+	static void write(const std::string& cachePath, uint64_t sourceHash, const Model::Builder& builder);
+
+	// Where the cache for a source asset lives, next to it
+	static std::string cachePathFor(const std::string& sourcePath);
+	// 64-bit FNV-1a of the file contents
+	static uint64_t hashFile(const std::string& path);
+	// hashFile of a source asset combined with that of each file MeshLoader reads alongside it
+	static uint64_t hashSource(const std::string& path);
+
+	const Header& header() const { return *reinterpret_cast<const Header*>(m_File->data()); }
+	// Points into the mapping, only valid while this MeshCache is alive
+	Model::MeshView view() const;
+
+private:
+	explicit MeshCache(std::unique_ptr<MappedFile> file) : m_File(std::move(file)) {}
+
+	std::unique_ptr<MappedFile> m_File;
+
+	static bool m_LayoutMatches(const Header& header);
+};
@@ -0,0 +1,464 @@
+#include "MeshLoader.h"
+
+#include "Json.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+	constexpr uint32_t GLB_MAGIC = 0x46546C67;			// "glTF"
+	constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+	constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;
+	constexpr uint32_t GLTF_MODE_TRIANGLES = 4;
+
+	constexpr uint32_t GLTF_BYTE = 5120;
+	constexpr uint32_t GLTF_UNSIGNED_BYTE = 5121;
+	constexpr uint32_t GLTF_SHORT = 5122;
+	constexpr uint32_t GLTF_UNSIGNED_SHORT = 5123;
+	constexpr uint32_t GLTF_UNSIGNED_INT = 5125;
+	constexpr uint32_t GLTF_FLOAT = 5126;
+
+	const glm::vec3 DEFAULT_COLOUR{ 1.0f, 1.0f, 1.0f };
+
+	std::string readFile(const std::string& path)
+	{
+		std::ifstream file{ path, std::ios::binary };
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to open file: " + path);
+		}
+		std::ostringstream contents;
+		contents << file.rdbuf();
+		return contents.str();
+	}
+
+	std::string extensionOf(const std::string& path)
+	{
+		const size_t dot = path.find_last_of('.');
+		if (dot == std::string::npos) {
+			return {};
+		}
+		std::string extension = path.substr(dot + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(::tolower(c)); });
+		return extension;
+	}
+
+	std::string directoryOf(const std::string& path)
+	{
+		const size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string{} : path.substr(0, slash + 1);
+	}
+
+	template <typename T>
+	T readUnaligned(const uint8_t* data)
+	{
+		T value;
+		memcpy(&value, data, sizeof(T));
+		return value;
+	}
+
+	// OBJ indices are 1-based, negative ones count back from the latest element
+	uint32_t resolveObjIndex(long index, size_t count, const std::string& path)
+	{
+		const long resolved = index > 0 ? index - 1 : static_cast<long>(count) + index;
+		if (index == 0 || resolved < 0 || static_cast<size_t>(resolved) >= count) {
+			throw std::runtime_error("OBJ face index out of range in " + path);
+		}
+		return static_cast<uint32_t>(resolved);
+	}
+
+	std::vector<uint8_t> decodeBase64(const std::string& text, size_t begin)
+	{
+		auto value = [](char c) -> int {
+			if (c >= 'A' && c <= 'Z') return c - 'A';
+			if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+			if (c >= '0' && c <= '9') return c - '0' + 52;
+			if (c == '+') return 62;
+			if (c == '/') return 63;
+			return -1;
+		};
+
+		std::vector<uint8_t> bytes;
+		bytes.reserve((text.size() - begin) * 3 / 4);
+		uint32_t accumulator = 0;
+		int bits = 0;
+		for (size_t i = begin; i < text.size(); i++) {
+			const int digit = value(text[i]);
+			if (digit < 0) {
+				continue;		// Padding and whitespace
+			}
+			accumulator = (accumulator << 6) | static_cast<uint32_t>(digit);
+			bits += 6;
+			if (bits >= 8) {
+				bits -= 8;
+				bytes.push_back(static_cast<uint8_t>(accumulator >> bits));
+			}
+		}
+		return bytes;
+	}
+
+	// The buffers[].uri strings of glTF JSON, found in one pass without building a JsonValue of the whole document
+	std::vector<std::string> scanBufferUris(const std::string& json)
+	{
+		std::vector<std::string> uris;
+		// Open objects and arrays, each with the key it is the value of
+		std::vector<std::pair<char, std::string>> scopes;
+		std::string lastString;
+		std::string key;
+		bool afterColon = false;
+		for (size_t i = 0; i < json.size(); i++) {
+			const char c = json[i];
+			if (c == '"') {
+				std::string value;
+				for (i++; i < json.size() && json[i] != '"'; i++) {
+					// Keeps the escaped character, \u escapes are not decoded
+					if (json[i] == '\\' && i + 1 < json.size()) {
+						i++;
+					}
+					value += json[i];
+				}
+				const bool inBuffer = scopes.size() == 3 && scopes[1].first == '[' && scopes[1].second == "buffers";
+				if (afterColon && key == "uri" && inBuffer) {
+					uris.push_back(std::move(value));
+				}
+				else if (!afterColon) {
+					lastString = std::move(value);
+				}
+				afterColon = false;
+			}
+			else if (c == ':') {
+				key = lastString;
+				afterColon = true;
+			}
+			else if (c == '{' || c == '[') {
+				scopes.emplace_back(c, afterColon ? key : std::string{});
+				afterColon = false;
+			}
+			else if (c == '}' || c == ']') {
+				if (!scopes.empty()) {
+					scopes.pop_back();
+				}
+			}
+			else if (c == ',') {
+				afterColon = false;
+			}
+		}
+		return uris;
+	}
+
+	class GltfReader
+	{
+	public:
+		GltfReader(const std::string& path) : m_Path(path)
+		{
+			const std::string file = readFile(path);
+			std::vector<uint8_t> glbBinary;
+			if (file.size() >= 12 && readUnaligned<uint32_t>(reinterpret_cast<const uint8_t*>(file.data())) == GLB_MAGIC) {
+				m_Document = m_ParseGlb(file, glbBinary);
+			}
+			else {
+				m_Document = JsonValue::parse(file);
+			}
+
+			if (m_Document.has("buffers")) {
+				for (const JsonValue& buffer : m_Document["buffers"].asArray()) {
+					m_Buffers.push_back(m_LoadBuffer(buffer, glbBinary));
+				}
+			}
+		}
+
+		Model::Builder build()
+		{
+			Model::Builder builder{};
+			if (!m_Document.has("meshes")) {
+				return builder;
+			}
+
+			for (const JsonValue& mesh : m_Document["meshes"].asArray()) {
+				for (const JsonValue& primitive : mesh["primitives"].asArray()) {
+					if (primitive.getUint("mode", GLTF_MODE_TRIANGLES) != GLTF_MODE_TRIANGLES) {
+						continue;
+					}
+					m_AppendPrimitive(primitive, builder);
+				}
+			}
+			return builder;
+		}
+
+	private:
+		std::string m_Path;
+		JsonValue m_Document;
+		std::vector<std::vector<uint8_t>> m_Buffers;
+
+		JsonValue m_ParseGlb(const std::string& file, std::vector<uint8_t>& binary)
+		{
+			const uint8_t* data = reinterpret_cast<const uint8_t*>(file.data());
+			const uint32_t length = std::min<uint32_t>(readUnaligned<uint32_t>(data + 8), static_cast<uint32_t>(file.size()));
+
+			std::string json;
+			for (size_t offset = 12; offset + 8 <= length;) {
+				const uint32_t chunkLength = readUnaligned<uint32_t>(data + offset);
+				const uint32_t chunkType = readUnaligned<uint32_t>(data + offset + 4);
+				offset += 8;
+				if (offset + chunkLength > length) {
+					throw std::runtime_error("truncated GLB chunk in " + m_Path);
+				}
+				if (chunkType == GLB_CHUNK_JSON) {
+					json.assign(file, offset, chunkLength);
+				}
+				else if (chunkType == GLB_CHUNK_BIN && binary.empty()) {
+					binary.assign(data + offset, data + offset + chunkLength);
+				}
+				offset += chunkLength;
+			}
+
+			if (json.empty()) {
+				throw std::runtime_error("GLB has no JSON chunk: " + m_Path);
+			}
+			return JsonValue::parse(json);
+		}
+
+		std::vector<uint8_t> m_LoadBuffer(const JsonValue& buffer, const std::vector<uint8_t>& glbBinary)
+		{
+			// A buffer without a uri is the GLB binary chunk
+			if (!buffer.has("uri")) {
+				return glbBinary;
+			}
+
+			const std::string& uri = buffer["uri"].asString();
+			if (uri.compare(0, 5, "data:") == 0) {
+				const size_t comma = uri.find(',');
+				if (comma == std::string::npos || uri.rfind(";base64", comma) == std::string::npos) {
+					throw std::runtime_error("unsupported data uri in " + m_Path);
+				}
+				return decodeBase64(uri, comma + 1);
+			}
+
+			const std::string contents = readFile(directoryOf(m_Path) + uri);
+			return std::vector<uint8_t>(contents.begin(), contents.end());
+		}
+
+		static uint32_t m_ComponentCount(const std::string& type)
+		{
+			if (type == "SCALAR") return 1;
+			if (type == "VEC2") return 2;
+			if (type == "VEC3") return 3;
+			if (type == "VEC4") return 4;
+			throw std::runtime_error("unsupported glTF accessor type: " + type);
+		}
+
+		static uint32_t m_ComponentSize(uint32_t componentType)
+		{
+			switch (componentType) {
+			case GLTF_BYTE:
+			case GLTF_UNSIGNED_BYTE: return 1;
+			case GLTF_SHORT:
+			case GLTF_UNSIGNED_SHORT: return 2;
+			case GLTF_UNSIGNED_INT:
+			case GLTF_FLOAT: return 4;
+			default: throw std::runtime_error("unsupported glTF component type");
+			}
+		}
+
+		// Reads an accessor as floats, components per element given by its type.
+		// Normalized integers are mapped to [0, 1] or [-1, 1] as the spec describes
+		std::vector<float> m_ReadFloats(uint32_t accessorIndex, uint32_t& components)
+		{
+			const JsonValue& accessor = m_Document["accessors"][accessorIndex];
+			const uint32_t componentType = accessor["componentType"].asUint();
+			const bool normalized = accessor.has("normalized") && accessor["normalized"].asBool();
+			components = m_ComponentCount(accessor["type"].asString());
+
+			std::vector<float> values;
+			m_ForEachElement(accessor, components, [&](const uint8_t* element) {
+				for (uint32_t c = 0; c < components; c++) {
+					const uint8_t* component = element + c * m_ComponentSize(componentType);
+					float value = 0.0f;
+					switch (componentType) {
+					case GLTF_FLOAT: value = readUnaligned<float>(component); break;
+					case GLTF_UNSIGNED_BYTE: value = *component / (normalized ? 255.0f : 1.0f); break;
+					case GLTF_UNSIGNED_SHORT: value = readUnaligned<uint16_t>(component) / (normalized ? 65535.0f : 1.0f); break;
+					case GLTF_BYTE: value = std::max(static_cast<int8_t>(*component) / (normalized ? 127.0f : 1.0f), -1.0f); break;
+					case GLTF_SHORT: value = std::max(readUnaligned<int16_t>(component) / (normalized ? 32767.0f : 1.0f), -1.0f); break;
+					default: throw std::runtime_error("unsupported glTF vertex component type in " + m_Path);
+					}
+					values.push_back(value);
+				}
+			});
+			return values;
+		}
+
+		std::vector<uint32_t> m_ReadIndices(uint32_t accessorIndex)
+		{
+			const JsonValue& accessor = m_Document["accessors"][accessorIndex];
+			const uint32_t componentType = accessor["componentType"].asUint();
+
+			std::vector<uint32_t> indices;
+			m_ForEachElement(accessor, 1, [&](const uint8_t* element) {
+				switch (componentType) {
+				case GLTF_UNSIGNED_BYTE: indices.push_back(*element); break;
+				case GLTF_UNSIGNED_SHORT: indices.push_back(readUnaligned<uint16_t>(element)); break;
+				case GLTF_UNSIGNED_INT: indices.push_back(readUnaligned<uint32_t>(element)); break;
+				default: throw std::runtime_error("unsupported glTF index type in " + m_Path);
+				}
+			});
+			return indices;
+		}
+
+		template <typename Func>
+		void m_ForEachElement(const JsonValue& accessor, uint32_t components, Func&& func)
+		{
+			if (accessor.has("sparse") || !accessor.has("bufferView")) {
+				throw std::runtime_error("sparse and bufferless glTF accessors are not supported: " + m_Path);
+			}
+
+			const JsonValue& view = m_Document["bufferViews"][accessor["bufferView"].asUint()];
+			const std::vector<uint8_t>& buffer = m_Buffers.at(view["buffer"].asUint());
+			const size_t elementSize = m_ComponentSize(accessor["componentType"].asUint()) * components;
+			const size_t stride = view.getUint("byteStride", 0) != 0 ? view.getUint("byteStride", 0) : elementSize;
+			const size_t begin = static_cast<size_t>(view.getUint("byteOffset", 0)) + accessor.getUint("byteOffset", 0);
+			const size_t viewEnd = static_cast<size_t>(view.getUint("byteOffset", 0)) + view["byteLength"].asUint();
+			const uint32_t count = accessor["count"].asUint();
+
+			if (count > 0 && (viewEnd > buffer.size() || begin + (count - 1) * stride + elementSize > viewEnd)) {
+				throw std::runtime_error("glTF accessor reads past the end of its buffer view: " + m_Path);
+			}
+			for (uint32_t i = 0; i < count; i++) {
+				func(buffer.data() + begin + i * stride);
+			}
+		}
+
+		void m_AppendPrimitive(const JsonValue& primitive, Model::Builder& builder)
+		{
+			const JsonValue& attributes = primitive["attributes"];
+			uint32_t positionComponents = 0;
+			const std::vector<float> positions = m_ReadFloats(attributes["POSITION"].asUint(), positionComponents);
+			if (positionComponents != 2 && positionComponents != 3) {
+				throw std::runtime_error("glTF POSITION must be VEC2 or VEC3 in " + m_Path);
+			}
+			const size_t vertexCount = positions.size() / positionComponents;
+
+			uint32_t colourComponents = 0;
+			std::vector<float> colours;
+			if (attributes.has("COLOR_0")) {
+				colours = m_ReadFloats(attributes["COLOR_0"].asUint(), colourComponents);
+				if (colourComponents != 3 && colourComponents != 4) {
+					throw std::runtime_error("glTF COLOR_0 must be VEC3 or VEC4 in " + m_Path);
+				}
+				if (colours.size() / colourComponents < vertexCount) {
+					throw std::runtime_error("glTF COLOR_0 has fewer elements than POSITION in " + m_Path);
+				}
+			}
+
+			const uint32_t baseVertex = static_cast<uint32_t>(builder.vertices.size());
+			builder.vertices.reserve(builder.vertices.size() + vertexCount);
+			for (size_t i = 0; i < vertexCount; i++) {
+				Model::Vertex vertex{};
+				vertex.position = { positions[i * positionComponents], positions[i * positionComponents + 1] };
+				vertex.colour = colours.empty() ? DEFAULT_COLOUR :
+					glm::vec3{ colours[i * colourComponents], colours[i * colourComponents + 1], colours[i * colourComponents + 2] };
+				builder.vertices.push_back(vertex);
+			}
+
+			if (primitive.has("indices")) {
+				for (uint32_t index : m_ReadIndices(primitive["indices"].asUint())) {
+					if (index >= vertexCount) {
+						throw std::runtime_error("glTF index out of range in " + m_Path);
+					}
+					builder.indices.push_back(baseVertex + index);
+				}
+			}
+			else {
+				for (size_t i = 0; i < vertexCount; i++) {
+					builder.indices.push_back(baseVertex + static_cast<uint32_t>(i));
+				}
+			}
+		}
+	};
+}
+
+Model::Builder MeshLoader::load(const std::string& path)
+{
+	const std::string extension = extensionOf(path);
+	if (extension == "obj") {
+		return loadObj(path);
+	}
+	if (extension == "gltf" || extension == "glb") {
+		return loadGltf(path);
+	}
+	throw std::runtime_error("unsupported mesh format: " + path);
+}
+
+std::vector<std::string> MeshLoader::dependencies(const std::string& path)
+{
+	// A .glb keeps its buffer in the BIN chunk, and OBJ has no buffers
+	if (extensionOf(path) != "gltf") {
+		return {};
+	}
+
+	std::vector<std::string> files;
+	for (const std::string& uri : scanBufferUris(readFile(path))) {
+		if (uri.compare(0, 5, "data:") != 0) {
+			files.push_back(directoryOf(path) + uri);
+		}
+	}
+	return files;
+}
+
+Model::Builder MeshLoader::loadObj(const std::string& path)
+{
+	PROFILE_FUNCTION();
+	std::ifstream file{ path };
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to open file: " + path);
+	}
+
+	std::vector<Model::Vertex> positions;
+	std::vector<uint32_t> face;
+	Model::Builder builder{};
+
+	std::string line;
+	while (std::getline(file, line)) {
+		std::istringstream tokens{ line };
+		std::string keyword;
+		tokens >> keyword;
+
+		if (keyword == "v") {
+			Model::Vertex vertex{};
+			float z = 0.0f;
+			tokens >> vertex.position.x >> vertex.position.y >> z;
+			// Colours after the position are a common extension, white when missing
+			if (!(tokens >> vertex.colour.r >> vertex.colour.g >> vertex.colour.b)) {
+				vertex.colour = DEFAULT_COLOUR;
+			}
+			positions.push_back(vertex);
+		}
+		else if (keyword == "f") {
+			// Each corner is v, v/vt, v//vn or v/vt/vn, only the position matters here
+			face.clear();
+			std::string corner;
+			while (tokens >> corner) {
+				face.push_back(resolveObjIndex(std::strtol(corner.c_str(), nullptr, 10), positions.size(), path));
+			}
+			for (size_t i = 2; i < face.size(); i++) {
+				builder.addVertex(positions[face[0]]);
+				builder.addVertex(positions[face[i - 1]]);
+				builder.addVertex(positions[face[i]]);
+			}
+		}
+	}
+
+	return builder;
+}
+
+Model::Builder MeshLoader::loadGltf(const std::string& path)
+{
+	PROFILE_FUNCTION();
+	return GltfReader{ path }.build();
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Model.h"
+
+#include <string>
+#include <vector>
+
+// Reads mesh files into a Model::Builder without touching the device, so it is safe on any thread.
+// The renderer is 2D: only x and y of each position are kept and z is dropped.
+namespace MeshLoader
+{
+	// Picks the format from the extension: .obj, .gltf or .glb
+	Model::Builder load(const std::string& path);
+	// Other files load reads for path, the external buffers of a glTF. Empty for OBJ
+	std::vector<std::string> dependencies(const std::string& path);
+
+	// Wavefront OBJ: v with optional vertex colours and polygonal f, fan triangulated
+	Model::Builder loadObj(const std::string& path);
+	// glTF 2.0, as JSON with external or embedded base64 buffers or as a binary .glb.
+	// Every triangle primitive of every mesh is merged, node transforms are not applied
+	Model::Builder loadGltf(const std::string& path);
+}
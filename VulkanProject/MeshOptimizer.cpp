@@ -0,0 +1,288 @@
+#include "MeshOptimizer.h"
+
+#include "Profiler.h"
+#include "VertexLayout.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+	constexpr size_t FETCH_LINE_SIZE = 64;
+	constexpr uint32_t FETCH_CACHE_LINES = 64;		// 4KB, roughly a vertex fetch L1
+	constexpr uint32_t OVERDRAW_RESOLUTION = 256;
+
+	// Sorted list of triangles around each vertex
+	struct Adjacency {
+		std::vector<uint32_t> offsets;		// vertexCount + 1 entries
+		std::vector<uint32_t> triangles;
+
+		Adjacency(const std::vector<uint32_t>& indices, size_t vertexCount) : offsets(vertexCount + 1, 0), triangles(indices.size())
+		{
+			for (uint32_t index : indices) {
+				offsets[index + 1]++;
+			}
+			for (size_t v = 0; v < vertexCount; v++) {
+				offsets[v + 1] += offsets[v];
+			}
+
+			std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); i++) {
+				triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+	};
+
+	float edge(glm::vec2 a, glm::vec2 b, glm::vec2 p)
+	{
+		return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+	}
+
+	// Fill rule for samples exactly on an edge, so a pixel on an edge shared by two triangles counts once
+	bool covers(glm::vec2 a, glm::vec2 b, glm::vec2 p)
+	{
+		const float value = edge(a, b, p);
+		return value > 0.0f || (value == 0.0f && (a.y > b.y || (a.y == b.y && a.x < b.x)));
+	}
+}
+
+void MeshOptimizer::analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, Stats& stats, uint32_t cacheSize)
+{
+	// A vertex is in the FIFO when fewer than cacheSize misses happened since it was last loaded
+	std::vector<uint32_t> loadedAt(vertexCount, 0);
+	std::vector<bool> referenced(vertexCount, false);
+	uint32_t misses = 0;
+	size_t uniqueVertices = 0;
+
+	for (uint32_t index : indices) {
+		if (!referenced[index]) {
+			referenced[index] = true;
+			uniqueVertices++;
+		}
+		if (loadedAt[index] == 0 || misses - loadedAt[index] >= cacheSize) {
+			misses++;
+			loadedAt[index] = misses;
+		}
+	}
+
+	const size_t triangleCount = indices.size() / 3;
+	stats.acmr = triangleCount > 0 ? float(misses) / triangleCount : 0.0f;
+	stats.atvr = uniqueVertices > 0 ? float(misses) / uniqueVertices : 0.0f;
+}
+
+void MeshOptimizer::analyzeVertexFetch(const std::vector<uint32_t>& indices, size_t vertexCount, size_t vertexStride, Stats& stats)
+{
+	std::vector<uint32_t> transformedAt(vertexCount, 0);
+	std::vector<bool> referenced(vertexCount, false);
+	uint32_t transforms = 0;
+	size_t uniqueVertices = 0;
+
+	// Same FIFO scheme for cache lines, only vertices missing the post-transform cache are fetched
+	const size_t lineCount = (vertexCount * vertexStride + FETCH_LINE_SIZE - 1) / FETCH_LINE_SIZE;
+	std::vector<uint32_t> lineLoadedAt(lineCount, 0);
+	uint32_t lineLoads = 0;
+
+	for (uint32_t index : indices) {
+		if (!referenced[index]) {
+			referenced[index] = true;
+			uniqueVertices++;
+		}
+		if (transformedAt[index] != 0 && transforms - transformedAt[index] < DEFAULT_CACHE_SIZE) {
+			continue;
+		}
+		transformedAt[index] = ++transforms;
+
+		const size_t firstLine = index * vertexStride / FETCH_LINE_SIZE;
+		const size_t lastLine = ((index + 1) * vertexStride - 1) / FETCH_LINE_SIZE;
+		for (size_t line = firstLine; line <= lastLine; line++) {
+			if (lineLoadedAt[line] == 0 || lineLoads - lineLoadedAt[line] >= FETCH_CACHE_LINES) {
+				lineLoadedAt[line] = ++lineLoads;
+			}
+		}
+	}
+
+	stats.overfetch = uniqueVertices > 0 ? float(lineLoads) * FETCH_LINE_SIZE / (uniqueVertices * vertexStride) : 0.0f;
+}
+
+void MeshOptimizer::analyzeOverdraw(const Model::Builder& builder, Stats& stats)
+{
+	glm::vec2 boundsMin{ std::numeric_limits<float>::max() };
+	glm::vec2 boundsMax{ std::numeric_limits<float>::lowest() };
+	for (const auto& vertex : builder.vertices) {
+		boundsMin = glm::min(boundsMin, vertex.position);
+		boundsMax = glm::max(boundsMax, vertex.position);
+	}
+	const glm::vec2 extent = glm::max(boundsMax - boundsMin, glm::vec2{ 1e-6f });
+	const glm::vec2 toPixels = glm::vec2{ float(OVERDRAW_RESOLUTION) } / extent;
+
+	std::vector<uint32_t> fragments(OVERDRAW_RESOLUTION * OVERDRAW_RESOLUTION, 0);
+	for (size_t i = 0; i + 2 < builder.indices.size(); i += 3) {
+		glm::vec2 a = (builder.vertices[builder.indices[i]].position - boundsMin) * toPixels;
+		glm::vec2 b = (builder.vertices[builder.indices[i + 1]].position - boundsMin) * toPixels;
+		glm::vec2 c = (builder.vertices[builder.indices[i + 2]].position - boundsMin) * toPixels;
+		// Culling is off, so either winding is drawn
+		if (edge(a, b, c) < 0.0f) {
+			std::swap(b, c);
+		}
+
+		const int minX = std::max(int(std::min({ a.x, b.x, c.x })), 0);
+		const int minY = std::max(int(std::min({ a.y, b.y, c.y })), 0);
+		const int maxX = std::min(int(std::max({ a.x, b.x, c.x })), int(OVERDRAW_RESOLUTION) - 1);
+		const int maxY = std::min(int(std::max({ a.y, b.y, c.y })), int(OVERDRAW_RESOLUTION) - 1);
+		for (int y = minY; y <= maxY; y++) {
+			for (int x = minX; x <= maxX; x++) {
+				const glm::vec2 centre{ x + 0.5f, y + 0.5f };
+				if (covers(a, b, centre) && covers(b, c, centre) && covers(c, a, centre)) {
+					fragments[y * OVERDRAW_RESOLUTION + x]++;
+				}
+			}
+		}
+	}
+
+	size_t shaded = 0;
+	size_t covered = 0;
+	for (uint32_t count : fragments) {
+		shaded += count;
+		covered += count > 0 ? 1 : 0;
+	}
+	stats.overdraw = covered > 0 ? float(shaded) / covered : 0.0f;
+}
+
+MeshOptimizer::Stats MeshOptimizer::analyze(const Model::Builder& builder)
+{
+	if (builder.lods.size() > 1) {
+		Model::Builder full{};
+		full.vertices = builder.vertices;
+		full.indices.assign(builder.indices.begin(), builder.indices.begin() + builder.lods[0].indexCount);
+		return analyze(full);
+	}
+
+	Stats stats{};
+	analyzeVertexCache(builder.indices, builder.vertices.size(), stats);
+	analyzeVertexFetch(builder.indices, builder.vertices.size(), VertexLayout::active().stride(), stats);
+	analyzeOverdraw(builder, stats);
+	return stats;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+	PROFILE_FUNCTION();
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	const Adjacency adjacency{ indices, vertexCount };
+	std::vector<uint32_t> liveTriangles(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) {
+		liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+	}
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+
+	uint32_t time = cacheSize + 1;
+	size_t scanCursor = 0;
+	int64_t fanning = indices[0];
+
+	// Fallback when no candidate is left: a recently touched vertex first, then the next unfinished one in order
+	auto skipDeadEnd = [&]() -> int64_t {
+		while (!deadEnds.empty()) {
+			const uint32_t vertex = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[vertex] > 0) {
+				return vertex;
+			}
+		}
+		for (; scanCursor < vertexCount; scanCursor++) {
+			if (liveTriangles[scanCursor] > 0) {
+				return static_cast<int64_t>(scanCursor);
+			}
+		}
+		return -1;
+	};
+
+	while (fanning >= 0) {
+		candidates.clear();
+		for (uint32_t a = adjacency.offsets[fanning]; a < adjacency.offsets[fanning + 1]; a++) {
+			const uint32_t triangle = adjacency.triangles[a];
+			if (emitted[triangle]) {
+				continue;
+			}
+			emitted[triangle] = true;
+
+			for (uint32_t corner = 0; corner < 3; corner++) {
+				const uint32_t vertex = indices[triangle * 3 + corner];
+				output.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				liveTriangles[vertex]--;
+				if (time - cacheTime[vertex] > cacheSize) {
+					cacheTime[vertex] = time++;
+				}
+			}
+		}
+
+		// Prefer the candidate that entered the cache longest ago but will still be in it after fanning its remaining triangles
+		int64_t best = -1;
+		int64_t bestPriority = -1;
+		for (uint32_t vertex : candidates) {
+			if (liveTriangles[vertex] == 0) {
+				continue;
+			}
+			int64_t priority = 0;
+			if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize) {
+				priority = time - cacheTime[vertex];
+			}
+			if (priority > bestPriority) {
+				best = vertex;
+				bestPriority = priority;
+			}
+		}
+		fanning = best >= 0 ? best : skipDeadEnd();
+	}
+
+	indices.swap(output);
+}
+
+void MeshOptimizer::optimizeVertexFetch(Model::Builder& builder)
+{
+	PROFILE_FUNCTION();
+	std::vector<uint32_t> remap(builder.vertices.size(), UINT32_MAX);
+	Model::Builder reordered{};
+	reordered.vertices.reserve(builder.vertices.size());
+	reordered.indices.reserve(builder.indices.size());
+
+	for (uint32_t index : builder.indices) {
+		if (remap[index] == UINT32_MAX) {
+			remap[index] = static_cast<uint32_t>(reordered.vertices.size());
+			reordered.vertices.push_back(builder.vertices[index]);
+		}
+		reordered.indices.push_back(remap[index]);
+	}
+
+	// A fresh builder, the old one's deduplication map would point at the previous numbering
+	reordered.lods = std::move(builder.lods);
+	builder = std::move(reordered);
+}
+
+void MeshOptimizer::optimize(Model::Builder& builder)
+{
+	if (builder.lods.empty()) {
+		optimizeVertexCache(builder.indices, builder.vertices.size());
+	}
+	else {
+		// Each level is drawn on its own, so each gets its own triangle order
+		std::vector<uint32_t> range;
+		for (const auto& lod : builder.lods) {
+			auto first = builder.indices.begin() + lod.firstIndex;
+			range.assign(first, first + lod.indexCount);
+			optimizeVertexCache(range, builder.vertices.size());
+			std::copy(range.begin(), range.end(), first);
+		}
+	}
+	optimizeVertexFetch(builder);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Model.h"
+
+#include <cstdint>
+#include <vector>
+
+// Load-time reordering of indexed meshes for the GPU's vertex caches, run before a Builder becomes a Model
+namespace MeshOptimizer
+{
+	// Post-transform cache entries assumed by the analysis and by Tipsify, typical of current GPUs
+	constexpr uint32_t DEFAULT_CACHE_SIZE = 16;
+
+	struct Stats {
+		float acmr = 0.0f;			// Average cache miss ratio: vertex shader runs per triangle, 0.5 at best, 3 at worst
+		float atvr = 0.0f;			// Average transform to vertex ratio: shader runs per referenced vertex, 1 at best
+		float overfetch = 0.0f;		// Vertex bytes read from memory over the size of the referenced vertices, 1 at best
+		float overdraw = 0.0f;		// Fragments shaded per covered pixel when the mesh fills a 256x256 target
+	};
+
+	// FIFO cache simulation over the index buffer
+	void analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, Stats& stats, uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+	// 64-byte line cache simulation over the vertex fetches that miss the post-transform cache
+	void analyzeVertexFetch(const std::vector<uint32_t>& indices, size_t vertexCount, size_t vertexStride, Stats& stats);
+	// Software rasterization of the mesh over its bounds. All geometry sits at z = 0, so with the pipeline's LESS depth
+	// test only the first fragment at each pixel passes and the count measures shading cost under the real pipeline.
+	// Reordering for it would change which overlapping triangle is kept, so it is reported for information only
+	void analyzeOverdraw(const Model::Builder& builder, Stats& stats);
+	// All of the above for the full mesh (LOD 0), vertex stride taken from the active VertexLayout
+	Stats analyze(const Model::Builder& builder);
+
+	// Tipsify (Sander, Nehab and Barczak 2007): fans around recently used vertices and jumps to the vertex most likely
+	// still in the cache. Linear time, ACMR usually within a few percent of much slower optimizers
+	void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+	// Renumbers vertices in first use order so consecutive fetches share cache lines, drops unreferenced vertices.
+	// LOD ranges are kept, LOD 0 comes first so the coarser levels read from the front of the vertex buffer
+	void optimizeVertexFetch(Model::Builder& builder);
+	// Vertex cache order within each LOD, then vertex fetch order
+	void optimize(Model::Builder& builder);
+}
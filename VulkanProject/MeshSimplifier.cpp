@@ -0,0 +1,276 @@
+#include "MeshSimplifier.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+namespace
+{
+	// A level removing less than this share of the triangles is not worth a draw of its own
+	constexpr float MIN_LOD_REDUCTION = 0.9f;
+
+	// Sum of squared distances to a set of lines, a x^2 + 2b xy + c y^2 + 2d x + 2e y + f
+	struct Quadric {
+		double a = 0.0, b = 0.0, c = 0.0, d = 0.0, e = 0.0, f = 0.0;
+
+		void addLine(glm::vec2 start, glm::vec2 end)
+		{
+			const glm::dvec2 direction = glm::dvec2(end) - glm::dvec2(start);
+			const double length = glm::length(direction);
+			if (length <= 0.0) {
+				return;
+			}
+			const glm::dvec2 normal{ -direction.y / length, direction.x / length };
+			const double offset = -glm::dot(normal, glm::dvec2(start));
+			a += normal.x * normal.x;
+			b += normal.x * normal.y;
+			c += normal.y * normal.y;
+			d += normal.x * offset;
+			e += normal.y * offset;
+			f += offset * offset;
+		}
+
+		double evaluate(glm::vec2 point) const
+		{
+			const double x = point.x;
+			const double y = point.y;
+			// Rounding can take a zero error slightly negative
+			return std::max(a * x * x + 2.0 * b * x * y + c * y * y + 2.0 * d * x + 2.0 * e * y + f, 0.0);
+		}
+
+		Quadric& operator+=(const Quadric& other)
+		{
+			a += other.a;
+			b += other.b;
+			c += other.c;
+			d += other.d;
+			e += other.e;
+			f += other.f;
+			return *this;
+		}
+	};
+
+	struct Collapse {
+		uint32_t from;
+		uint32_t to;
+		double cost;
+	};
+
+	uint64_t edgeKey(uint32_t a, uint32_t b)
+	{
+		return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+	}
+
+	float signedArea(glm::vec2 a, glm::vec2 b, glm::vec2 c)
+	{
+		return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	}
+}
+
+std::vector<uint32_t> MeshSimplifier::simplify(const std::vector<Model::Vertex>& vertices, const uint32_t* indices, size_t indexCount,
+	size_t targetIndexCount, float maxError, float& resultError)
+{
+	PROFILE_FUNCTION();
+	std::vector<uint32_t> result(indices, indices + indexCount - indexCount % 3);
+	resultError = 0.0f;
+	const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+
+	// Vertices sharing a position sit on a seam between colours, moving one of them would tear the mesh open
+	std::vector<bool> locked(vertexCount, false);
+	{
+		std::unordered_map<uint64_t, uint32_t> firstAtPosition;
+		for (uint32_t v = 0; v < vertexCount; v++) {
+			uint32_t x, y;
+			std::memcpy(&x, &vertices[v].position.x, sizeof(x));
+			std::memcpy(&y, &vertices[v].position.y, sizeof(y));
+			const auto inserted = firstAtPosition.emplace((uint64_t(x) << 32) | y, v);
+			if (!inserted.second) {
+				locked[v] = true;
+				locked[inserted.first->second] = true;
+			}
+		}
+	}
+
+	// Edges used by a single triangle form the outline, each one adds its line to both ends
+	std::vector<Quadric> quadrics(vertexCount);
+	{
+		std::unordered_map<uint64_t, uint32_t> edgeUses;
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (size_t k = 0; k < 3; k++) {
+				edgeUses[edgeKey(result[i + k], result[i + (k + 1) % 3])]++;
+			}
+		}
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (size_t k = 0; k < 3; k++) {
+				const uint32_t a = result[i + k];
+				const uint32_t b = result[i + (k + 1) % 3];
+				const uint32_t uses = edgeUses[edgeKey(a, b)];
+				if (uses == 1) {
+					Quadric line;
+					line.addLine(vertices[a].position, vertices[b].position);
+					quadrics[a] += line;
+					quadrics[b] += line;
+				}
+				else if (uses > 2) {
+					locked[a] = true;
+					locked[b] = true;
+				}
+			}
+		}
+	}
+
+	const size_t targetTriangles = targetIndexCount / 3;
+	const double maxCost = double(maxError) * maxError;
+	size_t triangleCount = result.size() / 3;
+	std::vector<uint32_t> adjacencyOffsets;
+	std::vector<uint32_t> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+
+	// Each pass makes the cheapest collapses whose neighbourhoods do not overlap, so the checks stay valid within it
+	while (triangleCount > targetTriangles) {
+		adjacencyOffsets.assign(vertexCount + 1, 0);
+		for (uint32_t index : result) {
+			adjacencyOffsets[index + 1]++;
+		}
+		for (uint32_t v = 0; v < vertexCount; v++) {
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		}
+		adjacency.resize(result.size());
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < result.size(); i++) {
+			adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		// Both directions of every edge, interior ones turn up twice which the touched check absorbs
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (size_t k = 0; k < 3; k++) {
+				const uint32_t a = result[i + k];
+				const uint32_t b = result[i + (k + 1) % 3];
+				const uint32_t ends[2][2] = { { a, b }, { b, a } };
+				for (const auto& end : ends) {
+					if (locked[end[0]]) {
+						continue;
+					}
+					Quadric merged = quadrics[end[0]];
+					merged += quadrics[end[1]];
+					const double cost = merged.evaluate(vertices[end[1]].position);
+					if (cost <= maxCost) {
+						collapses.push_back({ end[0], end[1], cost });
+					}
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		std::iota(remap.begin(), remap.end(), 0u);
+		std::fill(touched.begin(), touched.end(), false);
+		size_t removed = 0;
+		double passCost = 0.0;
+		double blockedCost = maxCost;
+		for (const Collapse& collapse : collapses) {
+			// A cheaper collapse waiting on a neighbour goes first next pass, rather than a costlier one here
+			if (triangleCount - removed <= targetTriangles || collapse.cost > blockedCost) {
+				break;
+			}
+			if (touched[collapse.from] || touched[collapse.to]) {
+				blockedCost = std::min(blockedCost, collapse.cost);
+				continue;
+			}
+
+			// Triangles sharing the edge disappear, the others must keep their winding once the vertex moves
+			bool valid = true;
+			size_t collapsed = 0;
+			for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && valid; a++) {
+				const uint32_t* triangle = &result[size_t(adjacency[a]) * 3];
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+					collapsed++;
+					continue;
+				}
+				glm::vec2 corners[3];
+				for (size_t k = 0; k < 3; k++) {
+					corners[k] = vertices[triangle[k]].position;
+				}
+				const float before = signedArea(corners[0], corners[1], corners[2]);
+				for (size_t k = 0; k < 3; k++) {
+					if (triangle[k] == collapse.from) {
+						corners[k] = vertices[collapse.to].position;
+					}
+				}
+				valid = before * signedArea(corners[0], corners[1], corners[2]) > 0.0f;
+			}
+			if (!valid) {
+				continue;
+			}
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to] += quadrics[collapse.from];
+			touched[collapse.to] = true;
+			for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++) {
+				const uint32_t* triangle = &result[size_t(adjacency[a]) * 3];
+				touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+			}
+			removed += collapsed;
+			passCost = std::max(passCost, collapse.cost);
+		}
+		if (removed == 0) {
+			break;
+		}
+
+		size_t write = 0;
+		for (size_t i = 0; i < result.size(); i += 3) {
+			const uint32_t a = remap[result[i]];
+			const uint32_t b = remap[result[i + 1]];
+			const uint32_t c = remap[result[i + 2]];
+			if (a != b && b != c && c != a) {
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+		}
+		result.resize(write);
+		triangleCount = result.size() / 3;
+		// Sums of squared distances, so the root bounds the largest single distance
+		resultError = std::max(resultError, static_cast<float>(std::sqrt(passCost)));
+	}
+
+	return result;
+}
+
+void MeshSimplifier::generateLods(Model::Builder& builder, uint32_t maxLods, float ratio, float maxRelativeError)
+{
+	PROFILE_FUNCTION();
+	builder.lods.clear();
+	const uint32_t fullIndexCount = static_cast<uint32_t>(builder.indices.size());
+	if (fullIndexCount == 0) {
+		return;
+	}
+	builder.lods.push_back({ 0, fullIndexCount, 0.0f });
+
+	float boundingRadius = 0.0f;
+	for (const auto& vertex : builder.vertices) {
+		boundingRadius = std::max(boundingRadius, glm::length(vertex.position));
+	}
+	const float maxError = boundingRadius * maxRelativeError;
+
+	while (builder.lods.size() < maxLods) {
+		const Model::Lod previous = builder.lods.back();
+		const size_t target = static_cast<size_t>(previous.indexCount * ratio) / 3 * 3;
+		// Always from the full mesh, simplifying the previous level would stack the errors of both
+		float error = 0.0f;
+		std::vector<uint32_t> lodIndices = simplify(builder.vertices, builder.indices.data(), fullIndexCount, target, maxError, error);
+		if (lodIndices.empty() || lodIndices.size() > previous.indexCount * MIN_LOD_REDUCTION) {
+			break;
+		}
+
+		// Selection relies on the errors growing along the chain
+		builder.lods.push_back({ static_cast<uint32_t>(builder.indices.size()), static_cast<uint32_t>(lodIndices.size()), std::max(error, previous.error) });
+		builder.indices.insert(builder.indices.end(), lodIndices.begin(), lodIndices.end());
+	}
+}
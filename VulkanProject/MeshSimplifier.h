@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Model.h"
+
+#include <cstdint>
+#include <vector>
+
+// Load-time LOD generation by edge collapse with quadric error metrics (Garland and Heckbert 1997), adapted to the
+// flat meshes this renderer draws: a vertex inside the mesh can slide anywhere without changing the silhouette, so the
+// only error terms are the distances to the boundary edges around each vertex. Collapses move a vertex onto one of its
+// neighbours and never create vertices, so every LOD is an index range over the original vertex buffer.
+namespace MeshSimplifier
+{
+	constexpr uint32_t DEFAULT_MAX_LODS = 4;
+	// Index count of each level relative to the one before
+	constexpr float DEFAULT_LOD_RATIO = 0.5f;
+	// Largest error allowed for any level, relative to the bounding radius
+	constexpr float DEFAULT_MAX_RELATIVE_ERROR = 0.05f;
+
+	// Collapses edges until at most targetIndexCount indices remain or the next collapse would move the boundary further
+	// than maxError. resultError receives the largest error of the collapses made, in model units
+	std::vector<uint32_t> simplify(const std::vector<Model::Vertex>& vertices, const uint32_t* indices, size_t indexCount,
+		size_t targetIndexCount, float maxError, float& resultError);
+
+	// Appends coarser levels of builder.indices to it and fills builder.lods, LOD 0 being the original indices.
+	// Stops early once a level would not remove at least a tenth of the triangles
+	void generateLods(Model::Builder& builder, uint32_t maxLods = DEFAULT_MAX_LODS, float ratio = DEFAULT_LOD_RATIO,
+		float maxRelativeError = DEFAULT_MAX_RELATIVE_ERROR);
+}
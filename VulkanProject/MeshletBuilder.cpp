@@ -0,0 +1,119 @@
+#include "MeshletBuilder.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	constexpr uint8_t NOT_IN_MESHLET = 0xFF;
+	// Cones wider than this, measured as the smallest dot product with the axis, cannot be culled from anywhere useful
+	constexpr float MIN_CONE_DOT = 0.1f;
+	// Cutoff of a meshlet that is never back facing
+	constexpr float NO_CONE = 2.0f;
+
+	void computeBounds(const Model::Builder& builder, Model::Meshlet& meshlet)
+	{
+		glm::vec2 boundsMin{ std::numeric_limits<float>::max() };
+		glm::vec2 boundsMax{ std::numeric_limits<float>::lowest() };
+		for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+			const glm::vec2 position = builder.vertices[builder.meshletVertices[meshlet.vertexOffset + i]].position;
+			boundsMin = glm::min(boundsMin, position);
+			boundsMax = glm::max(boundsMax, position);
+		}
+		meshlet.center = 0.5f * (boundsMin + boundsMax);
+		meshlet.radius = 0.0f;
+		for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+			const glm::vec2 position = builder.vertices[builder.meshletVertices[meshlet.vertexOffset + i]].position;
+			meshlet.radius = std::max(meshlet.radius, glm::length(position - meshlet.center));
+		}
+
+		// Positions are drawn as they are, y pointing down, so a positive signed area is clockwise on screen and front
+		// facing under Pipeline's VK_FRONT_FACE_CLOCKWISE. Its normal points at the viewer, -z in clip space.
+		// In 2D every normal is +z or -z, the cone only has an axis when the meshlet's winding is consistent
+		std::vector<float> normals;
+		normals.reserve(meshlet.triangleCount);
+		for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+			const uint32_t first = meshlet.firstIndex + t * 3;
+			const glm::vec2 a = builder.vertices[builder.indices[first]].position;
+			const glm::vec2 b = builder.vertices[builder.indices[first + 1]].position;
+			const glm::vec2 c = builder.vertices[builder.indices[first + 2]].position;
+			const float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+			if (area != 0.0f) {
+				normals.push_back(area > 0.0f ? -1.0f : 1.0f);
+			}
+		}
+
+		float axis = 0.0f;
+		for (float normal : normals) {
+			axis += normal;
+		}
+		meshlet.coneAxis = glm::vec3{ 0.0f, 0.0f, axis < 0.0f ? -1.0f : 1.0f };
+		meshlet.coneCutoff = NO_CONE;
+		if (axis != 0.0f) {
+			float minDot = 1.0f;
+			for (float normal : normals) {
+				minDot = std::min(minDot, normal * meshlet.coneAxis.z);
+			}
+			if (minDot > MIN_CONE_DOT) {
+				meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+			}
+		}
+	}
+}
+
+void MeshletBuilder::build(Model::Builder& builder)
+{
+	PROFILE_FUNCTION();
+	builder.meshlets.clear();
+	builder.meshletVertices.clear();
+	builder.meshletTriangles.clear();
+	const uint32_t indexCount = builder.lods.empty() ? static_cast<uint32_t>(builder.indices.size()) : builder.lods[0].indexCount;
+
+	std::vector<uint8_t> localIndices(builder.vertices.size(), NOT_IN_MESHLET);
+	Model::Meshlet meshlet{};
+
+	auto finishMeshlet = [&](uint32_t nextIndex) {
+		if (meshlet.triangleCount > 0) {
+			computeBounds(builder, meshlet);
+			builder.meshlets.push_back(meshlet);
+		}
+		for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+			localIndices[builder.meshletVertices[meshlet.vertexOffset + i]] = NOT_IN_MESHLET;
+		}
+		// The shaders read the local indices as 32-bit words
+		builder.meshletTriangles.resize((builder.meshletTriangles.size() + 3) & ~size_t(3), 0);
+
+		meshlet = Model::Meshlet{};
+		meshlet.firstIndex = nextIndex;
+		meshlet.vertexOffset = static_cast<uint32_t>(builder.meshletVertices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(builder.meshletTriangles.size());
+	};
+
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+		const uint32_t* triangle = &builder.indices[i];
+		uint32_t newVertices = 0;
+		for (uint32_t corner = 0; corner < 3; corner++) {
+			const bool repeated = (corner > 0 && triangle[corner] == triangle[0]) || (corner > 1 && triangle[corner] == triangle[1]);
+			newVertices += localIndices[triangle[corner]] == NOT_IN_MESHLET && !repeated ? 1 : 0;
+		}
+		// A triangle sharing nothing with the meshlet is where the optimizer jumped elsewhere, following it would stretch the bounds
+		const bool disconnected = newVertices == 3 && meshlet.vertexCount > 0;
+		if (meshlet.vertexCount + newVertices > Model::MAX_MESHLET_VERTICES || meshlet.triangleCount == Model::MAX_MESHLET_TRIANGLES || disconnected) {
+			finishMeshlet(i);
+		}
+
+		for (uint32_t corner = 0; corner < 3; corner++) {
+			uint8_t& local = localIndices[triangle[corner]];
+			if (local == NOT_IN_MESHLET) {
+				local = static_cast<uint8_t>(meshlet.vertexCount++);
+				builder.meshletVertices.push_back(triangle[corner]);
+			}
+			builder.meshletTriangles.push_back(local);
+		}
+		meshlet.triangleCount++;
+	}
+	finishMeshlet(indexCount);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "Model.h"
+
+// Splits LOD 0 of a Builder into meshlets for cluster culling, see Model::Meshlet.
+// Triangles are taken in index order, so run it after MeshOptimizer: the vertex cache order keeps each meshlet
+// compact, which tightens its bounds and lets it fill up to the triangle limit before running out of vertices.
+namespace MeshletBuilder
+{
+	// Fills builder.meshlets, meshletVertices and meshletTriangles, replacing any previous meshlets
+	void build(Model::Builder& builder);
+}
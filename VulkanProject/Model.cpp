@@ -1,16 +1,108 @@
 #include "Model.h"
 
+#include "VertexLayout.h"
+
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+static void hashCombine(size_t&) {}
+
+template <typename T, typename... Rest>
+static void hashCombine(size_t& seed, const T& value, const Rest&... rest)
+{
+	seed ^= std::hash<T>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	hashCombine(seed, rest...);
+}
 
-Model::Model(Device& device, std::vector<Vertex>& verticies) : m_Device( device )
+size_t Model::Vertex::Hash::operator()(const Vertex& vertex) const
 {
-	m_CreateVertexBuffer(verticies);
+	size_t seed = 0;
+	hashCombine(seed, vertex.position.x, vertex.position.y, vertex.colour.r, vertex.colour.g, vertex.colour.b);
+	return seed;
+}
+
+void Model::Builder::addVertex(const Vertex& vertex)
+{
+	auto it = m_UniqueVertices.find(vertex);
+	if (it == m_UniqueVertices.end()) {
+		it = m_UniqueVertices.emplace(vertex, static_cast<uint32_t>(vertices.size())).first;
+		vertices.push_back(vertex);
+	}
+	indices.push_back(it->second);
+}
+
+void Model::Builder::loadVertices(const std::vector<Vertex>& triangleList)
+{
+	vertices.clear();
+	indices.clear();
+	m_UniqueVertices.clear();
+
+	indices.reserve(triangleList.size());
+	for (const auto& vertex : triangleList) {
+		addVertex(vertex);
+	}
+}
+
+Model::Model(Device& device, const Builder& builder) : m_Device( device )
+{
+	for (const auto& vertex : builder.vertices) {
+		m_BoundingRadius = std::max(m_BoundingRadius, glm::length(vertex.position));
+	}
+
+	const VertexLayout& layout = VertexLayout::active();
+	m_PositionScale = layout.positionScale(builder.vertices.data(), builder.vertices.size());
+	std::vector<uint8_t> packedVertices(size_t(layout.stride()) * builder.vertices.size());
+	layout.pack(builder.vertices.data(), builder.vertices.size(), m_PositionScale, packedVertices.data());
+	m_CreateVertexBuffer(packedVertices.data(), static_cast<uint32_t>(builder.vertices.size()), !builder.meshlets.empty());
+
+	// Half the index bandwidth whenever every index fits in 16 bits
+	if (builder.vertices.size() <= std::numeric_limits<uint16_t>::max()) {
+		std::vector<uint16_t> shortIndices(builder.indices.begin(), builder.indices.end());
+		m_CreateIndexBuffer(shortIndices.data(), static_cast<uint32_t>(shortIndices.size()), VK_INDEX_TYPE_UINT16);
+	}
+	else {
+		m_CreateIndexBuffer(builder.indices.data(), static_cast<uint32_t>(builder.indices.size()), VK_INDEX_TYPE_UINT32);
+	}
+	m_SetLods(builder.lods.data(), static_cast<uint32_t>(builder.lods.size()));
+	m_CreateMeshletBuffers(builder.meshlets.data(), static_cast<uint32_t>(builder.meshlets.size()),
+		builder.meshletVertices.data(), static_cast<uint32_t>(builder.meshletVertices.size()),
+		builder.meshletTriangles.data(), static_cast<uint32_t>(builder.meshletTriangles.size()));
+}
+
+Model::Model(Device& device, const MeshView& mesh)
+	: m_Device( device ), m_BoundingRadius( mesh.boundingRadius ), m_PositionScale( mesh.positionScale )
+{
+	const uint32_t meshletCount = mesh.meshlets ? mesh.meshletCount : 0;
+	m_CreateVertexBuffer(mesh.vertices, mesh.vertexCount, meshletCount > 0);
+	m_CreateIndexBuffer(mesh.indices, mesh.indices ? mesh.indexCount : 0, mesh.indexType);
+	m_SetLods(mesh.lods, mesh.lods ? mesh.lodCount : 0);
+	m_CreateMeshletBuffers(mesh.meshlets, meshletCount, mesh.meshletVertices, mesh.meshletVertexCount,
+		mesh.meshletTriangles, mesh.meshletTriangleBytes);
 }
 
 Model::~Model()
 {
-	vkDestroyBuffer(m_Device.device(), m_VertexBuffer, nullptr);
-	vkFreeMemory(m_Device.device(), m_VertexBufferMemory, nullptr);
+	// Frames in flight may still be drawing this model
+	m_Device.deferDestroyBuffer(m_VertexBuffer, m_VertexAllocation);
+	if (m_HasIndexBuffer) {
+		m_Device.deferDestroyBuffer(m_IndexBuffer, m_IndexAllocation);
+	}
+	if (hasMeshlets()) {
+		m_Device.deferDestroyBuffer(m_MeshletBuffer, m_MeshletAllocation);
+		m_Device.deferDestroyBuffer(m_MeshletVertexBuffer, m_MeshletVertexAllocation);
+		m_Device.deferDestroyBuffer(m_MeshletTriangleBuffer, m_MeshletTriangleAllocation);
+	}
+}
+
+bool Model::isPending()
+{
+	if (m_UploadTicket != 0 && m_Device.isUploadComplete(m_UploadTicket)) {
+		m_UploadTicket = 0;
+	}
+	return m_UploadTicket != 0;
 }
 
 void Model::bind(VkCommandBuffer commandBuffer)
@@ -18,54 +110,102 @@ void Model::bind(VkCommandBuffer commandBuffer)
 	VkBuffer buffers[] = { m_VertexBuffer };
 	VkDeviceSize offsets[] = { 0 };
 	vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+
+	if (m_HasIndexBuffer) {
+		vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer, 0, m_IndexType);
+	}
+}
+
+void Model::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance, uint32_t lod)
+{
+	if (m_HasIndexBuffer) {
+		vkCmdDrawIndexed(commandBuffer, m_Lods[lod].indexCount, instanceCount, m_Lods[lod].firstIndex, 0, firstInstance);
+	}
+	else {
+		vkCmdDraw(commandBuffer, m_VertexCount, instanceCount, 0, firstInstance);
+	}
 }
 
-void Model::draw(VkCommandBuffer commandBuffer)
+uint32_t Model::selectLod(float pixelsPerUnit, float maxErrorPixels) const
 {
-	vkCmdDraw(commandBuffer, m_VertexCount, 1, 0, 0);
+	// Errors only grow along the chain, so the first level from the coarse end that fits is the one
+	for (uint32_t lod = getLodCount() - 1; lod > 0; lod--) {
+		if (m_Lods[lod].error * pixelsPerUnit <= maxErrorPixels) {
+			return lod;
+		}
+	}
+	return 0;
 }
 
-void Model::m_CreateVertexBuffer(std::vector<Vertex>& verticies)
+float Model::pixelsPerUnit(VkExtent2D extent, float scaleX, float scaleY)
 {
-	m_VertexCount = static_cast<uint32_t>(verticies.size());
+	// The projection is orthographic, so only the scale matters and the larger axis bounds any rotation
+	return 0.5f * static_cast<float>(std::max(extent.width, extent.height)) * std::max(std::abs(scaleX), std::abs(scaleY));
+}
+
+void Model::m_CreateVertexBuffer(const void* vertices, uint32_t vertexCount, bool storage)
+{
+	m_VertexCount = vertexCount;
 	assert(m_VertexCount >= 3 && "Vertex count must be at least 3");
-	VkDeviceSize bufferSize = sizeof(verticies[0]) * m_VertexCount;
-	m_Device.createBuffer(
-		bufferSize,
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	m_UploadTicket = m_Device.createDeviceLocalBuffer(
+		VkDeviceSize(VertexLayout::active().stride()) * m_VertexCount,
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | (storage ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0),
+		vertices,
 		m_VertexBuffer,
-		m_VertexBufferMemory);
+		m_VertexAllocation);
+}
 
-	void* data;
-	vkMapMemory(m_Device.device(), m_VertexBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, verticies.data(), static_cast<size_t>(bufferSize));
-	vkUnmapMemory(m_Device.device(), m_VertexBufferMemory);
+void Model::m_CreateIndexBuffer(const void* indices, uint32_t indexCount, VkIndexType indexType)
+{
+	m_IndexCount = indexCount;
+	m_IndexType = indexType;
+	m_HasIndexBuffer = m_IndexCount > 0;
+	if (!m_HasIndexBuffer) {
+		return;
+	}
+
+	const VkDeviceSize indexSize = indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	m_UploadTicket = std::max(m_UploadTicket, m_Device.createDeviceLocalBuffer(
+		indexSize * m_IndexCount,
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		indices,
+		m_IndexBuffer,
+		m_IndexAllocation));
 }
 
-std::vector<VkVertexInputBindingDescription> Model::Vertex::getBindingDescriptions()
+void Model::m_SetLods(const Lod* lods, uint32_t lodCount)
+{
+	if (lodCount > 0 && m_HasIndexBuffer) {
+		m_Lods.assign(lods, lods + lodCount);
+		return;
+	}
+	// Without an index buffer draw() reads indexCount as the vertex count
+	m_Lods = { { 0, m_HasIndexBuffer ? m_IndexCount : m_VertexCount, 0.0f } };
+}
+
+void Model::m_CreateMeshletBuffers(const Meshlet* meshlets, uint32_t meshletCount, const uint32_t* vertices, uint32_t vertexCount,
+	const uint8_t* triangles, uint32_t triangleBytes)
 {
-	std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
-	bindingDescriptions[0].binding = 0;
-	bindingDescriptions[0].stride = sizeof(Vertex);
-	bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	if (meshletCount == 0) {
+		return;
+	}
+	assert(vertexCount > 0 && triangleBytes % 4 == 0 && "Meshlet triangles are read as 32-bit words");
+	m_Meshlets.assign(meshlets, meshlets + meshletCount);
+
+	m_UploadTicket = std::max(m_UploadTicket, m_Device.createDeviceLocalBuffer(
+		sizeof(Meshlet) * meshletCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshlets, m_MeshletBuffer, m_MeshletAllocation));
+	m_UploadTicket = std::max(m_UploadTicket, m_Device.createDeviceLocalBuffer(
+		sizeof(uint32_t) * vertexCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vertices, m_MeshletVertexBuffer, m_MeshletVertexAllocation));
+	m_UploadTicket = std::max(m_UploadTicket, m_Device.createDeviceLocalBuffer(
+		triangleBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, triangles, m_MeshletTriangleBuffer, m_MeshletTriangleAllocation));
+}
 
-	return bindingDescriptions;
+std::vector<VkVertexInputBindingDescription> Model::Vertex::getBindingDescriptions()
+{
+	return VertexLayout::active().getBindingDescriptions();
 }
 
 std::vector<VkVertexInputAttributeDescription> Model::Vertex::getAttributeDescriptions()
 {
-	std::vector<VkVertexInputAttributeDescription> attributeDescriptions(2);
-	// Position
-	attributeDescriptions[0].binding = 0;
-	attributeDescriptions[0].location = 0;
-	attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-	attributeDescriptions[0].offset = offsetof(Vertex, position);
-	// Colour
-	attributeDescriptions[1].binding = 0;
-	attributeDescriptions[1].location = 1;
-	attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[1].offset = offsetof(Vertex, colour);
-
-	return attributeDescriptions;
+	return VertexLayout::active().getAttributeDescriptions();
 }
@@ -6,6 +6,7 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
+#include <unordered_map>
 #include <vector>
 
 
@@ -16,21 +17,154 @@ public:
 		glm::vec2 position;
 		glm::vec3 colour;
 
+		// Vertex input state of the active VertexLayout, which is what the vertex buffers hold
 		static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
 		static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+
+		bool operator==(const Vertex& other) const {
+			return position == other.position && colour == other.colour;
+		}
+
+		struct Hash {
+			size_t operator()(const Vertex& vertex) const;
+		};
+	};
+
+	// A level of detail is a range of the shared index buffer, all levels use the same vertices
+	struct Lod {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		float error;				// Largest distance the surface moved from the full mesh, in model units
+	};
+
+	// A cluster of at most MAX_MESHLET_VERTICES vertices and MAX_MESHLET_TRIANGLES triangles of LOD 0, with bounds for
+	// culling it on its own. Matches Meshlet in the cluster shaders (std430)
+	struct Meshlet {
+		glm::vec2 center;			// Bounding circle in model units
+		float radius;
+		float coneCutoff;			// Back facing from any view direction d with dot(d, coneAxis) >= coneCutoff, above 1 never
+		glm::vec3 coneAxis;
+		uint32_t firstIndex;		// Its triangles are indices [firstIndex, firstIndex + 3 * triangleCount) of the index buffer
+		uint32_t triangleCount;
+		uint32_t vertexOffset;		// Into meshletVertices, vertexCount model vertex indices
+		uint32_t vertexCount;
+		uint32_t triangleOffset;	// Into meshletTriangles, three local vertex indices per triangle, 4 byte aligned
+	};
+
+	static constexpr uint32_t MAX_MESHLET_VERTICES = 64;
+	static constexpr uint32_t MAX_MESHLET_TRIANGLES = 124;
+
+	// Pixels of simplification error accepted before a finer LOD is drawn
+	static constexpr float DEFAULT_LOD_ERROR_PIXELS = 1.0f;
+
+	struct Builder {
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		// Empty means one level covering every index, otherwise lods[0] is the full mesh
+		std::vector<Lod> lods{};
+		// Optional, see MeshletBuilder
+		std::vector<Meshlet> meshlets{};
+		std::vector<uint32_t> meshletVertices{};
+		std::vector<uint8_t> meshletTriangles{};
+
+		// Appends a vertex as an index, reusing an identical vertex that was already added
+		void addVertex(const Vertex& vertex);
+		// Replaces the builder contents with a deduplicated, indexed copy of a triangle list
+		void loadVertices(const std::vector<Vertex>& triangleList);
+
+	private:
+		std::unordered_map<Vertex, uint32_t, Vertex::Hash> m_UniqueVertices{};
 	};
 
-	Model(Device& device, std::vector<Vertex>& verticies);
+	// Geometry in its final GPU form, copied into the buffers without any conversion.
+	// MeshCache hands these out pointing straight into a memory-mapped file
+	struct MeshView {
+		const void* vertices;			// Packed in the active VertexLayout
+		uint32_t vertexCount;
+		const void* indices;			// indexCount entries of indexType, may be null
+		uint32_t indexCount;
+		VkIndexType indexType;
+		float boundingRadius;
+		float positionScale;
+		const Lod* lods;				// May be null for a single level
+		uint32_t lodCount;
+		const Meshlet* meshlets;		// May be null
+		uint32_t meshletCount;
+		const uint32_t* meshletVertices;
+		uint32_t meshletVertexCount;
+		const uint8_t* meshletTriangles;
+		uint32_t meshletTriangleBytes;
+	};
+
+	Model(Device& device, const Builder& builder);
+	Model(Device& device, const MeshView& mesh);
 	~Model();
+
+	// Not copyable or movable
+	Model(const Model&) = delete;
+	Model& operator=(const Model&) = delete;
+
 	void bind(VkCommandBuffer commandBuffer);
-	void draw(VkCommandBuffer commandBuffer);
+	void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0, uint32_t lod = 0);
+
+	bool hasIndexBuffer() const { return m_HasIndexBuffer; }
+	// Indices of every LOD together
+	uint32_t getIndexCount() const { return m_IndexCount; }
+	uint32_t getLodCount() const { return static_cast<uint32_t>(m_Lods.size()); }
+	const Lod& getLod(uint32_t lod) const { return m_Lods[lod]; }
+	// Coarsest LOD whose error stays within maxErrorPixels when one model unit covers pixelsPerUnit pixels
+	uint32_t selectLod(float pixelsPerUnit, float maxErrorPixels = DEFAULT_LOD_ERROR_PIXELS) const;
+	// Pixels one model unit spans on a target of this extent under the given scale, clip space [-1, 1] covering the target
+	static float pixelsPerUnit(VkExtent2D extent, float scaleX, float scaleY);
+	// Radius of the circle around the model origin that contains every vertex
+	float getBoundingRadius() const { return m_BoundingRadius; }
+	// Stored positions times this are model space positions. Render systems fold it into the object transform,
+	// it is 1 unless the VertexLayout normalizes positions
+	float getPositionScale() const { return m_PositionScale; }
+	// Meshlet data lives in storage buffers for the cluster shaders, which also read the vertex buffer as storage
+	bool hasMeshlets() const { return !m_Meshlets.empty(); }
+	uint32_t getMeshletCount() const { return static_cast<uint32_t>(m_Meshlets.size()); }
+	const std::vector<Meshlet>& getMeshlets() const { return m_Meshlets; }
+	VkBuffer getVertexBuffer() const { return m_VertexBuffer; }
+	VkBuffer getMeshletBuffer() const { return m_MeshletBuffer; }
+	VkBuffer getMeshletVertexBuffer() const { return m_MeshletVertexBuffer; }
+	VkBuffer getMeshletTriangleBuffer() const { return m_MeshletTriangleBuffer; }
+	// A model is pending until the staging copies of its buffers have completed on the GPU.
+	// Draws recorded later on the graphics queue are ordered after the copies, this is for streaming bookkeeping
+	bool isPending();
 
 private:
 	Device& m_Device;
+
 	VkBuffer m_VertexBuffer;
-	VkDeviceMemory m_VertexBufferMemory;
+	Allocation m_VertexAllocation;
 	uint32_t m_VertexCount;
+	float m_BoundingRadius{ 0.0f };
+	float m_PositionScale{ 1.0f };
 
-	void m_CreateVertexBuffer(std::vector<Vertex>& verticies);
-};
+	bool m_HasIndexBuffer{ false };
+	VkBuffer m_IndexBuffer;
+	Allocation m_IndexAllocation;
+	uint32_t m_IndexCount{ 0 };
+	VkIndexType m_IndexType{ VK_INDEX_TYPE_UINT32 };
+
+	// Latest staging ticket of the two buffers, cleared once it completes
+	uint64_t m_UploadTicket{ 0 };
+
+	std::vector<Lod> m_Lods;
 
+	// Kept on the CPU as well, for the triangle counts and culling statistics
+	std::vector<Meshlet> m_Meshlets;
+	VkBuffer m_MeshletBuffer{ VK_NULL_HANDLE };
+	Allocation m_MeshletAllocation;
+	VkBuffer m_MeshletVertexBuffer{ VK_NULL_HANDLE };
+	Allocation m_MeshletVertexAllocation;
+	VkBuffer m_MeshletTriangleBuffer{ VK_NULL_HANDLE };
+	Allocation m_MeshletTriangleAllocation;
+
+	void m_CreateVertexBuffer(const void* vertices, uint32_t vertexCount, bool storage);
+	void m_CreateIndexBuffer(const void* indices, uint32_t indexCount, VkIndexType indexType);
+	void m_SetLods(const Lod* lods, uint32_t lodCount);
+	void m_CreateMeshletBuffers(const Meshlet* meshlets, uint32_t meshletCount, const uint32_t* vertices, uint32_t vertexCount,
+		const uint8_t* triangles, uint32_t triangleBytes);
+};
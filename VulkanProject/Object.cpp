@@ -1 +0,0 @@
-#include "Object.h"
@@ -0,0 +1,273 @@
+#include "OffscreenTarget.h"
+
+#include "Profiler.h"
+
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+OffscreenTarget::OffscreenTarget(Device& device, VkExtent2D extent, uint32_t imageCount)
+	: m_Device(device), m_Extent(extent)
+{
+	m_DepthFormat = m_Device.findSupportedFormat(
+		{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+
+	m_CreateRenderPass();
+	m_CreateImages(imageCount);
+}
+
+OffscreenTarget::~OffscreenTarget()
+{
+	waitIdle();
+
+	for (auto& image : m_Images) {
+		if (image.readbackBuffer != VK_NULL_HANDLE) {
+			m_Device.destroyBuffer(image.readbackBuffer, image.readbackAllocation);
+		}
+		vkDestroyFramebuffer(m_Device.device(), image.framebuffer, nullptr);
+		vkDestroyImageView(m_Device.device(), image.depthView, nullptr);
+		m_Device.destroyImage(image.depthImage, image.depthAllocation);
+		vkDestroyImageView(m_Device.device(), image.colourView, nullptr);
+		m_Device.destroyImage(image.colourImage, image.colourAllocation);
+	}
+	vkDestroyRenderPass(m_Device.device(), m_RenderPass, nullptr);
+}
+
+VkResult OffscreenTarget::acquireNextImage(uint32_t* imageIndex)
+{
+	PROFILE_FUNCTION();
+	Image& image = m_Images[m_CurrentImage];
+	if (!image.capturePath.empty()) {
+		m_WriteCapture(image);
+	}
+
+	*imageIndex = m_CurrentImage;
+	return VK_SUCCESS;
+}
+
+VkResult OffscreenTarget::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex, FrameContext& frame)
+{
+	// Nothing to acquire or present, so the timeline is the only synchronisation needed
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = buffers;
+
+	frame.setSubmittedValue(m_Device.submit(QueueType::Graphics, submitInfo));
+
+	m_CurrentImage = (m_CurrentImage + 1) % static_cast<uint32_t>(m_Images.size());
+	return VK_SUCCESS;
+}
+
+void OffscreenTarget::recordCapture(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	if (m_PendingCapturePath.empty()) {
+		return;
+	}
+	Image& image = m_Images[imageIndex];
+
+	if (image.readbackBuffer == VK_NULL_HANDLE) {
+		m_Device.createBuffer(
+			static_cast<VkDeviceSize>(m_Extent.width) * m_Extent.height * 4,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			image.readbackBuffer,
+			image.readbackAllocation);
+	}
+
+	// The render pass leaves the colour image in TRANSFER_SRC_OPTIMAL
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { m_Extent.width, m_Extent.height, 1 };
+	vkCmdCopyImageToBuffer(commandBuffer, image.colourImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image.readbackBuffer, 1, &region);
+
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	image.capturePath = std::move(m_PendingCapturePath);
+	m_PendingCapturePath.clear();
+}
+
+void OffscreenTarget::waitIdle()
+{
+	m_Device.waitForTimeline(QueueType::Graphics, m_Device.submittedValue(QueueType::Graphics));
+	for (auto& image : m_Images) {
+		if (!image.capturePath.empty()) {
+			m_WriteCapture(image);
+		}
+	}
+}
+
+void OffscreenTarget::m_WriteCapture(Image& image)
+{
+	std::ofstream file(image.capturePath, std::ios::binary);
+	if (!file.is_open()) {
+		std::cout << "Failed to open capture file: " << image.capturePath << std::endl;
+		image.capturePath.clear();
+		return;
+	}
+
+	// PPM wants tightly packed RGB, the image is BGRA
+	const auto* pixels = static_cast<const uint8_t*>(image.readbackAllocation.mappedData);
+	const size_t pixelCount = static_cast<size_t>(m_Extent.width) * m_Extent.height;
+	std::vector<uint8_t> rgb(pixelCount * 3);
+	for (size_t i = 0; i < pixelCount; i++) {
+		rgb[i * 3 + 0] = pixels[i * 4 + 2];
+		rgb[i * 3 + 1] = pixels[i * 4 + 1];
+		rgb[i * 3 + 2] = pixels[i * 4 + 0];
+	}
+
+	file << "P6\n" << m_Extent.width << " " << m_Extent.height << "\n255\n";
+	file.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+	std::cout << "Saved frame to " << image.capturePath << std::endl;
+	image.capturePath.clear();
+}
+
+void OffscreenTarget::m_CreateRenderPass()
+{
+	// Attachments and subpass match SwapChain::createRenderPass so pipelines are interchangeable
+	VkAttachmentDescription depthAttachment{};
+	depthAttachment.format = m_DepthFormat;
+	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference depthAttachmentRef{};
+	depthAttachmentRef.attachment = 1;
+	depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentDescription colourAttachment{};
+	colourAttachment.format = COLOUR_FORMAT;
+	colourAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	colourAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colourAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	colourAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	colourAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	colourAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	colourAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+	VkAttachmentReference colourAttachmentRef{};
+	colourAttachmentRef.attachment = 0;
+	colourAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass{};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &colourAttachmentRef;
+	subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+	std::array<VkSubpassDependency, 2> dependencies{};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].srcAccessMask = 0;
+	dependencies[0].srcStageMask =
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].dstStageMask =
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstAccessMask =
+		VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	// Makes the colour writes visible to the readback copy
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	std::array<VkAttachmentDescription, 2> attachments{ colourAttachment, depthAttachment };
+	VkRenderPassCreateInfo renderPassInfo{};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+	renderPassInfo.pAttachments = attachments.data();
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpass;
+	renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	renderPassInfo.pDependencies = dependencies.data();
+
+	if (vkCreateRenderPass(m_Device.device(), &renderPassInfo, nullptr, &m_RenderPass) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create render pass!");
+	}
+}
+
+void OffscreenTarget::m_CreateImages(uint32_t imageCount)
+{
+	m_Images.resize(imageCount);
+
+	for (auto& image : m_Images) {
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = m_Extent.width;
+		imageInfo.extent.height = m_Extent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = COLOUR_FORMAT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		m_Device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image.colourImage, image.colourAllocation);
+
+		imageInfo.format = m_DepthFormat;
+		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		m_Device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image.depthImage, image.depthAllocation);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image.colourImage;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = COLOUR_FORMAT;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+		if (vkCreateImageView(m_Device.device(), &viewInfo, nullptr, &image.colourView) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create texture image view!");
+		}
+
+		viewInfo.image = image.depthImage;
+		viewInfo.format = m_DepthFormat;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		if (vkCreateImageView(m_Device.device(), &viewInfo, nullptr, &image.depthView) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create texture image view!");
+		}
+
+		std::array<VkImageView, 2> attachments = { image.colourView, image.depthView };
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = m_RenderPass;
+		framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		framebufferInfo.pAttachments = attachments.data();
+		framebufferInfo.width = m_Extent.width;
+		framebufferInfo.height = m_Extent.height;
+		framebufferInfo.layers = 1;
+		if (vkCreateFramebuffer(m_Device.device(), &framebufferInfo, nullptr, &image.framebuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create framebuffer!");
+		}
+	}
+}
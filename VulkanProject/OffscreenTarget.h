@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Device.h"
+#include "FrameContext.h"
+
+#include <string>
+#include <vector>
+
+// Stands in for the SwapChain when running headless. Renders into its own colour and depth images
+// with a render pass laid out like the swapchain's, and can copy finished frames back to disk.
+class OffscreenTarget
+{
+public:
+	static constexpr VkFormat COLOUR_FORMAT = VK_FORMAT_B8G8R8A8_SRGB;
+
+	// One image per frame in flight, so image and frame indices advance together
+	OffscreenTarget(Device& device, VkExtent2D extent, uint32_t imageCount);
+	~OffscreenTarget();
+
+	// Not copyable or movable
+	OffscreenTarget(const OffscreenTarget&) = delete;
+	OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+	VkFramebuffer getFrameBuffer(int index) { return m_Images[index].framebuffer; }
+	VkRenderPass getRenderPass() { return m_RenderPass; }
+	VkExtent2D getExtent() { return m_Extent; }
+	size_t imageCount() { return m_Images.size(); }
+
+	// Same contract as the SwapChain, the caller has already waited on the frame that last used the image
+	VkResult acquireNextImage(uint32_t* imageIndex);
+	VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex, FrameContext& frame);
+
+	// Saves the next frame recorded into this target as a binary PPM once the GPU has finished it
+	void requestCapture(const std::string& filePath) { m_PendingCapturePath = filePath; }
+	// Records the readback copy when a capture is pending, called after the render pass ends
+	void recordCapture(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	// Blocks until every submitted frame has finished and writes any outstanding captures
+	void waitIdle();
+
+private:
+	struct Image {
+		VkImage colourImage = VK_NULL_HANDLE;
+		Allocation colourAllocation;
+		VkImageView colourView = VK_NULL_HANDLE;
+		VkImage depthImage = VK_NULL_HANDLE;
+		Allocation depthAllocation;
+		VkImageView depthView = VK_NULL_HANDLE;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+		// Readback copy of the colour image, only created when a capture is first requested
+		VkBuffer readbackBuffer = VK_NULL_HANDLE;
+		Allocation readbackAllocation;
+		std::string capturePath;
+	};
+
+	Device& m_Device;
+	VkExtent2D m_Extent;
+	VkFormat m_DepthFormat;
+	VkRenderPass m_RenderPass;
+	std::vector<Image> m_Images;
+	uint32_t m_CurrentImage = 0;
+	std::string m_PendingCapturePath;
+
+	void m_CreateRenderPass();
+	void m_CreateImages(uint32_t imageCount);
+	void m_WriteCapture(Image& image);
+};
@@ -2,26 +2,46 @@
 
 #include "Model.h"
 
+#include <chrono>
 #include <fstream>
 #include <stdexcept>
 #include <iostream>
 #include <cassert>
+#include <cstring>
+
+static std::string s_ShaderDirectory = "../shaders";
+static constexpr uint32_t SPIRV_MAGIC = 0x07230203;
 
 Pipeline::Pipeline(Device& device, const PipelineConfigInfo& configInfo, const std::string& vertexFilePath, const std::string& fragFilePath) 
+	: Pipeline(device, configInfo, { { VK_SHADER_STAGE_VERTEX_BIT, vertexFilePath }, { VK_SHADER_STAGE_FRAGMENT_BIT, fragFilePath } })
+{
+}
+
+Pipeline::Pipeline(Device& device, const PipelineConfigInfo& configInfo, const std::vector<ShaderStageInfo>& stages)
 	: m_Device(device)
 {
-	m_createGraphicsPipeline(vertexFilePath, fragFilePath, configInfo);
+	// Shaders can be replaced while running, so a bad file must not leak the modules created before it
+	try {
+		m_createGraphicsPipeline(stages, configInfo);
+	}
+	catch (...) {
+		m_destroyShaderModules();
+		throw;
+	}
 }
 
 Pipeline::~Pipeline()
 {
-	vkDestroyShaderModule(m_Device.device(), m_VertexShaderModule, nullptr);
-	vkDestroyShaderModule(m_Device.device(), m_FragmentShaderModule, nullptr);
+	m_destroyShaderModules();
 	vkDestroyPipeline(m_Device.device(), m_GraphicsPipeline, nullptr);
 }
 
 void Pipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo)
 {
+	// Vertex layout (Per-vertex Model data only, systems append their own bindings)
+	configInfo.bindingDescriptions = Model::Vertex::getBindingDescriptions();
+	configInfo.attributeDescriptions = Model::Vertex::getAttributeDescriptions();
+
 	// Input Assembler (Describes how to interpret vertex data)
 	configInfo.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
 	configInfo.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
@@ -101,7 +121,7 @@ void Pipeline::bind(VkCommandBuffer commandBuffer)
 	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline);
 }
 
-std::vector<char> Pipeline::m_readFile(const std::string& filePath)
+std::vector<char> Pipeline::readFile(const std::string& filePath)
 {
 	std::ifstream file(filePath, std::ios::ate | std::ios::binary);
 
@@ -121,37 +141,56 @@ std::vector<char> Pipeline::m_readFile(const std::string& filePath)
 	return content;
 }
 
-void Pipeline::m_createGraphicsPipeline(const std::string& vertexFilePath, const std::string& fragFilePath, const PipelineConfigInfo& configInfo)
+void Pipeline::checkSpirv(const std::vector<char>& code, const std::string& filePath)
+{
+	uint32_t magic = 0;
+	if (code.size() >= sizeof(magic)) {
+		std::memcpy(&magic, code.data(), sizeof(magic));
+	}
+	if (magic != SPIRV_MAGIC || code.size() % sizeof(uint32_t) != 0)
+	{
+		throw std::runtime_error("Not a SPIR-V module: " + filePath);
+	}
+}
+
+void Pipeline::setShaderDirectory(const std::string& directory)
+{
+	s_ShaderDirectory = directory;
+}
+
+std::string Pipeline::shaderPath(const std::string& fileName)
+{
+	return s_ShaderDirectory + "/" + fileName;
+}
+
+void Pipeline::m_createGraphicsPipeline(const std::vector<ShaderStageInfo>& stages, const PipelineConfigInfo& configInfo)
 {
 	assert(configInfo.pipelineLayout != VK_NULL_HANDLE && 
 		"Cannot create graphics pipeline: no pipelineLayout provided in configInfo");
 	assert(configInfo.renderPass != VK_NULL_HANDLE && 
 		"Cannot create graphics pipeline: no renderPass provided in configInfo");
-	std::vector<char> vertexCode = m_readFile(vertexFilePath);
-	std::vector<char> fragCode = m_readFile(fragFilePath);
-
-	m_createShaderModules(vertexCode, m_VertexShaderModule);
-	m_createShaderModules(fragCode, m_FragmentShaderModule);
-
-	VkPipelineShaderStageCreateInfo shaderStages[2];
-	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-	shaderStages[0].module = m_VertexShaderModule;
-	shaderStages[0].pName = "main";
-	shaderStages[0].flags = 0;
-	shaderStages[0].pNext = nullptr;
-	shaderStages[0].pSpecializationInfo = nullptr;
-
-	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	shaderStages[1].module = m_FragmentShaderModule;
-	shaderStages[1].pName = "main";
-	shaderStages[1].flags = 0;
-	shaderStages[1].pNext = nullptr;
-	shaderStages[1].pSpecializationInfo = nullptr;
-
-	std::vector<VkVertexInputBindingDescription> bindingDescriptions = Model::Vertex::getBindingDescriptions();
-	std::vector<VkVertexInputAttributeDescription> attributeDescriptions =  Model::Vertex::getAttributeDescriptions();
+	assert(!stages.empty() && "Cannot create graphics pipeline: no shader stages");
+
+	std::vector<VkPipelineShaderStageCreateInfo> shaderStages(stages.size());
+	bool meshPipeline = false;
+	m_ShaderModules.resize(stages.size(), VK_NULL_HANDLE);
+	for (size_t i = 0; i < stages.size(); i++) {
+		std::vector<char> code = readFile(stages[i].filePath);
+		checkSpirv(code, stages[i].filePath);
+		m_createShaderModules(code, m_ShaderModules[i]);
+
+		shaderStages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[i].stage = stages[i].stage;
+		shaderStages[i].module = m_ShaderModules[i];
+		shaderStages[i].pName = "main";
+		shaderStages[i].flags = 0;
+		shaderStages[i].pNext = nullptr;
+		shaderStages[i].pSpecializationInfo = nullptr;
+		meshPipeline |= stages[i].stage == VK_SHADER_STAGE_MESH_BIT_EXT;
+	}
+
+	const auto& bindingDescriptions = configInfo.bindingDescriptions;
+	const auto& attributeDescriptions = configInfo.attributeDescriptions;
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
@@ -161,10 +200,11 @@ void Pipeline::m_createGraphicsPipeline(const std::string& vertexFilePath, const
 
 	VkGraphicsPipelineCreateInfo pipelineInfo{};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2;
-	pipelineInfo.pStages = shaderStages;
-	pipelineInfo.pVertexInputState = &vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
+	pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+	pipelineInfo.pStages = shaderStages.data();
+	// Mesh shaders build their own primitives
+	pipelineInfo.pVertexInputState = meshPipeline ? nullptr : &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = meshPipeline ? nullptr : &configInfo.inputAssemblyInfo;
 	pipelineInfo.pViewportState = &configInfo.viewportInfo;
 	pipelineInfo.pRasterizationState = &configInfo.rasterizationInfo;
 	pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
@@ -179,11 +219,24 @@ void Pipeline::m_createGraphicsPipeline(const std::string& vertexFilePath, const
 	pipelineInfo.basePipelineIndex = -1;  // Optional
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;  // Optional
 
-	if (vkCreateGraphicsPipelines(m_Device.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_GraphicsPipeline) != VK_SUCCESS)
+	auto createStart = std::chrono::high_resolution_clock::now();
+	if (vkCreateGraphicsPipelines(m_Device.device(), m_Device.pipelineCache(), 1, &pipelineInfo, nullptr, &m_GraphicsPipeline) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create graphics pipeline");
 	}
+	auto createTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - createStart).count();
+	std::cout << "Created pipeline " << stages[0].filePath << " in " << createTime << " ms" << std::endl;
+
+}
 
+void Pipeline::m_destroyShaderModules()
+{
+	for (VkShaderModule shaderModule : m_ShaderModules) {
+		if (shaderModule != VK_NULL_HANDLE) {
+			vkDestroyShaderModule(m_Device.device(), shaderModule, nullptr);
+		}
+	}
+	m_ShaderModules.clear();
 }
 
 void Pipeline::m_createShaderModules(const std::vector<char>& code, VkShaderModule& shaderModule)
@@ -6,9 +6,13 @@
 #include "Device.h"
 
 struct PipelineConfigInfo {
+	PipelineConfigInfo() = default;
 	PipelineConfigInfo(const PipelineConfigInfo&) = delete;
 	PipelineConfigInfo& operator=(const PipelineConfigInfo&) = delete;
 
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions{};
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
 	VkPipelineViewportStateCreateInfo viewportInfo;
 	VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
 	VkPipelineRasterizationStateCreateInfo rasterizationInfo;
@@ -23,6 +27,11 @@ struct PipelineConfigInfo {
 	uint32_t subpass = 0;
 };
 
+struct ShaderStageInfo {
+	VkShaderStageFlagBits stage;
+	std::string filePath;
+};
+
 class Pipeline
 {
 public:
@@ -30,6 +39,10 @@ public:
 		const PipelineConfigInfo& configInfo,
 		const std::string& vertexFilePath,
 		const std::string& fragFilePath);
+	// Any set of graphics stages. With a mesh shader the vertex input and input assembly state are ignored
+	Pipeline(Device& device,
+		const PipelineConfigInfo& configInfo,
+		const std::vector<ShaderStageInfo>& stages);
 
 	~Pipeline();
 
@@ -37,21 +50,27 @@ public:
 
 	void bind(VkCommandBuffer commandBuffer);
 
+	static std::vector<char> readFile(const std::string& filePath);
+	// Throws unless code looks like a complete SPIR-V module, e.g. not one caught halfway through being written
+	static void checkSpirv(const std::vector<char>& code, const std::string& filePath);
+
+	// Directory the .spv files are read from, set once at start-up before any Pipeline exists
+	static void setShaderDirectory(const std::string& directory);
+	static std::string shaderPath(const std::string& fileName);
+
 	// Not copyable or movable
 	Pipeline(const Pipeline&) = delete;
 	Pipeline operator=(const Pipeline&) = delete;
 
 private:
 	Device& m_Device;
-	VkPipeline m_GraphicsPipeline;
-	VkShaderModule m_VertexShaderModule;
-	VkShaderModule m_FragmentShaderModule;
+	VkPipeline m_GraphicsPipeline{ VK_NULL_HANDLE };
+	std::vector<VkShaderModule> m_ShaderModules;
 
-	std::vector<char> m_readFile(const std::string& filePath);
-	void m_createGraphicsPipeline(const std::string& vertexFilePath,
-		const std::string& fragFilePath,
+	void m_createGraphicsPipeline(const std::vector<ShaderStageInfo>& stages,
 		const PipelineConfigInfo& configInfo);
 
 	void m_createShaderModules(const std::vector<char>& code, VkShaderModule& shaderModule);
+	void m_destroyShaderModules();
 };
 
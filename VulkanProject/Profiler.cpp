@@ -0,0 +1,132 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Profiler {
+
+	// Written only by its owning thread. writeIndex counts every event ever recorded, so a reader
+	// can tell which slots were overwritten while it was copying them.
+	struct ThreadBuffer {
+		std::vector<Event> events = std::vector<Event>(EVENTS_PER_THREAD);
+		std::atomic<uint64_t> writeIndex{ 0 };
+		uint32_t threadId = 0;
+		std::string name;
+	};
+
+	struct Registry {
+		std::mutex mutex;
+		std::vector<std::shared_ptr<ThreadBuffer>> buffers;		// Kept alive after their thread exits
+		std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	};
+
+	static Registry& registry()
+	{
+		static Registry instance;
+		return instance;
+	}
+
+	// Registration takes the lock once per thread, recording never does
+	static ThreadBuffer& threadBuffer()
+	{
+		thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+			auto newBuffer = std::make_shared<ThreadBuffer>();
+			Registry& reg = registry();
+			std::lock_guard<std::mutex> lock(reg.mutex);
+			newBuffer->threadId = static_cast<uint32_t>(reg.buffers.size());
+			newBuffer->name = "Thread " + std::to_string(newBuffer->threadId);
+			reg.buffers.push_back(newBuffer);
+			return newBuffer;
+		}();
+		return *buffer;
+	}
+
+	static void writeEscaped(std::ostream& out, const char* text)
+	{
+		for (; *text; text++) {
+			if (*text == '"' || *text == '\\') {
+				out << '\\';
+			}
+			out << *text;
+		}
+	}
+
+	uint64_t nowNs()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - registry().epoch).count());
+	}
+
+	void record(const char* name, uint64_t startNs, uint64_t endNs)
+	{
+		ThreadBuffer& buffer = threadBuffer();
+		const uint64_t index = buffer.writeIndex.load(std::memory_order_relaxed);
+		buffer.events[index % EVENTS_PER_THREAD] = { name, startNs, endNs - startNs };
+		buffer.writeIndex.store(index + 1, std::memory_order_release);
+	}
+
+	void setThreadName(const std::string& name)
+	{
+		ThreadBuffer& buffer = threadBuffer();
+		std::lock_guard<std::mutex> lock(registry().mutex);
+		buffer.name = name;
+	}
+
+	bool writeChromeTrace(const std::string& filePath)
+	{
+		std::ofstream file(filePath);
+		if (!file.is_open()) {
+			std::cout << "Failed to open trace file: " << filePath << std::endl;
+			return false;
+		}
+
+		std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+		{
+			std::lock_guard<std::mutex> lock(registry().mutex);
+			buffers = registry().buffers;
+		}
+
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		bool first = true;
+		size_t eventCount = 0;
+		std::vector<Event> snapshot;
+		for (const auto& buffer : buffers) {
+			file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->threadId
+				<< ",\"args\":{\"name\":\"";
+			writeEscaped(file, buffer->name.c_str());
+			file << "\"}}";
+			first = false;
+
+			// Copy the newest events, then drop any the owning thread lapped during the copy. The slot of index
+			// endAfterCopy may be mid-write, as the index is only published once the event is complete
+			const uint64_t end = buffer->writeIndex.load(std::memory_order_acquire);
+			const uint64_t begin = end > EVENTS_PER_THREAD ? end - EVENTS_PER_THREAD : 0;
+			snapshot.clear();
+			for (uint64_t i = begin; i < end; i++) {
+				snapshot.push_back(buffer->events[i % EVENTS_PER_THREAD]);
+			}
+			const uint64_t endAfterCopy = buffer->writeIndex.load(std::memory_order_acquire);
+			const uint64_t overwritten = endAfterCopy + 1 > EVENTS_PER_THREAD
+				? std::min<uint64_t>(endAfterCopy + 1 - EVENTS_PER_THREAD, end) : 0;
+			const size_t skip = overwritten > begin ? static_cast<size_t>(overwritten - begin) : 0;
+
+			for (size_t i = skip; i < snapshot.size(); i++) {
+				const Event& event = snapshot[i];
+				file << ",\n{\"name\":\"";
+				writeEscaped(file, event.name);
+				file << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->threadId
+					<< ",\"ts\":" << event.startNs / 1000 << "." << (event.startNs % 1000) / 100
+					<< ",\"dur\":" << event.durationNs / 1000 << "." << (event.durationNs % 1000) / 100 << "}";
+				eventCount++;
+			}
+		}
+		file << "\n]}\n";
+
+		std::cout << "Wrote " << eventCount << " CPU events to " << filePath << std::endl;
+		return true;
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Scoped CPU instrumentation. Each thread records into its own fixed-size ring buffer with no locks
+// on the hot path, and the most recent events of every thread can be written out as a Chrome trace
+// (load it in chrome://tracing or ui.perfetto.dev).
+//
+// Define DISABLE_CPU_PROFILER to compile every PROFILE_ macro away.
+namespace Profiler {
+
+	static constexpr uint32_t EVENTS_PER_THREAD = 1 << 16;
+
+	struct Event {
+		const char* name;		// Must outlive the profiler, string literals or __FUNCTION__
+		uint64_t startNs;
+		uint64_t durationNs;
+	};
+
+	uint64_t nowNs();
+	void record(const char* name, uint64_t startNs, uint64_t endNs);
+	// Shown as the thread's name in the trace viewer
+	void setThreadName(const std::string& name);
+	// Writes the recorded events of every thread, returns false if the file could not be opened
+	bool writeChromeTrace(const std::string& filePath);
+
+	class Scope {
+	public:
+		explicit Scope(const char* name) : m_Name(name), m_Start(nowNs()) {}
+		~Scope() { record(m_Name, m_Start, nowNs()); }
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		const char* m_Name;
+		uint64_t m_Start;
+	};
+}
+
+#ifndef DISABLE_CPU_PROFILER
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) Profiler::Scope PROFILE_CONCAT(profileScope, __LINE__){ name }
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#endif
@@ -0,0 +1,39 @@
+#include "Registry.h"
+
+constexpr uint32_t Entity::INVALID_INDEX;
+
+uint32_t Registry::s_NextTypeId = 0;
+
+Entity Registry::create()
+{
+	Entity entity{};
+	if (!m_FreeIndices.empty()) {
+		entity.index = m_FreeIndices.back();
+		m_FreeIndices.pop_back();
+	}
+	else {
+		entity.index = static_cast<uint32_t>(m_Generations.size());
+		m_Generations.push_back(0);
+	}
+	entity.generation = m_Generations[entity.index];
+	m_AliveCount++;
+	return entity;
+}
+
+void Registry::destroy(Entity entity)
+{
+	assert(isAlive(entity) && "Entity was already destroyed");
+	for (auto& componentPool : m_Pools) {
+		if (componentPool && componentPool->has(entity)) {
+			componentPool->remove(entity);
+		}
+	}
+	m_Generations[entity.index]++;
+	m_FreeIndices.push_back(entity.index);
+	m_AliveCount--;
+}
+
+bool Registry::isAlive(Entity entity) const
+{
+	return entity.index < m_Generations.size() && m_Generations[entity.index] == entity.generation;
+}
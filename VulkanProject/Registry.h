@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Handle to an entity. The generation changes every time an index is reused, so a handle to a
+// destroyed entity never aliases the entity that took its slot.
+struct Entity {
+	static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+	uint32_t index = INVALID_INDEX;
+	uint32_t generation = 0;
+
+	bool isValid() const { return index != INVALID_INDEX; }
+	bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const Entity& other) const { return !(*this == other); }
+};
+
+class ComponentPoolBase
+{
+public:
+	virtual ~ComponentPoolBase() = default;
+	virtual bool has(Entity entity) const = 0;
+	virtual void remove(Entity entity) = 0;
+};
+
+// Sparse set: a sparse array maps entity index to a slot in the dense arrays, which hold the
+// components back to back. Add and remove are O(1), remove moves the last component into the hole.
+template <typename T>
+class ComponentPool : public ComponentPoolBase
+{
+public:
+	static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+	T& add(Entity entity, T component)
+	{
+		assert(!has(entity) && "Entity already has this component");
+		if (entity.index >= m_Sparse.size()) {
+			m_Sparse.resize(entity.index + 1, NO_SLOT);
+		}
+		m_Sparse[entity.index] = static_cast<uint32_t>(m_Components.size());
+		m_Entities.push_back(entity);
+		m_Components.push_back(std::move(component));
+		return m_Components.back();
+	}
+
+	void remove(Entity entity) override
+	{
+		assert(has(entity) && "Entity does not have this component");
+		const uint32_t slot = m_Sparse[entity.index];
+		const uint32_t last = static_cast<uint32_t>(m_Components.size() - 1);
+		if (slot != last) {
+			m_Components[slot] = std::move(m_Components[last]);
+			m_Entities[slot] = m_Entities[last];
+			m_Sparse[m_Entities[slot].index] = slot;
+		}
+		m_Components.pop_back();
+		m_Entities.pop_back();
+		m_Sparse[entity.index] = NO_SLOT;
+	}
+
+	bool has(Entity entity) const override
+	{
+		return entity.index < m_Sparse.size() && m_Sparse[entity.index] != NO_SLOT &&
+			m_Entities[m_Sparse[entity.index]] == entity;
+	}
+
+	T& get(Entity entity)
+	{
+		assert(has(entity) && "Entity does not have this component");
+		return m_Components[m_Sparse[entity.index]];
+	}
+	const T& get(Entity entity) const
+	{
+		assert(has(entity) && "Entity does not have this component");
+		return m_Components[m_Sparse[entity.index]];
+	}
+	T* tryGet(Entity entity) { return has(entity) ? &m_Components[m_Sparse[entity.index]] : nullptr; }
+	const T* tryGet(Entity entity) const { return has(entity) ? &m_Components[m_Sparse[entity.index]] : nullptr; }
+
+	size_t size() const { return m_Components.size(); }
+	// Dense arrays, components()[i] belongs to entities()[i]. Order changes when anything is removed.
+	const std::vector<Entity>& entities() const { return m_Entities; }
+	std::vector<T>& components() { return m_Components; }
+	const std::vector<T>& components() const { return m_Components; }
+
+private:
+	std::vector<uint32_t> m_Sparse;
+	std::vector<Entity> m_Entities;
+	std::vector<T> m_Components;
+};
+
+template <typename T>
+constexpr uint32_t ComponentPool<T>::NO_SLOT;
+
+// Owns every entity and one ComponentPool per component type, created on first use
+class Registry
+{
+public:
+	Registry() = default;
+
+	// Not copyable or movable
+	Registry(const Registry&) = delete;
+	Registry& operator=(const Registry&) = delete;
+
+	Entity create();
+	// Removes all of the entity's components, its handle is invalid afterwards
+	void destroy(Entity entity);
+	bool isAlive(Entity entity) const;
+	size_t aliveCount() const { return m_AliveCount; }
+
+	template <typename T>
+	T& add(Entity entity, T component = T{})
+	{
+		assert(isAlive(entity) && "Cannot add a component to a destroyed entity");
+		return pool<T>().add(entity, std::move(component));
+	}
+	template <typename T>
+	void remove(Entity entity) { pool<T>().remove(entity); }
+	template <typename T>
+	bool has(Entity entity) const
+	{
+		const ComponentPool<T>* componentPool = findPool<T>();
+		return componentPool && componentPool->has(entity);
+	}
+	template <typename T>
+	T& get(Entity entity) { return pool<T>().get(entity); }
+	template <typename T>
+	T* tryGet(Entity entity) { return pool<T>().tryGet(entity); }
+
+	template <typename T>
+	ComponentPool<T>& pool()
+	{
+		const uint32_t typeId = m_TypeId<T>();
+		if (typeId >= m_Pools.size()) {
+			m_Pools.resize(typeId + 1);
+		}
+		if (!m_Pools[typeId]) {
+			m_Pools[typeId] = std::make_unique<ComponentPool<T>>();
+		}
+		return static_cast<ComponentPool<T>&>(*m_Pools[typeId]);
+	}
+	// Null when nothing has added a T yet
+	template <typename T>
+	const ComponentPool<T>* findPool() const
+	{
+		const uint32_t typeId = m_TypeId<T>();
+		return typeId < m_Pools.size() ? static_cast<const ComponentPool<T>*>(m_Pools[typeId].get()) : nullptr;
+	}
+
+	// View over every entity with all of the listed components: calls func(entity, First&, Rest&...).
+	// Iterates First's dense array, so list the rarest component first. Do not add or remove First
+	// components from inside func.
+	template <typename First, typename... Rest, typename Func>
+	void each(Func&& func)
+	{
+		m_Each(func, pool<First>(), pool<Rest>()...);
+	}
+
+private:
+	std::vector<uint32_t> m_Generations;
+	std::vector<uint32_t> m_FreeIndices;
+	std::vector<std::unique_ptr<ComponentPoolBase>> m_Pools;		// Indexed by m_TypeId
+	size_t m_AliveCount{ 0 };
+
+	static uint32_t s_NextTypeId;
+
+	// Dense ids handed out the first time each component type is used
+	template <typename T>
+	static uint32_t m_TypeId()
+	{
+		static const uint32_t typeId = s_NextTypeId++;
+		return typeId;
+	}
+
+	template <typename Func, typename First, typename... Rest>
+	static void m_Each(Func& func, ComponentPool<First>& firstPool, ComponentPool<Rest>&... restPools)
+	{
+		const std::vector<Entity>& entities = firstPool.entities();
+		std::vector<First>& components = firstPool.components();
+		for (size_t i = 0; i < components.size(); i++) {
+			const Entity entity = entities[i];
+			const bool hasAll[] = { true, restPools.has(entity)... };
+			bool matches = true;
+			for (bool has : hasAll) {
+				matches = matches && has;
+			}
+			if (matches) {
+				func(entity, components[i], restPools.get(entity)...);
+			}
+		}
+	}
+};
@@ -1,25 +1,61 @@
 #include "Renderer.h"
 
+#include "Profiler.h"
+
 #include <stdexcept>
 #include <array>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
 
-Renderer::Renderer(Window& window, Device& device)
-	: m_Window(window), m_Device(device)
+Renderer::Renderer(Window& window, Device& device, uint32_t framesInFlight)
+	: m_Window(&window), m_Device(device)
 {
+	m_CreateFrameContexts(framesInFlight);
 	m_RecreateSwapChain();
-	m_CreateCommandBuffers();
+	m_GpuProfiler = std::make_unique<GpuProfiler>(m_Device, framesInFlight);
+}
+
+Renderer::Renderer(Device& device, VkExtent2D extent, uint32_t framesInFlight)
+	: m_Window(nullptr), m_Device(device)
+{
+	assert(device.isHeadless() && "Offscreen renderer needs a headless device");
+	m_CreateFrameContexts(framesInFlight);
+	m_OffscreenTarget = std::make_unique<OffscreenTarget>(m_Device, extent, framesInFlight);
+	m_GpuProfiler = std::make_unique<GpuProfiler>(m_Device, framesInFlight);
 }
 
 Renderer::~Renderer()
 {
-	m_FreeCommandBuffers();
+	if (m_OffscreenTarget) {
+		m_OffscreenTarget->waitIdle();
+	}
+	// Frame contexts may still be referenced by submitted work
+	vkDeviceWaitIdle(m_Device.device());
+}
+
+void Renderer::captureNextFrame(const std::string& filePath)
+{
+	assert(isHeadless() && "Frame capture is only available when rendering offscreen");
+	m_OffscreenTarget->requestCapture(filePath);
 }
 
 VkCommandBuffer Renderer::beginFrame()
 {
 	assert(!m_IsFrameStarted && "Cannot call beginFrame function when a frame has already been started");
+	PROFILE_FUNCTION();
+
+	// Submit every upload queued since the last frame in one batch ahead of this frame's work
+	m_Device.flushUploads();
+
+	FrameContext& frame = *m_Frames[m_CurrentFrameIndex];
+	frame.waitAndReset();
+
+	m_Device.collectGarbage();
 
-	VkResult result = m_SwapChain->acquireNextImage(&m_CurrentImageIndex);
+	VkResult result = m_OffscreenTarget
+		? m_OffscreenTarget->acquireNextImage(&m_CurrentImageIndex)
+		: m_SwapChain->acquireNextImage(frame, &m_CurrentImageIndex);
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 		m_RecreateSwapChain();
@@ -36,51 +72,75 @@ VkCommandBuffer Renderer::beginFrame()
 	VkCommandBuffer commandBuffer = getCurrentCommandBuffer();
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
 	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
 	{
 		throw std::runtime_error("failed to begin recording command buffer!");
 	}
 
+	m_GpuProfiler->beginFrame(commandBuffer, m_CurrentFrameIndex);
+	m_FrameScope = m_GpuProfiler->beginScope(commandBuffer, "Frame");
+
 	return commandBuffer;
 }
 
 void Renderer::endFrame()
 {
 	assert(m_IsFrameStarted && "Cannot call endFrame function when a frame is not in progress");
+	PROFILE_FUNCTION();
 
 	VkCommandBuffer commandBuffer = getCurrentCommandBuffer();
+	m_GpuProfiler->endScope(commandBuffer, m_FrameScope);
+	if (m_OffscreenTarget) {
+		m_OffscreenTarget->recordCapture(commandBuffer, m_CurrentImageIndex);
+	}
 	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
 	{
 		throw std::runtime_error("failed to record command buffer!");
 	}
 
-	VkResult result = m_SwapChain->submitCommandBuffers(&commandBuffer, &m_CurrentImageIndex);
-	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
-		m_Window.wasWindowResized()) {
-		m_Window.resetWindowResizedFlag();
-		m_RecreateSwapChain();
+	FrameContext& frame = *m_Frames[m_CurrentFrameIndex];
+	if (m_OffscreenTarget) {
+		m_OffscreenTarget->submitCommandBuffers(&commandBuffer, &m_CurrentImageIndex, frame);
 	}
-	else if (result != VK_SUCCESS) {
-		throw std::runtime_error("failed to present swap chain image!");
+	else {
+		VkResult result = m_SwapChain->submitCommandBuffers(&commandBuffer, &m_CurrentImageIndex, frame);
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
+			m_Window->wasWindowResized()) {
+			m_Window->resetWindowResizedFlag();
+			m_RecreateSwapChain();
+		}
+		else if (result != VK_SUCCESS) {
+			throw std::runtime_error("failed to present swap chain image!");
+		}
 	}
 
+	m_Device.markFrameSubmitted(frame.submittedValue());
 	m_IsFrameStarted = false;
-	m_CurrentFrameIndex = (m_CurrentFrameIndex + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
+	m_CurrentFrameIndex = (m_CurrentFrameIndex + 1) % static_cast<int>(m_Frames.size());
 }
 
-void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
+void Renderer::setRecordingThreadCount(uint32_t threadCount)
+{
+	for (auto& frame : m_Frames) {
+		frame->reserveRecordingThreads(threadCount);
+	}
+}
+
+void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
 {
 	assert(m_IsFrameStarted && "Cannot call beginSwapChainRenderPass function when a frame is not in progress");
 	assert(commandBuffer == getCurrentCommandBuffer() && "Cannot begin a render pass using a command buffer from another frame");
 
 	VkRenderPassBeginInfo renderPassInfo{};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassInfo.renderPass = m_SwapChain->getRenderPass();
-	renderPassInfo.framebuffer = m_SwapChain->getFrameBuffer(m_CurrentImageIndex);
+	renderPassInfo.renderPass = getSwapChainRenderPass();
+	renderPassInfo.framebuffer = m_GetFrameBuffer();
 
+	const VkExtent2D extent = getExtent();
 	renderPassInfo.renderArea.offset = { 0, 0 };
-	renderPassInfo.renderArea.extent = m_SwapChain->getSwapChainExtent();
+	renderPassInfo.renderArea.extent = extent;
 
 	std::array<VkClearValue, 2> clearValues{};
 	clearValues[0].color = { 0.01f, 0.01f, 0.01f, 1.0f };
@@ -89,16 +149,23 @@ void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
 	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 	renderPassInfo.pClearValues = clearValues.data();
 
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	m_RenderPassScope = m_GpuProfiler->beginScope(commandBuffer, "Render Pass");
+	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+
+	if (contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) {
+		// Secondary buffers set their own viewport and scissor
+		m_Frames[m_CurrentFrameIndex]->setRenderPassInheritance(renderPassInfo.renderPass, renderPassInfo.framebuffer, extent);
+		return;
+	}
 
 	VkViewport viewport{};
 	viewport.x = 0.0f;
 	viewport.y = 0.0f;
-	viewport.width = static_cast<float>(m_SwapChain->getSwapChainExtent().width);
-	viewport.height = static_cast<float>(m_SwapChain->getSwapChainExtent().height);
+	viewport.width = static_cast<float>(extent.width);
+	viewport.height = static_cast<float>(extent.height);
 	viewport.minDepth = 0.0f;
 	viewport.maxDepth = 1.0f;
-	VkRect2D scissor{ {0, 0}, m_SwapChain->getSwapChainExtent() };
+	VkRect2D scissor{ {0, 0}, extent };
 	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 }
@@ -109,57 +176,76 @@ void Renderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer)
 	assert(commandBuffer == getCurrentCommandBuffer() && "Cannot end a render pass using a command buffer from another frame");
 
 	vkCmdEndRenderPass(commandBuffer);
+	m_GpuProfiler->endScope(commandBuffer, m_RenderPassScope);
 }
 
-void Renderer::m_CreateCommandBuffers()
+void Renderer::m_CreateFrameContexts(uint32_t framesInFlight)
 {
-	m_CommandBuffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
-
-	VkCommandBufferAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = m_Device.getCommandPool();
-	allocInfo.commandBufferCount = static_cast<uint32_t>(m_CommandBuffers.size());
-
-	if (vkAllocateCommandBuffers(m_Device.device(), &allocInfo, m_CommandBuffers.data()) != VK_SUCCESS)
-	{
-		throw std::runtime_error("failed to allocate command buffers!");
+	if (framesInFlight < FrameContext::MIN_FRAMES_IN_FLIGHT || framesInFlight > FrameContext::MAX_FRAMES_IN_FLIGHT) {
+		throw std::runtime_error("frames in flight must be between 1 and 4!");
 	}
-}
 
-void Renderer::m_FreeCommandBuffers()
-{
-	vkFreeCommandBuffers(
-		m_Device.device(),
-		m_Device.getCommandPool(),
-		static_cast<uint32_t>(m_CommandBuffers.size()),
-		m_CommandBuffers.data());
-	m_CommandBuffers.clear();
+	m_Frames.reserve(framesInFlight);
+	for (uint32_t i = 0; i < framesInFlight; i++) {
+		m_Frames.push_back(std::make_unique<FrameContext>(m_Device));
+	}
 }
 
 void Renderer::m_RecreateSwapChain()
 {
-	VkExtent2D extent = m_Window.getExtent();
+	PROFILE_FUNCTION();
+	VkExtent2D extent = m_Window->getExtent();
 
 	while (extent.width == 0 || extent.height == 0) {
-		extent = m_Window.getExtent();
+		extent = m_Window->getExtent();
 		glfwWaitEvents();
 	}
 
-	vkDeviceWaitIdle(m_Device.device());
 	if (m_SwapChain == nullptr) {
 		m_SwapChain = std::make_unique<SwapChain>(m_Device, extent);
+		return;
 	}
-	else {
-		std::shared_ptr<SwapChain> oldSwapChain = std::move(m_SwapChain);
-		m_SwapChain = std::make_unique<SwapChain>(m_Device, extent, oldSwapChain);
 
-		if (!oldSwapChain->compareSwapFormats(*m_SwapChain.get())) {
-			throw std::runtime_error("Swap chain image or depth format has changed!");
-		}
+	auto start = std::chrono::steady_clock::now();
+	if (m_IdleOnRecreate) {
+		vkDeviceWaitIdle(m_Device.device());
 	}
 
-	// TODO: check if new render pass is compatible with previous pipeline
-	//			if it is, do not create a new pipleine
-	// m_CreatePipeline();
+	// The old swap chain's resources are freed once the frames in flight that use them have finished,
+	// its render pass is kept so pipelines built against it stay valid
+	std::shared_ptr<SwapChain> oldSwapChain = std::move(m_SwapChain);
+	m_SwapChain = std::make_unique<SwapChain>(m_Device, extent, oldSwapChain);
+
+	if (!oldSwapChain->compareSwapFormats(*m_SwapChain.get())) {
+		throw std::runtime_error("Swap chain image or depth format has changed!");
+	}
+
+	const double recreateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	m_ResizeStats.recreations++;
+	m_ResizeStats.depthAllocations += m_SwapChain->allocatedDepthImages() ? 1 : 0;
+	m_ResizeStats.totalMs += recreateMs;
+	m_ResizeStats.maxMs = std::max(m_ResizeStats.maxMs, recreateMs);
+}
+
+void Renderer::printResizeStats() const
+{
+	if (m_ResizeStats.recreations == 0) {
+		return;
+	}
+	std::cout << "Swap chain recreations: " << m_ResizeStats.recreations
+		<< ", depth images allocated " << m_ResizeStats.depthAllocations << " times"
+		<< ", average " << m_ResizeStats.totalMs / m_ResizeStats.recreations << " ms"
+		<< ", max " << m_ResizeStats.maxMs << " ms" << std::endl;
+}
+
+VkFramebuffer Renderer::m_GetFrameBuffer() const
+{
+	return m_OffscreenTarget
+		? m_OffscreenTarget->getFrameBuffer(m_CurrentImageIndex)
+		: m_SwapChain->getFrameBuffer(m_CurrentImageIndex);
+}
+
+VkExtent2D Renderer::getExtent() const
+{
+	return m_OffscreenTarget ? m_OffscreenTarget->getExtent() : m_SwapChain->getSwapChainExtent();
 }
@@ -3,6 +3,9 @@
 #include "Window.h"
 #include "Device.h"
 #include "SwapChain.h"
+#include "FrameContext.h"
+#include "OffscreenTarget.h"
+#include "GpuProfiler.h"
 #include "Model.h"
 
 #include <memory>
@@ -12,7 +15,17 @@
 class Renderer
 {
 public:
-	Renderer(Window& window, Device& device);
+	// Swap chain recreations since start-up and the CPU time spent in them
+	struct ResizeStats {
+		uint32_t recreations = 0;
+		uint32_t depthAllocations = 0;		// Recreations that could not take over the previous depth images
+		double totalMs = 0.0;
+		double maxMs = 0.0;
+	};
+
+	Renderer(Window& window, Device& device, uint32_t framesInFlight = FrameContext::DEFAULT_FRAMES_IN_FLIGHT);
+	// Headless renderer drawing into an OffscreenTarget of the given size
+	Renderer(Device& device, VkExtent2D extent, uint32_t framesInFlight = FrameContext::DEFAULT_FRAMES_IN_FLIGHT);
 	~Renderer();
 
 	// Not copyable or movable
@@ -21,31 +34,57 @@ public:
 
 	VkCommandBuffer beginFrame();
 	void endFrame();
-	void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+	// With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS the pass may only be filled by vkCmdExecuteCommands
+	void beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 	void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 	bool isFrameInProgress() const { return m_IsFrameStarted; };
-	VkRenderPass getSwapChainRenderPass() const { return m_SwapChain->getRenderPass(); };
+	VkRenderPass getSwapChainRenderPass() const {
+		return m_OffscreenTarget ? m_OffscreenTarget->getRenderPass() : m_SwapChain->getRenderPass();
+	};
+	bool isHeadless() const { return m_OffscreenTarget != nullptr; }
+	// Size of the image being rendered, swap chain or offscreen
+	VkExtent2D getExtent() const;
+	GpuProfiler& getGpuProfiler() { return *m_GpuProfiler; }
+	// Headless only, saves the next completed frame to a PPM file
+	void captureNextFrame(const std::string& filePath);
 	VkCommandBuffer getCurrentCommandBuffer() const { 
 		assert(m_IsFrameStarted && "Cannot get current commandbuffer when frame not in progress");
-		return m_CommandBuffers[m_CurrentFrameIndex];
+		return m_Frames[m_CurrentFrameIndex]->commandBuffer();
 	};
+	FrameContext& getCurrentFrameContext() const {
+		assert(m_IsFrameStarted && "Cannot get current frame context when frame not in progress");
+		return *m_Frames[m_CurrentFrameIndex];
+	}
+	// Gives every frame in flight a secondary command pool per recording thread
+	void setRecordingThreadCount(uint32_t threadCount);
+	uint32_t getFrameCount() const { return static_cast<uint32_t>(m_Frames.size()); }
 	int getFrameIndex() const {
 		assert(m_IsFrameStarted && "Cannot get get frame index when frame not in progress");
 		return m_CurrentFrameIndex;
 	}
+	const ResizeStats& getResizeStats() const { return m_ResizeStats; }
+	void printResizeStats() const;
+	// Waits for the device to idle before each recreation instead of retiring the old swap chain, for comparison
+	void setIdleOnRecreate(bool idleOnRecreate) { m_IdleOnRecreate = idleOnRecreate; }
 
 private:
-	Window& m_Window;
+	Window* m_Window;
 	Device& m_Device;
 	std::unique_ptr <SwapChain> m_SwapChain;
-	std::vector<VkCommandBuffer> m_CommandBuffers;
+	std::unique_ptr<OffscreenTarget> m_OffscreenTarget;
+	std::unique_ptr<GpuProfiler> m_GpuProfiler;
+	uint32_t m_FrameScope{ UINT32_MAX };
+	uint32_t m_RenderPassScope{ UINT32_MAX };
+	std::vector<std::unique_ptr<FrameContext>> m_Frames;
 	uint32_t m_CurrentImageIndex{0};
-	int m_CurrentFrameIndex;
+	int m_CurrentFrameIndex{ 0 };
+	ResizeStats m_ResizeStats;
+	bool m_IdleOnRecreate{ false };
 	bool m_IsFrameStarted{ false };
 
-	void m_CreateCommandBuffers();
-	void m_FreeCommandBuffers();
+	void m_CreateFrameContexts(uint32_t framesInFlight);
 	void m_RecreateSwapChain();
+	VkFramebuffer m_GetFrameBuffer() const;
 };
 
 
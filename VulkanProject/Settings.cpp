@@ -0,0 +1,151 @@
+#include "Settings.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+static uint32_t parseUnsigned(const std::string& option, const char* value)
+{
+	try {
+		size_t end = 0;
+		unsigned long parsed = std::stoul(value, &end);
+		if (value[end] == '\0') {
+			return static_cast<uint32_t>(parsed);
+		}
+	}
+	catch (const std::exception&) {}
+	throw std::runtime_error("Invalid value for " + option + ": " + value);
+}
+
+static float parseFloat(const std::string& option, const char* value)
+{
+	try {
+		size_t end = 0;
+		float parsed = std::stof(value, &end);
+		if (value[end] == '\0' && parsed >= 0.0f) {
+			return parsed;
+		}
+	}
+	catch (const std::exception&) {}
+	throw std::runtime_error("Invalid value for " + option + ": " + value);
+}
+
+Settings Settings::fromCommandLine(int argc, char* argv[])
+{
+	Settings settings{};
+
+	for (int i = 1; i < argc; i++) {
+		const std::string option = argv[i];
+		auto nextValue = [&]() -> const char* {
+			if (i + 1 >= argc) {
+				throw std::runtime_error("Missing value for " + option);
+			}
+			return argv[++i];
+		};
+
+		if (option == "--headless") {
+			settings.headless = true;
+		}
+		else if (option == "--width") {
+			settings.width = parseUnsigned(option, nextValue());
+		}
+		else if (option == "--height") {
+			settings.height = parseUnsigned(option, nextValue());
+		}
+		else if (option == "--frames-in-flight") {
+			settings.framesInFlight = parseUnsigned(option, nextValue());
+		}
+		else if (option == "--frames") {
+			settings.frameCount = parseUnsigned(option, nextValue());
+		}
+		else if (option == "--capture") {
+			settings.capturePath = nextValue();
+		}
+		else if (option == "--trace") {
+			settings.tracePath = nextValue();
+		}
+		else if (option == "--job-threads") {
+			settings.jobThreads = parseUnsigned(option, nextValue());
+		}
+		else if (option == "--pin-threads") {
+			settings.pinThreads = true;
+		}
+		else if (option == "--parallel-record") {
+			settings.parallelRecord = true;
+		}
+		else if (option == "--bench") {
+			settings.benchmark = nextValue();
+		}
+		else if (option == "--vertex-format") {
+			settings.vertexFormat = nextValue();
+		}
+		else if (option == "--model") {
+			settings.modelPaths.push_back(nextValue());
+		}
+		else if (option == "--lod-error") {
+			settings.lodErrorPixels = parseFloat(option, nextValue());
+		}
+		else if (option == "--meshlets") {
+			settings.meshlets = nextValue();
+		}
+		else if (option == "--backface-culling") {
+			settings.backfaceCulling = true;
+		}
+		else if (option == "--shader-dir") {
+			settings.shaderDirectory = nextValue();
+		}
+		else if (option == "--hot-reload") {
+			settings.hotReload = true;
+		}
+		else if (option == "--help") {
+			printUsage();
+			std::exit(EXIT_SUCCESS);
+		}
+		else {
+			printUsage();
+			throw std::runtime_error("Unknown argument: " + option);
+		}
+	}
+
+	if (settings.width == 0 || settings.height == 0) {
+		throw std::runtime_error("Width and height must be greater than zero");
+	}
+	if (settings.framesInFlight < 1 || settings.framesInFlight > 4) {
+		throw std::runtime_error("--frames-in-flight must be between 1 and 4");
+	}
+	if (!settings.capturePath.empty() && !settings.headless) {
+		throw std::runtime_error("--capture is only supported with --headless");
+	}
+	if (settings.meshlets != "off" && settings.meshlets != "compute" && settings.meshlets != "mesh") {
+		throw std::runtime_error("--meshlets must be off, compute or mesh");
+	}
+	// A headless run has no window to close, so it always has a frame budget
+	if (settings.headless && settings.frameCount == 0) {
+		settings.frameCount = 1;
+	}
+
+	return settings;
+}
+
+void Settings::printUsage()
+{
+	std::cout << "Usage: VulkanProject [options]\n"
+		<< "  --headless         Render offscreen without a window\n"
+		<< "  --width <n>        Framebuffer width (default 1920)\n"
+		<< "  --height <n>       Framebuffer height (default 1080)\n"
+		<< "  --frames <n>       Exit after n frames (headless default 1)\n"
+		<< "  --frames-in-flight <n>  Frames the CPU may run ahead of the GPU, 1 to 4 (default 2)\n"
+		<< "  --capture <file>   Save the last headless frame as a PPM\n"
+		<< "  --trace <file>     Write a Chrome trace of CPU scopes on exit\n"
+		<< "  --job-threads <n>  Job system worker threads (default one per core, less the main thread)\n"
+		<< "  --pin-threads      Lock each job system thread to one core\n"
+		<< "  --parallel-record  Record draws on the job system into secondary command buffers\n"
+		<< "  --vertex-format <name>  Vertex buffer layout: float (default), half or snorm\n"
+		<< "  --model <file>     Stream an OBJ, glTF or GLB mesh into the scene, may be repeated\n"
+		<< "  --lod-error <px>   Screen space error allowed before a finer LOD is drawn (default 1, 0 keeps only lossless LODs)\n"
+		<< "  --meshlets <mode>  Cull models per meshlet: off (default), compute, or mesh for task and mesh shaders where supported\n"
+		<< "  --backface-culling  With --meshlets, cull back faces and whole back facing meshlets\n"
+		<< "  --shader-dir <dir> Directory holding the compiled .spv shaders (default ../shaders)\n"
+		<< "  --hot-reload       Rebuild pipelines while running when their .spv files change\n"
+		<< "  --bench <name>     Run a benchmark and exit: record, jobs, transforms, ecs, meshcache, vertexformats, meshopt, lod, resize, staging\n";
+}
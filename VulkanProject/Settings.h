@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Start-up options, filled from the command line in main
+struct Settings {
+	bool headless = false;			// Render offscreen without a window, surface or swapchain
+	uint32_t width = 1920;
+	uint32_t height = 1080;
+	uint32_t framesInFlight = 2;	// 1 to 4, fewer frames means lower latency, more means higher throughput
+	uint32_t frameCount = 0;		// Frames to render before exiting, 0 runs until the window closes
+	std::string capturePath;		// Headless only, the last frame is saved here as a PPM
+	std::string tracePath;			// CPU trace written on exit, F12 also writes one while running
+	uint32_t jobThreads = 0;		// Job system worker threads besides the main thread, 0 uses one per remaining core
+	bool pinThreads = false;		// Lock each job system thread to its own core
+	bool parallelRecord = false;	// Record draws on the job system into secondary command buffers
+	std::string benchmark;			// Runs the named benchmark instead of the application
+	std::string vertexFormat = "float";	// VertexLayout name: float, half or snorm
+	std::vector<std::string> modelPaths;	// OBJ or glTF files streamed into the scene after start-up
+	float lodErrorPixels = 1.0f;	// Screen space error a LOD may show before a finer one is drawn
+	std::string meshlets = "off";	// Per-meshlet culling of models with meshlets: off, compute, or mesh to use mesh shaders where supported
+	bool backfaceCulling = false;	// With meshlets on, cull back faces and whole back facing meshlets
+	std::string shaderDirectory = "../shaders";	// Where the compiled .spv shaders are read from
+	bool hotReload = false;			// Rebuild pipelines when their .spv files change
+
+	static Settings fromCommandLine(int argc, char* argv[]);
+	static void printUsage();
+};
@@ -0,0 +1,131 @@
+#include "ShaderReloader.h"
+
+#include "Pipeline.h"
+#include "Profiler.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <set>
+#include <utility>
+
+constexpr std::chrono::milliseconds ShaderReloader::POLL_INTERVAL;
+
+ShaderReloader::ShaderReloader(Device& device)
+	: m_Device(device)
+{
+	m_Thread = std::thread(&ShaderReloader::m_WatchLoop, this);
+}
+
+ShaderReloader::~ShaderReloader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_StopMutex);
+		m_Stopping = true;
+	}
+	m_StopCondition.notify_one();
+	m_Thread.join();
+}
+
+void ShaderReloader::m_AddEntry(Entry entry)
+{
+	// Stamped here, on the thread that just created the pipeline, so a rewrite before the next poll still counts
+	std::vector<std::pair<std::string, FileStamp>> stamps;
+	for (const std::string& file : entry.shaderFiles) {
+		stamps.emplace_back(file, m_StampFile(file));
+	}
+
+	std::lock_guard<std::mutex> lock(m_EntryMutex);
+	for (const auto& stamp : stamps) {
+		if (m_Seen.emplace(stamp.first, stamp.second).second) {
+			m_Built[stamp.first] = stamp.second;
+		}
+	}
+	m_Entries.push_back(std::move(entry));
+}
+
+void ShaderReloader::unwatch(const void* owner)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_EntryMutex);
+		m_Entries.erase(std::remove_if(m_Entries.begin(), m_Entries.end(),
+			[owner](const Entry& entry) { return entry.owner == owner; }), m_Entries.end());
+	}
+	std::lock_guard<std::mutex> lock(m_ReadyMutex);
+	m_Ready.erase(std::remove_if(m_Ready.begin(), m_Ready.end(),
+		[owner](const ReadyPipeline& ready) { return ready.owner == owner; }), m_Ready.end());
+}
+
+void ShaderReloader::update()
+{
+	std::vector<ReadyPipeline> ready;
+	{
+		std::lock_guard<std::mutex> lock(m_ReadyMutex);
+		ready.swap(m_Ready);
+	}
+	for (ReadyPipeline& pipeline : ready) {
+		// Frames in flight may still be using the replaced pipeline, it goes when the last reference does
+		std::shared_ptr<void> previous = pipeline.swap();
+		m_Device.deferDestroy([previous]() mutable { previous.reset(); });
+	}
+}
+
+void ShaderReloader::m_WatchLoop()
+{
+	Profiler::setThreadName("Shader Reloader");
+
+	std::unique_lock<std::mutex> stopLock(m_StopMutex);
+	while (!m_StopCondition.wait_for(stopLock, POLL_INTERVAL, [this] { return m_Stopping; })) {
+		stopLock.unlock();
+		{
+			std::lock_guard<std::mutex> lock(m_EntryMutex);
+			std::set<std::string> changed;
+			for (const Entry& entry : m_Entries) {
+				for (const std::string& file : entry.shaderFiles) {
+					const FileStamp stamp = m_StampFile(file);
+					if (stamp != m_Seen[file]) {
+						m_Seen[file] = stamp;
+					}
+					else if (stamp != m_Built[file]) {
+						changed.insert(file);
+					}
+				}
+			}
+
+			for (const std::string& file : changed) {
+				m_Built[file] = m_Seen[file];
+				std::cout << "Shader changed: " << file << std::endl;
+			}
+			for (const Entry& entry : m_Entries) {
+				const bool affected = std::any_of(entry.shaderFiles.begin(), entry.shaderFiles.end(),
+					[&](const std::string& file) { return changed.count(file) > 0; });
+				if (!affected) {
+					continue;
+				}
+				try {
+					PROFILE_SCOPE("Rebuild Pipeline");
+					Swap swap = entry.build();
+					std::lock_guard<std::mutex> readyLock(m_ReadyMutex);
+					m_Ready.push_back({ entry.owner, std::move(swap) });
+				}
+				catch (const std::exception& e) {
+					std::cout << "Shader reload failed, keeping the previous pipeline: " << e.what() << std::endl;
+				}
+			}
+		}
+		stopLock.lock();
+	}
+}
+
+ShaderReloader::FileStamp ShaderReloader::m_StampFile(const std::string& file)
+{
+	struct stat info;
+	FileStamp stamp{};
+	if (stat(Pipeline::shaderPath(file).c_str(), &info) == 0) {
+		stamp.modified = static_cast<int64_t>(info.st_mtime);
+		stamp.size = static_cast<int64_t>(info.st_size);
+	}
+	return stamp;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Device.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Rebuilds pipelines while the application runs when the SPIR-V they were made from changes on disk, so shaders can
+// be iterated on by recompiling them with compile_shader.bat. A background thread polls the watched files, waits for
+// a changed file to stop changing, then builds replacements for every pipeline using it. update() swaps the finished
+// ones in between frames and hands the replaced ones to the Device's deletion queue.
+// A pipeline that fails to build is reported and keeps its previous version.
+class ShaderReloader
+{
+public:
+	static constexpr std::chrono::milliseconds POLL_INTERVAL{ 250 };
+
+	explicit ShaderReloader(Device& device);
+	~ShaderReloader();
+
+	// Not copyable or movable
+	ShaderReloader(const ShaderReloader&) = delete;
+	ShaderReloader& operator=(const ShaderReloader&) = delete;
+
+	// Replaces pipeline with create() whenever one of shaderFiles, names in the shader directory, changes.
+	// create runs on the watcher thread, so it may only read state that stays constant. Call unwatch(owner)
+	// before pipeline or anything create uses is destroyed.
+	template <typename T>
+	void watch(const void* owner, std::unique_ptr<T>& pipeline, const std::vector<std::string>& shaderFiles, std::function<std::unique_ptr<T>()> create)
+	{
+		Entry entry{};
+		entry.owner = owner;
+		entry.shaderFiles = shaderFiles;
+		entry.build = [&pipeline, create]() -> Swap {
+			auto replacement = std::make_shared<std::unique_ptr<T>>(create());
+			return [&pipeline, replacement]() -> std::shared_ptr<void> {
+				std::shared_ptr<void> previous{ std::move(pipeline) };
+				pipeline = std::move(*replacement);
+				return previous;
+			};
+		};
+		m_AddEntry(std::move(entry));
+	}
+	// Waits for a build of one of owner's pipelines to finish, then forgets them and any replacement not yet swapped in
+	void unwatch(const void* owner);
+
+	// Call on the main thread before recording each frame
+	void update();
+
+private:
+	// Puts the new pipeline in place and returns the one it replaced, main thread only
+	using Swap = std::function<std::shared_ptr<void>()>;
+
+	struct Entry {
+		const void* owner;
+		std::vector<std::string> shaderFiles;
+		std::function<Swap()> build;
+	};
+
+	// Modification time and size, stat only reads the directory entry so a compiler writing the file is never blocked
+	struct FileStamp {
+		int64_t modified = 0;
+		int64_t size = -1;		// -1 while the file is missing
+
+		bool operator!=(const FileStamp& other) const { return modified != other.modified || size != other.size; }
+	};
+
+	struct ReadyPipeline {
+		const void* owner;
+		Swap swap;
+	};
+
+	Device& m_Device;
+
+	// Held by the watcher thread while it builds, so unwatch cannot pull an entry out from under it
+	std::mutex m_EntryMutex;
+	std::vector<Entry> m_Entries;
+	// Per shader file, its state at the last poll and the version the pipelines using it were built from.
+	// A change is acted on once a poll finds the file the same as the poll before, a compiler may still be writing it
+	std::unordered_map<std::string, FileStamp> m_Seen;
+	std::unordered_map<std::string, FileStamp> m_Built;
+
+	std::mutex m_ReadyMutex;
+	std::vector<ReadyPipeline> m_Ready;
+
+	std::mutex m_StopMutex;
+	std::condition_variable m_StopCondition;
+	bool m_Stopping{ false };
+
+	std::thread m_Thread;
+
+	void m_AddEntry(Entry entry);
+	void m_WatchLoop();
+	static FileStamp m_StampFile(const std::string& file);
+};
@@ -1,20 +1,69 @@
 #include "SimpleRenderSystem.h"
 
+#include "Profiler.h"
+
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <algorithm>
 #include <stdexcept>
 #include <array>
 #include <cassert>
 
+static constexpr const char* SIMPLE_VERTEX_SHADER = "simple_shader.vert.spv";
+static constexpr const char* SIMPLE_FRAGMENT_SHADER = "simple_shader.frag.spv";
+static constexpr const char* INSTANCED_VERTEX_SHADER = "instanced_shader.vert.spv";
+static constexpr const char* INSTANCED_FRAGMENT_SHADER = "instanced_shader.frag.spv";
+
 struct PushConstantData {
 	glm::mat2 transform{ 1.0f };
 	glm::vec2 offset;
 	alignas(16) glm::vec3 colour;		// Device (GPU) memory as 16 byte aligned for vec3, whereas in host (CPU) this isn't the default
 };
 
+// TransformStore writes the transform and offset of each instance in place
+static_assert(offsetof(SimpleRenderSystem::InstanceData, transform) == offsetof(PackedTransform2D, column0) &&
+	offsetof(SimpleRenderSystem::InstanceData, offset) == offsetof(PackedTransform2D, translation),
+	"InstanceData must start with a PackedTransform2D");
+
+std::vector<VkVertexInputBindingDescription> SimpleRenderSystem::InstanceData::getBindingDescriptions()
+{
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+	bindingDescriptions[0].binding = 1;
+	bindingDescriptions[0].stride = sizeof(InstanceData);
+	bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+	return bindingDescriptions;
+}
+
+std::vector<VkVertexInputAttributeDescription> SimpleRenderSystem::InstanceData::getAttributeDescriptions()
+{
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions(4);
+	// Transform (a mat2 takes one location per column)
+	attributeDescriptions[0].binding = 1;
+	attributeDescriptions[0].location = 2;
+	attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+	attributeDescriptions[0].offset = offsetof(InstanceData, transform);
+	attributeDescriptions[1].binding = 1;
+	attributeDescriptions[1].location = 3;
+	attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
+	attributeDescriptions[1].offset = offsetof(InstanceData, transform) + sizeof(glm::vec2);
+	// Offset
+	attributeDescriptions[2].binding = 1;
+	attributeDescriptions[2].location = 4;
+	attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+	attributeDescriptions[2].offset = offsetof(InstanceData, offset);
+	// Colour
+	attributeDescriptions[3].binding = 1;
+	attributeDescriptions[3].location = 5;
+	attributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
+	attributeDescriptions[3].offset = offsetof(InstanceData, colour);
+
+	return attributeDescriptions;
+}
+
 SimpleRenderSystem::SimpleRenderSystem(Device& device, VkRenderPass renderPass)
 	: m_Device(device)
 {
@@ -24,6 +73,9 @@ SimpleRenderSystem::SimpleRenderSystem(Device& device, VkRenderPass renderPass)
 
 SimpleRenderSystem::~SimpleRenderSystem()
 {
+	if (m_ShaderReloader) {
+		m_ShaderReloader->unwatch(this);
+	}
 	vkDestroyPipelineLayout(m_Device.device(), m_PipelineLayout, nullptr);
 
 } 
@@ -51,33 +103,231 @@ void SimpleRenderSystem::m_CreatePipelineLayout()
 void SimpleRenderSystem::m_CreatePipeline(VkRenderPass& renderPass)
 {
 	assert(m_PipelineLayout != nullptr);
+	m_RenderPass = renderPass;
+	m_Pipeline = m_CreateSimplePipeline();
+	m_InstancedPipeline = m_CreateInstancedPipeline();
+}
 
+void SimpleRenderSystem::enableHotReload(ShaderReloader& shaderReloader)
+{
+	m_ShaderReloader = &shaderReloader;
+	shaderReloader.watch<Pipeline>(this, m_Pipeline, { SIMPLE_VERTEX_SHADER, SIMPLE_FRAGMENT_SHADER },
+		[this] { return m_CreateSimplePipeline(); });
+	shaderReloader.watch<Pipeline>(this, m_InstancedPipeline, { INSTANCED_VERTEX_SHADER, INSTANCED_FRAGMENT_SHADER },
+		[this] { return m_CreateInstancedPipeline(); });
+}
+
+std::unique_ptr<Pipeline> SimpleRenderSystem::m_CreateSimplePipeline() const
+{
 	PipelineConfigInfo pipelineConfig{};
 	Pipeline::defaultPipelineConfigInfo(pipelineConfig);
-	pipelineConfig.renderPass = renderPass;
+	pipelineConfig.renderPass = m_RenderPass;
 	pipelineConfig.pipelineLayout = m_PipelineLayout;
-	m_Pipeline = std::make_unique<Pipeline>(
+	return std::make_unique<Pipeline>(
 		m_Device,
 		pipelineConfig,
-		"C:\\Users\\joebi\\Documents\\Projects\\VulkanProject\\shaders\\simple_shader.vert.spv",
-		"C:\\Users\\joebi\\Documents\\Projects\\VulkanProject\\shaders\\simple_shader.frag.spv"
+		Pipeline::shaderPath(SIMPLE_VERTEX_SHADER),
+		Pipeline::shaderPath(SIMPLE_FRAGMENT_SHADER)
+	);
+}
+
+std::unique_ptr<Pipeline> SimpleRenderSystem::m_CreateInstancedPipeline() const
+{
+	// Same layout and state, plus the per-instance binding
+	PipelineConfigInfo instancedConfig{};
+	Pipeline::defaultPipelineConfigInfo(instancedConfig);
+	auto instanceBindings = InstanceData::getBindingDescriptions();
+	auto instanceAttributes = InstanceData::getAttributeDescriptions();
+	instancedConfig.bindingDescriptions.insert(instancedConfig.bindingDescriptions.end(), instanceBindings.begin(), instanceBindings.end());
+	instancedConfig.attributeDescriptions.insert(instancedConfig.attributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
+	instancedConfig.renderPass = m_RenderPass;
+	instancedConfig.pipelineLayout = m_PipelineLayout;
+	return std::make_unique<Pipeline>(
+		m_Device,
+		instancedConfig,
+		Pipeline::shaderPath(INSTANCED_VERTEX_SHADER),
+		Pipeline::shaderPath(INSTANCED_FRAGMENT_SHADER)
 	);
 }
 
-void SimpleRenderSystem::renderObjects(VkCommandBuffer commandBuffer, std::vector<Object>& objects)
+void SimpleRenderSystem::renderObjects(FrameInfo& frameInfo, const std::vector<RenderableComponent>& objects, const TransformStore& transforms)
+{
+	PROFILE_FUNCTION();
+	const uint32_t instanceCount = m_BuildBatches(objects, transforms, frameInfo.extent);
+
+	// Instance data only lives for this frame, so it comes from the frame's upload arena
+	UploadArena::Slice instanceSlice{};
+	if (instanceCount > 0) {
+		instanceSlice = frameInfo.context.uploadArena().allocate(sizeof(InstanceData) * instanceCount);
+	}
+	m_RecordBatches(frameInfo.commandBuffer, objects, transforms, 0, m_Batches.size(), instanceSlice);
+}
+
+void SimpleRenderSystem::renderObjectsParallel(FrameInfo& frameInfo, const std::vector<RenderableComponent>& objects, const TransformStore& transforms, ThreadPool& threadPool)
+{
+	PROFILE_FUNCTION();
+	m_RecordChunks(frameInfo, objects, transforms, threadPool.threadCount(), [&](uint32_t chunkCount, const ThreadPool::Task& record) {
+		threadPool.run(chunkCount, record);
+	});
+}
+
+void SimpleRenderSystem::renderObjectsParallel(FrameInfo& frameInfo, const std::vector<RenderableComponent>& objects, const TransformStore& transforms, JobSystem& jobSystem)
+{
+	PROFILE_FUNCTION();
+	m_RecordChunks(frameInfo, objects, transforms, jobSystem.workerCount(), [&](uint32_t chunkCount, const ThreadPool::Task& record) {
+		JobSystem::Counter counter;
+		for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+			// Workers index their own command pool, so the index is looked up once the job is running
+			jobSystem.schedule([&, chunk] { record(chunk, jobSystem.currentWorkerIndex()); }, &counter);
+		}
+		jobSystem.wait(counter);
+	});
+}
+
+void SimpleRenderSystem::m_RecordChunks(FrameInfo& frameInfo, const std::vector<RenderableComponent>& objects, const TransformStore& transforms, uint32_t maxChunks,
+	const std::function<void(uint32_t, const ThreadPool::Task&)>& runChunks)
 {
-	m_Pipeline->bind(commandBuffer);
+	const uint32_t instanceCount = m_BuildBatches(objects, transforms, frameInfo.extent);
+	if (m_Batches.empty()) {
+		return;
+	}
+
+	// The arena is not thread safe, so the whole frame's instance data is allocated up front
+	UploadArena::Slice instanceSlice{};
+	if (instanceCount > 0) {
+		instanceSlice = frameInfo.context.uploadArena().allocate(sizeof(InstanceData) * instanceCount);
+	}
 
-	for (auto& object : objects) {
-		object.transfrom2D.rotation = glm::mod(object.transfrom2D.rotation + 0.01f, glm::two_pi<float>());
+	// Cut the batch list into chunks holding roughly the same number of objects
+	const uint32_t chunkCount = std::min(std::max(maxChunks, 1u), static_cast<uint32_t>(m_Batches.size()));
+	const size_t objectsPerChunk = (objects.size() + chunkCount - 1) / chunkCount;
+	std::vector<size_t> chunkStarts{ 0 };
+	size_t objectsInChunk = 0;
+	for (size_t i = 0; i < m_Batches.size(); i++) {
+		if (objectsInChunk >= objectsPerChunk && chunkStarts.size() < chunkCount) {
+			chunkStarts.push_back(i);
+			objectsInChunk = 0;
+		}
+		objectsInChunk += m_Batches[i].end - m_Batches[i].begin;
+	}
+	chunkStarts.push_back(m_Batches.size());
 
-		PushConstantData push{};
-		push.offset = object.transfrom2D.translation;
-		push.colour = object.colour;
-		push.transform = object.transfrom2D.mat2();
+	const uint32_t recordedChunks = static_cast<uint32_t>(chunkStarts.size() - 1);
+	m_SecondaryBuffers.assign(recordedChunks, VK_NULL_HANDLE);
+	runChunks(recordedChunks, [&](uint32_t chunk, uint32_t recordingThread) {
+		PROFILE_SCOPE("Record Secondary");
+		VkCommandBuffer commandBuffer = frameInfo.context.beginSecondaryCommandBuffer(recordingThread);
+		m_RecordBatches(commandBuffer, objects, transforms, chunkStarts[chunk], chunkStarts[chunk + 1], instanceSlice);
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to record secondary command buffer!");
+		}
+		m_SecondaryBuffers[chunk] = commandBuffer;
+	});
+
+	// Executed in chunk order so the draw order matches the single-threaded path
+	vkCmdExecuteCommands(frameInfo.commandBuffer, recordedChunks, m_SecondaryBuffers.data());
+}
+
+uint32_t SimpleRenderSystem::m_BuildBatches(const std::vector<RenderableComponent>& objects, const TransformStore& transforms, VkExtent2D extent)
+{
+	m_ObjectLods.resize(objects.size());
+	const float* scaleX = transforms.scaleX();
+	const float* scaleY = transforms.scaleY();
+	for (size_t i = 0; i < objects.size(); i++) {
+		const Model& model = *objects[i].model;
+		m_ObjectLods[i] = model.getLodCount() > 1 ? model.selectLod(Model::pixelsPerUnit(extent, scaleX[i], scaleY[i]), m_LodErrorPixels) : 0;
+	}
+
+	// Group objects that share a Model and LOD next to each other, keeping their relative order
+	m_DrawOrder.clear();
+	for (uint32_t i = 0; i < objects.size(); i++) {
+		if (!m_SkipMeshletModels || !objects[i].model->hasMeshlets()) {
+			m_DrawOrder.push_back(i);
+		}
+	}
+	std::stable_sort(m_DrawOrder.begin(), m_DrawOrder.end(), [&](uint32_t a, uint32_t b) {
+		const Model* modelA = objects[a].model.get();
+		const Model* modelB = objects[b].model.get();
+		return modelA != modelB ? modelA < modelB : m_ObjectLods[a] < m_ObjectLods[b];
+	});
 
-		vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstantData), &push);
-		object.model->bind(commandBuffer);
-		object.model->draw(commandBuffer);
+	// Find the runs big enough to instance, everything else is drawn one object at a time afterwards
+	m_Batches.clear();
+	std::vector<uint32_t> singles;
+	uint32_t instanceCount = 0;
+	for (uint32_t begin = 0; begin < m_DrawOrder.size();) {
+		uint32_t end = begin + 1;
+		const uint32_t lod = m_ObjectLods[m_DrawOrder[begin]];
+		while (end < m_DrawOrder.size() && objects[m_DrawOrder[end]].model == objects[m_DrawOrder[begin]].model && m_ObjectLods[m_DrawOrder[end]] == lod) {
+			end++;
+		}
+		if (end - begin >= m_MinInstancedBatch) {
+			m_Batches.push_back({ begin, end, instanceCount, lod, true });
+			instanceCount += end - begin;
+		}
+		else {
+			for (uint32_t i = begin; i < end; i++) {
+				singles.push_back(i);
+			}
+		}
+		begin = end;
 	}
-}
\ No newline at end of file
+	for (uint32_t i : singles) {
+		m_Batches.push_back({ i, i + 1, 0, m_ObjectLods[m_DrawOrder[i]], false });
+	}
+
+	return instanceCount;
+}
+
+void SimpleRenderSystem::m_RecordBatches(VkCommandBuffer commandBuffer, const std::vector<RenderableComponent>& objects, const TransformStore& transforms, size_t firstBatch, size_t lastBatch, const UploadArena::Slice& instanceSlice)
+{
+	auto* instances = static_cast<InstanceData*>(instanceSlice.data);
+	Pipeline* boundPipeline = nullptr;
+
+	for (size_t b = firstBatch; b < lastBatch; b++) {
+		const Batch& batch = m_Batches[b];
+
+		if (batch.instanced) {
+			if (boundPipeline != m_InstancedPipeline.get()) {
+				m_InstancedPipeline->bind(commandBuffer);
+				VkBuffer instanceBuffers[] = { instanceSlice.buffer };
+				VkDeviceSize offsets[] = { instanceSlice.offset };
+				vkCmdBindVertexBuffers(commandBuffer, 1, 1, instanceBuffers, offsets);
+				boundPipeline = m_InstancedPipeline.get();
+			}
+
+			const uint32_t batchSize = batch.end - batch.begin;
+			InstanceData* batchInstances = instances + batch.firstInstance;
+			Model* model = objects[m_DrawOrder[batch.begin]].model.get();
+			transforms.buildMatricesIndexed(&m_DrawOrder[batch.begin], batchSize, batchInstances, sizeof(InstanceData), model->getPositionScale());
+			for (uint32_t i = 0; i < batchSize; i++) {
+				batchInstances[i].colour = objects[m_DrawOrder[batch.begin + i]].colour;
+			}
+
+			model->bind(commandBuffer);
+			model->draw(commandBuffer, batch.end - batch.begin, batch.firstInstance, batch.lod);
+		}
+		else {
+			// One-off objects keep the push constant path
+			if (boundPipeline != m_Pipeline.get()) {
+				m_Pipeline->bind(commandBuffer);
+				boundPipeline = m_Pipeline.get();
+			}
+
+			const uint32_t index = m_DrawOrder[batch.begin];
+			auto& object = objects[index];
+			PackedTransform2D transform;
+			transforms.buildMatricesIndexed(&index, 1, &transform, sizeof(transform), object.model->getPositionScale());
+
+			PushConstantData push{};
+			push.transform = { transform.column0, transform.column1 };
+			push.offset = transform.translation;
+			push.colour = object.colour;
+
+			vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstantData), &push);
+			object.model->bind(commandBuffer);
+			object.model->draw(commandBuffer, 1, 0, batch.lod);
+		}
+	}
+}
@@ -2,8 +2,13 @@
 
 #include "Pipeline.h"
 #include "Device.h"
+#include "FrameContext.h"
 #include "Model.h"
-#include "Object.h"
+#include "Components.h"
+#include "TransformStore.h"
+#include "ThreadPool.h"
+#include "JobSystem.h"
+#include "ShaderReloader.h"
 
 #include <memory>
 #include <vector>
@@ -12,6 +17,19 @@
 class SimpleRenderSystem
 {
 public:
+	// Per-instance vertex data read at VK_VERTEX_INPUT_RATE_INSTANCE from binding 1
+	struct InstanceData {
+		glm::mat2 transform;
+		glm::vec2 offset;
+		glm::vec3 colour;
+
+		static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+		static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+	};
+
+	// Objects sharing a Model are drawn instanced once there are at least this many of them
+	static constexpr uint32_t MIN_INSTANCED_BATCH = 2;
+
 	SimpleRenderSystem(Device& device, VkRenderPass renderPass);
 	~SimpleRenderSystem();
 
@@ -19,15 +37,57 @@ public:
 	SimpleRenderSystem(const SimpleRenderSystem&) = delete;
 	SimpleRenderSystem& operator=(const SimpleRenderSystem&) = delete;
 
-	void renderObjects(VkCommandBuffer commandBuffer, std::vector<Object>& objects);
+	// objects[i] is drawn with transforms[i]
+	void renderObjects(FrameInfo& frameInfo, const std::vector<RenderableComponent>& objects, const TransformStore& transforms);
+	// Splits the draws into one chunk per worker, each recorded into its own secondary command buffer.
+	// The render pass must have been begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+	void renderObjectsParallel(FrameInfo& frameInfo, const std::vector<RenderableComponent>& objects, const TransformStore& transforms, ThreadPool& threadPool);
+	// Same, with one chunk per job system worker. Needs a recording thread reserved per worker.
+	void renderObjectsParallel(FrameInfo& frameInfo, const std::vector<RenderableComponent>& objects, const TransformStore& transforms, JobSystem& jobSystem);
+
+	// Rebuilds the pipelines when their shaders change, until this system is destroyed
+	void enableHotReload(ShaderReloader& shaderReloader);
+
+	// Raising this above the largest run of shared models forces one draw per object
+	void setMinInstancedBatch(uint32_t minInstancedBatch) { m_MinInstancedBatch = minInstancedBatch; }
+	// Screen space error allowed when picking each object's LOD
+	void setLodErrorPixels(float lodErrorPixels) { m_LodErrorPixels = lodErrorPixels; }
+	// Leaves models with meshlets to ClusterRenderSystem
+	void setSkipMeshletModels(bool skip) { m_SkipMeshletModels = skip; }
 
 private: 
+	// A run of m_DrawOrder drawn with one instanced draw, or a single object when not instanced
+	struct Batch {
+		uint32_t begin;
+		uint32_t end;
+		uint32_t firstInstance;
+		uint32_t lod;
+		bool instanced;
+	};
 
 	Device& m_Device;
 	std::unique_ptr<Pipeline> m_Pipeline;
+	std::unique_ptr<Pipeline> m_InstancedPipeline;
 	VkPipelineLayout m_PipelineLayout;
+	VkRenderPass m_RenderPass;
+	ShaderReloader* m_ShaderReloader = nullptr;
+	std::vector<uint32_t> m_DrawOrder;
+	std::vector<uint32_t> m_ObjectLods;
+	std::vector<Batch> m_Batches;
+	std::vector<VkCommandBuffer> m_SecondaryBuffers;
+	uint32_t m_MinInstancedBatch{ MIN_INSTANCED_BATCH };
+	float m_LodErrorPixels{ Model::DEFAULT_LOD_ERROR_PIXELS };
+	bool m_SkipMeshletModels = false;
 
 	void m_CreatePipelineLayout();
 	void m_CreatePipeline(VkRenderPass& renderPass);
+	std::unique_ptr<Pipeline> m_CreateSimplePipeline() const;
+	std::unique_ptr<Pipeline> m_CreateInstancedPipeline() const;
+	// Fills m_Batches with instanced batches first, then singles, and returns the total instance count.
+	// Each batch draws one LOD of one Model
+	uint32_t m_BuildBatches(const std::vector<RenderableComponent>& objects, const TransformStore& transforms, VkExtent2D extent);
+	// runChunks(chunkCount, record) must call record(chunk, recordingThread) once for every chunk
+	void m_RecordChunks(FrameInfo& frameInfo, const std::vector<RenderableComponent>& objects, const TransformStore& transforms, uint32_t maxChunks,
+		const std::function<void(uint32_t, const ThreadPool::Task&)>& runChunks);
+	void m_RecordBatches(VkCommandBuffer commandBuffer, const std::vector<RenderableComponent>& objects, const TransformStore& transforms, size_t firstBatch, size_t lastBatch, const UploadArena::Slice& instanceSlice);
 };
-
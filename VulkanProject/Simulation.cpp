@@ -0,0 +1,124 @@
+#include "Simulation.h"
+
+#include "Profiler.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+Simulation::Simulation(JobSystem& jobSystem)
+	: m_JobSystem(jobSystem)
+{
+}
+
+void Simulation::reset(Registry& registry)
+{
+	PROFILE_FUNCTION();
+	m_Entities = registry.pool<RenderableComponent>().entities();
+	m_Current.resize(m_Entities.size());
+	m_Velocities.assign(m_Entities.size(), VelocityComponent{});
+
+	ComponentPool<Transform2DComponent>& transforms = registry.pool<Transform2DComponent>();
+	ComponentPool<VelocityComponent>& velocities = registry.pool<VelocityComponent>();
+	for (size_t i = 0; i < m_Entities.size(); i++) {
+		m_Current.set(i, transforms.get(m_Entities[i]));
+		if (const VelocityComponent* velocity = velocities.tryGet(m_Entities[i])) {
+			m_Velocities[i] = *velocity;
+		}
+	}
+	m_Previous = m_Current;
+	m_Accumulator = 0.0f;
+}
+
+void Simulation::writeBack(Registry& registry) const
+{
+	ComponentPool<Transform2DComponent>& transforms = registry.pool<Transform2DComponent>();
+	for (size_t i = 0; i < m_Entities.size(); i++) {
+		if (Transform2DComponent* transform = transforms.tryGet(m_Entities[i])) {
+			*transform = m_Current.get(i);
+		}
+	}
+}
+
+void Simulation::advance(float frameTime)
+{
+	PROFILE_FUNCTION();
+	m_Accumulator += frameTime;
+
+	uint32_t steps = 0;
+	while (m_Accumulator >= FIXED_TIMESTEP && steps < MAX_STEPS_PER_ADVANCE) {
+		m_Step();
+		m_Accumulator -= FIXED_TIMESTEP;
+		steps++;
+	}
+
+	// Drop whatever could not be caught up on rather than carrying it into the next frame
+	if (steps == MAX_STEPS_PER_ADVANCE && m_Accumulator >= FIXED_TIMESTEP) {
+		m_Accumulator = 0.0f;
+	}
+}
+
+void Simulation::interpolate(TransformStore& transforms) const
+{
+	PROFILE_FUNCTION();
+	transforms.resize(m_Current.size());
+
+	const float alpha = getAlpha();
+	m_JobSystem.parallelFor(m_Current.size(), GRAIN_SIZE, [&](size_t begin, size_t end) {
+		auto mix = [&](const float* previous, const float* current, float* out) {
+			for (size_t i = begin; i < end; i++) {
+				out[i] = previous[i] + (current[i] - previous[i]) * alpha;
+			}
+		};
+		mix(m_Previous.translationX(), m_Current.translationX(), transforms.translationX());
+		mix(m_Previous.translationY(), m_Current.translationY(), transforms.translationY());
+		mix(m_Previous.scaleX(), m_Current.scaleX(), transforms.scaleX());
+		mix(m_Previous.scaleY(), m_Current.scaleY(), transforms.scaleY());
+
+		// Rotation wraps at 2pi, so blend across the shorter way round
+		const float* previousRotation = m_Previous.rotation();
+		const float* currentRotation = m_Current.rotation();
+		float* rotation = transforms.rotation();
+		for (size_t i = begin; i < end; i++) {
+			float delta = currentRotation[i] - previousRotation[i];
+			if (delta > glm::pi<float>()) {
+				delta -= glm::two_pi<float>();
+			}
+			else if (delta < -glm::pi<float>()) {
+				delta += glm::two_pi<float>();
+			}
+			rotation[i] = previousRotation[i] + delta * alpha;
+		}
+	});
+}
+
+void Simulation::m_Step()
+{
+	PROFILE_FUNCTION();
+	// reset keeps both the same size, so every field of the old state can be overwritten in place
+	std::swap(m_Previous, m_Current);
+
+	// Scale carries over, velocity moves translation and rotation
+	m_JobSystem.parallelFor(m_Current.size(), GRAIN_SIZE, [&](size_t begin, size_t end) {
+		const float* previousX = m_Previous.translationX();
+		const float* previousY = m_Previous.translationY();
+		const float* previousScaleX = m_Previous.scaleX();
+		const float* previousScaleY = m_Previous.scaleY();
+		const float* previousRotation = m_Previous.rotation();
+		float* translationX = m_Current.translationX();
+		float* translationY = m_Current.translationY();
+		float* scaleX = m_Current.scaleX();
+		float* scaleY = m_Current.scaleY();
+		float* rotation = m_Current.rotation();
+		for (size_t i = begin; i < end; i++) {
+			const VelocityComponent& velocity = m_Velocities[i];
+			translationX[i] = previousX[i] + velocity.linear.x * FIXED_TIMESTEP;
+			translationY[i] = previousY[i] + velocity.linear.y * FIXED_TIMESTEP;
+			scaleX[i] = previousScaleX[i];
+			scaleY[i] = previousScaleY[i];
+			rotation[i] = glm::mod(previousRotation[i] + velocity.angular * FIXED_TIMESTEP, glm::two_pi<float>());
+		}
+	});
+	m_StepCount++;
+}
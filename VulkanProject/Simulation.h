@@ -0,0 +1,54 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "Components.h"
+#include "Registry.h"
+#include "TransformStore.h"
+
+#include <vector>
+
+// Steps the scene at a fixed rate, independent of the frame rate, and keeps the last two states so
+// rendering can show a blend of them. The simulation never touches the transforms being rendered, it only
+// writes into them in interpolate(), so a step can run on the job system while a frame records.
+class Simulation
+{
+public:
+	static constexpr float FIXED_TIMESTEP = 1.0f / 60.0f;
+	// Caps the catch-up after a long stall, so a slow frame cannot cause an even slower one
+	static constexpr uint32_t MAX_STEPS_PER_ADVANCE = 8;
+
+	explicit Simulation(JobSystem& jobSystem);
+
+	// Not copyable or movable
+	Simulation(const Simulation&) = delete;
+	Simulation& operator=(const Simulation&) = delete;
+
+	// Starts both states from the registry's transforms. Entries follow the RenderableComponent pool's
+	// dense order, so interpolate() output lines up with its components(). Call again after any
+	// renderable, transform or velocity is added or removed, once writeBack has saved the progress.
+	void reset(Registry& registry);
+	// Copies the current state into the Transform2DComponents of the entities it was reset from
+	void writeBack(Registry& registry) const;
+	// Runs as many fixed steps as fit in the accumulated time
+	void advance(float frameTime);
+	// Writes the state between the last two steps into transforms, resized to match the last reset
+	void interpolate(TransformStore& transforms) const;
+
+	uint64_t getStepCount() const { return m_StepCount; }
+	// How far between the previous and current step the next interpolate() lands, 0 to 1
+	float getAlpha() const { return m_Accumulator / FIXED_TIMESTEP; }
+
+private:
+	// Entities per job, small scenes stay on the calling thread
+	static constexpr size_t GRAIN_SIZE = 4096;
+
+	JobSystem& m_JobSystem;
+	std::vector<Entity> m_Entities;
+	TransformStore m_Previous;
+	TransformStore m_Current;
+	std::vector<VelocityComponent> m_Velocities;		// Zero for entities without one
+	float m_Accumulator{ 0.0f };
+	uint64_t m_StepCount{ 0 };
+
+	void m_Step();
+};
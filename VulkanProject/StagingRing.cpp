@@ -0,0 +1,201 @@
+#include "StagingRing.h"
+
+#include "Profiler.h"
+
+#include <cstring>
+#include <stdexcept>
+
+static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+StagingRing::StagingRing(Device& device, VkDeviceSize capacity)
+	: m_Device(device), m_Capacity(capacity)
+{
+	m_Device.createBuffer(
+		m_Capacity,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		m_Buffer,
+		m_Allocation);
+}
+
+StagingRing::~StagingRing()
+{
+	flush();
+	while (!m_InFlight.empty()) {
+		m_Reclaim(true);
+	}
+
+	for (auto& submission : m_FreeSubmissions) {
+		vkFreeCommandBuffers(m_Device.device(), m_Device.getCommandPool(), 1, &submission.commandBuffer);
+	}
+	m_Device.destroyBuffer(m_Buffer, m_Allocation);
+}
+
+uint64_t StagingRing::upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+	if (size > m_Capacity) {
+		m_UploadDirect(dstBuffer, dstOffset, data, size);
+		return 0;
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	const VkDeviceSize offset = m_Reserve(size);
+	memcpy(static_cast<char*>(m_Allocation.mappedData) + offset, data, static_cast<size_t>(size));
+
+	PendingCopy copy{};
+	copy.dstBuffer = dstBuffer;
+	copy.region.srcOffset = offset;
+	copy.region.dstOffset = dstOffset;
+	copy.region.size = size;
+	m_PendingCopies.push_back(copy);
+
+	// m_Reserve may have submitted the earlier copies, this one goes out with the next submission
+	return m_SubmittedSerial + 1;
+}
+
+void StagingRing::flush()
+{
+	PROFILE_FUNCTION();
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Reclaim(false);
+	m_Submit();
+}
+
+bool StagingRing::isComplete(uint64_t ticket)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (ticket <= m_CompletedSerial) {
+		return true;
+	}
+	m_Reclaim(false);
+	return ticket <= m_CompletedSerial;
+}
+
+VkDeviceSize StagingRing::m_Reserve(VkDeviceSize size)
+{
+	while (true) {
+		// Nothing queued or in flight: restart from the beginning of the ring, or a copy that has to wrap may
+		// never fit between the drained tail and the end of the next lap
+		if (m_PendingCopies.empty() && m_InFlight.empty()) {
+			m_Head = (m_Head + m_Capacity - 1) / m_Capacity * m_Capacity;
+			m_Tail = m_Head;
+		}
+
+		uint64_t start = (m_Head + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+
+		// Never split a copy across the end of the ring
+		if (start % m_Capacity + size > m_Capacity) {
+			start += m_Capacity - start % m_Capacity;
+		}
+
+		if (start + size - m_Tail <= m_Capacity) {
+			m_Head = start + size;
+			return start % m_Capacity;
+		}
+
+		// Ring is full: push out what is queued and wait for the oldest copies to retire
+		m_Submit();
+		m_Reclaim(true);
+	}
+}
+
+void StagingRing::m_Submit()
+{
+	if (m_PendingCopies.empty()) {
+		return;
+	}
+
+	Submission submission{};
+	if (!m_FreeSubmissions.empty()) {
+		submission = m_FreeSubmissions.back();
+		m_FreeSubmissions.pop_back();
+	}
+	else {
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = m_Device.getCommandPool();
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(m_Device.device(), &allocInfo, &submission.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate staging command buffer!");
+		}
+	}
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(submission.commandBuffer, &beginInfo);
+
+	for (const auto& copy : m_PendingCopies) {
+		vkCmdCopyBuffer(submission.commandBuffer, m_Buffer, copy.dstBuffer, 1, &copy.region);
+	}
+
+	// Make the copies visible to everything that reads geometry later on this queue
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+		VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(
+		submission.commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		1, &barrier,
+		0, nullptr,
+		0, nullptr);
+
+	vkEndCommandBuffer(submission.commandBuffer);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &submission.commandBuffer;
+
+	submission.timelineValue = m_Device.submit(QueueType::Graphics, submitInfo);
+	submission.ringEnd = m_Head;
+	submission.serial = ++m_SubmittedSerial;
+	m_InFlight.push_back(submission);
+	m_PendingCopies.clear();
+}
+
+void StagingRing::m_Reclaim(bool waitForOldest)
+{
+	if (waitForOldest && !m_InFlight.empty()) {
+		m_Device.waitForTimeline(QueueType::Graphics, m_InFlight.front().timelineValue);
+	}
+
+	const uint64_t completedValue = m_Device.completedValue(QueueType::Graphics);
+	while (!m_InFlight.empty() && m_InFlight.front().timelineValue <= completedValue) {
+		m_Tail = m_InFlight.front().ringEnd;
+		m_CompletedSerial = m_InFlight.front().serial;
+		m_FreeSubmissions.push_back(m_InFlight.front());
+		m_InFlight.pop_front();
+	}
+}
+
+void StagingRing::m_UploadDirect(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+	// Too big for the ring: stage through a temporary buffer and copy synchronously
+	VkBuffer stagingBuffer;
+	Allocation stagingAllocation;
+	m_Device.createBuffer(
+		size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		stagingBuffer,
+		stagingAllocation);
+	memcpy(stagingAllocation.mappedData, data, static_cast<size_t>(size));
+
+	VkCommandBuffer commandBuffer = m_Device.beginSingleTimeCommands();
+	VkBufferCopy copyRegion{};
+	copyRegion.dstOffset = dstOffset;
+	copyRegion.size = size;
+	vkCmdCopyBuffer(commandBuffer, stagingBuffer, dstBuffer, 1, &copyRegion);
+	m_Device.endSingleTimeCommands(commandBuffer);
+
+	m_Device.destroyBuffer(stagingBuffer, stagingAllocation);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Device.h"
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// Persistent host visible ring buffer that batches copies into device local buffers.
+// Uploads are queued with upload() and submitted together by flush(), once per frame.
+// Every upload returns a ticket, the serial of the submission it goes out in, so callers can poll for completion.
+class StagingRing
+{
+public:
+	static constexpr VkDeviceSize DEFAULT_CAPACITY = 16ull * 1024 * 1024;
+
+	StagingRing(Device& device, VkDeviceSize capacity = DEFAULT_CAPACITY);
+	~StagingRing();
+
+	// Not copyable or movable
+	StagingRing(const StagingRing&) = delete;
+	StagingRing& operator=(const StagingRing&) = delete;
+
+	uint64_t upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+	void flush();
+	// True once the submission carrying the ticket's copies has retired, ticket 0 is always complete
+	bool isComplete(uint64_t ticket);
+
+private:
+	struct PendingCopy {
+		VkBuffer dstBuffer;
+		VkBufferCopy region;
+	};
+
+	struct Submission {
+		uint64_t timelineValue;		// On the graphics queue's timeline
+		VkCommandBuffer commandBuffer;
+		uint64_t ringEnd;
+		uint64_t serial;
+	};
+
+	Device& m_Device;
+	VkDeviceSize m_Capacity;
+	VkBuffer m_Buffer;
+	Allocation m_Allocation;
+
+	// Monotonic byte positions; the physical offset is position % capacity
+	uint64_t m_Head{ 0 };
+	uint64_t m_Tail{ 0 };
+
+	// Serial of the last submission handed to the queue and of the last one known to have finished
+	uint64_t m_SubmittedSerial{ 0 };
+	uint64_t m_CompletedSerial{ 0 };
+
+	std::vector<PendingCopy> m_PendingCopies;
+	std::deque<Submission> m_InFlight;
+	std::vector<Submission> m_FreeSubmissions;
+	std::mutex m_Mutex;
+
+	VkDeviceSize m_Reserve(VkDeviceSize size);
+	void m_Submit();
+	void m_Reclaim(bool waitForOldest);
+	void m_UploadDirect(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+};
@@ -1,6 +1,10 @@
 #include "SwapChain.h"
 
+#include "Profiler.h"
+
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
@@ -8,6 +12,19 @@
 #include <set>
 #include <stdexcept>
 
+namespace
+{
+    // Grows size by DEPTH_OVERSIZE and aligns it, never past limit unless size already is
+    uint32_t oversizeDimension(uint32_t size, uint32_t limit)
+    {
+        uint32_t grown = static_cast<uint32_t>(std::ceil(size * SwapChain::DEPTH_OVERSIZE));
+        grown = (grown + SwapChain::DEPTH_SIZE_ALIGNMENT - 1) / SwapChain::DEPTH_SIZE_ALIGNMENT * SwapChain::DEPTH_SIZE_ALIGNMENT;
+        return std::max(size, std::min(grown, limit));
+    }
+}
+
+constexpr float SwapChain::DEPTH_OVERSIZE;
+constexpr uint32_t SwapChain::DEPTH_SIZE_ALIGNMENT;
 
 SwapChain::SwapChain(Device& deviceRef, VkExtent2D extent)
     : device( deviceRef ), windowExtent( extent ) 
@@ -25,49 +42,42 @@ SwapChain::SwapChain(Device& deviceRef, VkExtent2D extent, std::shared_ptr<SwapC
 }
 
 SwapChain::~SwapChain() {
-    for (auto imageView : swapChainImageViews) {
-        vkDestroyImageView(device.device(), imageView, nullptr);
+    // Frames in flight may still be rendering to or presenting these
+    for (auto framebuffer : swapChainFramebuffers) {
+        device.deferDestroyFramebuffer(framebuffer);
     }
-    swapChainImageViews.clear();
 
-    if (swapChain != nullptr) {
-        vkDestroySwapchainKHR(device.device(), swapChain, nullptr);
-        swapChain = nullptr;
+    for (auto imageView : swapChainImageViews) {
+        device.deferDestroyImageView(imageView);
     }
+    swapChainImageViews.clear();
 
     for (int i = 0; i < depthImages.size(); i++) {
-        vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
-        vkDestroyImage(device.device(), depthImages[i], nullptr);
-        vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+        device.deferDestroyImageView(depthImageViews[i]);
+        device.deferDestroyImage(depthImages[i], depthImageAllocations[i]);
     }
 
-    for (auto framebuffer : swapChainFramebuffers) {
-        vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
+    VkDevice vkDevice = device.device();
+    if (swapChain != VK_NULL_HANDLE) {
+        VkSwapchainKHR retired = swapChain;
+        device.deferDestroy([vkDevice, retired]() { vkDestroySwapchainKHR(vkDevice, retired, nullptr); });
+        swapChain = VK_NULL_HANDLE;
     }
 
-    vkDestroyRenderPass(device.device(), renderPass, nullptr);
-
-    // cleanup synchronization objects
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
-        vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(device.device(), inFlightFences[i], nullptr);
+    // Null when the next swap chain took it over
+    if (renderPass != VK_NULL_HANDLE) {
+        VkRenderPass retired = renderPass;
+        device.deferDestroy([vkDevice, retired]() { vkDestroyRenderPass(vkDevice, retired, nullptr); });
     }
 }
 
-VkResult SwapChain::acquireNextImage(uint32_t* imageIndex) {
-    vkWaitForFences(
-        device.device(),
-        1,
-        &inFlightFences[currentFrame],
-        VK_TRUE,
-        std::numeric_limits<uint64_t>::max());
-
+VkResult SwapChain::acquireNextImage(FrameContext& frame, uint32_t* imageIndex) {
+    PROFILE_FUNCTION();
     VkResult result = vkAcquireNextImageKHR(
         device.device(),
         swapChain,
         std::numeric_limits<uint64_t>::max(),
-        imageAvailableSemaphores[currentFrame],  // must be a not signaled semaphore
+        frame.imageAvailableSemaphore(),  // must be a not signaled semaphore
         VK_NULL_HANDLE,
         imageIndex);
 
@@ -75,16 +85,17 @@ VkResult SwapChain::acquireNextImage(uint32_t* imageIndex) {
 }
 
 VkResult SwapChain::submitCommandBuffers(
-    const VkCommandBuffer* buffers, uint32_t* imageIndex) {
-    if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
-        vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
+    const VkCommandBuffer* buffers, uint32_t* imageIndex, FrameContext& frame) {
+    PROFILE_FUNCTION();
+    {
+        PROFILE_SCOPE("Wait For Image Timeline");
+        device.waitForTimeline(QueueType::Graphics, imagesInFlight[*imageIndex]);
     }
-    imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
 
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
+    VkSemaphore waitSemaphores[] = { frame.imageAvailableSemaphore() };
     VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
     submitInfo.waitSemaphoreCount = 1;
     submitInfo.pWaitSemaphores = waitSemaphores;
@@ -93,15 +104,13 @@ VkResult SwapChain::submitCommandBuffers(
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = buffers;
 
-    VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
+    VkSemaphore signalSemaphores[] = { frame.renderFinishedSemaphore() };
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-    if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
-        VK_SUCCESS) {
-        throw std::runtime_error("failed to submit draw command buffer!");
-    }
+    const uint64_t submittedValue = device.submit(QueueType::Graphics, submitInfo);
+    frame.setSubmittedValue(submittedValue);
+    imagesInFlight[*imageIndex] = submittedValue;
 
     VkPresentInfoKHR presentInfo = {};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -115,21 +124,24 @@ VkResult SwapChain::submitCommandBuffers(
 
     presentInfo.pImageIndices = imageIndex;
 
-    auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
-
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    VkResult result;
+    {
+        PROFILE_SCOPE("Present");
+        result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+    }
 
     return result;
 }
 
 void SwapChain::m_Init()
 {
+    PROFILE_FUNCTION();
     createSwapChain();
     createImageViews();
     createRenderPass();
     createDepthResources();
     createFramebuffers();
-    createSyncObjects();
+    createImageTimelines();
 }
 
 void SwapChain::createSwapChain() {
@@ -216,6 +228,15 @@ void SwapChain::createImageViews() {
 }
 
 void SwapChain::createRenderPass() {
+    // Same formats make the old render pass compatible, so it stays valid for pipelines built against it
+    if (m_OldSwapChain != nullptr && m_OldSwapChain->renderPass != VK_NULL_HANDLE &&
+        m_OldSwapChain->swapChainImageFormat == swapChainImageFormat &&
+        m_OldSwapChain->m_SwapChainDepthFormat == findDepthFormat()) {
+        renderPass = m_OldSwapChain->renderPass;
+        m_OldSwapChain->renderPass = VK_NULL_HANDLE;
+        return;
+    }
+
     VkAttachmentDescription depthAttachment{};
     depthAttachment.format = findDepthFormat();
     depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -305,16 +326,31 @@ void SwapChain::createDepthResources() {
     m_SwapChainDepthFormat = findDepthFormat();
     VkExtent2D swapChainExtent = getSwapChainExtent();
 
+    if (takeDepthResources()) {
+        m_AllocatedDepthImages = false;
+        return;
+    }
+
+    // A previous swap chain means a resize, leave room for the window to keep growing
+    m_DepthExtent = swapChainExtent;
+    if (m_OldSwapChain != nullptr) {
+        const VkPhysicalDeviceLimits& limits = device.properties.limits;
+        m_DepthExtent.width = oversizeDimension(
+            swapChainExtent.width, std::min(limits.maxImageDimension2D, limits.maxFramebufferWidth));
+        m_DepthExtent.height = oversizeDimension(
+            swapChainExtent.height, std::min(limits.maxImageDimension2D, limits.maxFramebufferHeight));
+    }
+
     depthImages.resize(imageCount());
-    depthImageMemorys.resize(imageCount());
+    depthImageAllocations.resize(imageCount());
     depthImageViews.resize(imageCount());
 
     for (int i = 0; i < depthImages.size(); i++) {
         VkImageCreateInfo imageInfo{};
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
         imageInfo.imageType = VK_IMAGE_TYPE_2D;
-        imageInfo.extent.width = swapChainExtent.width;
-        imageInfo.extent.height = swapChainExtent.height;
+        imageInfo.extent.width = m_DepthExtent.width;
+        imageInfo.extent.height = m_DepthExtent.height;
         imageInfo.extent.depth = 1;
         imageInfo.mipLevels = 1;
         imageInfo.arrayLayers = 1;
@@ -330,7 +366,7 @@ void SwapChain::createDepthResources() {
             imageInfo,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
             depthImages[i],
-            depthImageMemorys[i]);
+            depthImageAllocations[i]);
 
         VkImageViewCreateInfo viewInfo{};
         viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -349,27 +385,40 @@ void SwapChain::createDepthResources() {
     }
 }
 
-void SwapChain::createSyncObjects() {
-    imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-    imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
-
-    VkSemaphoreCreateInfo semaphoreInfo = {};
-    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-
-    VkFenceCreateInfo fenceInfo = {};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) !=
-            VK_SUCCESS ||
-            vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) !=
-            VK_SUCCESS ||
-            vkCreateFence(device.device(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create synchronization objects for a frame!");
-        }
+bool SwapChain::takeDepthResources() {
+    if (m_OldSwapChain == nullptr || m_OldSwapChain->m_SwapChainDepthFormat != m_SwapChainDepthFormat ||
+        m_OldSwapChain->depthImages.size() < imageCount()) {
+        return false;
+    }
+
+    // Framebuffers may be smaller than their attachments, but far larger images are worth giving back
+    const VkExtent2D extent = getSwapChainExtent();
+    const VkExtent2D oldExtent = m_OldSwapChain->m_DepthExtent;
+    if (oldExtent.width < extent.width || oldExtent.height < extent.height ||
+        oldExtent.width > 2 * extent.width || oldExtent.height > 2 * extent.height) {
+        return false;
+    }
+
+    // Any left over are destroyed with the old swap chain
+    const auto count = static_cast<std::ptrdiff_t>(imageCount());
+    auto take = [count](auto& from, auto& to) {
+        to.assign(from.begin(), from.begin() + count);
+        from.erase(from.begin(), from.begin() + count);
+    };
+    take(m_OldSwapChain->depthImages, depthImages);
+    take(m_OldSwapChain->depthImageAllocations, depthImageAllocations);
+    take(m_OldSwapChain->depthImageViews, depthImageViews);
+    m_DepthExtent = oldExtent;
+    return true;
+}
+
+void SwapChain::createImageTimelines() {
+    imagesInFlight.resize(imageCount(), 0);
+
+    // A frame of the old swap chain may still be writing a depth image that was taken over
+    if (!m_AllocatedDepthImages) {
+        const size_t count = std::min(imagesInFlight.size(), m_OldSwapChain->imagesInFlight.size());
+        std::copy_n(m_OldSwapChain->imagesInFlight.begin(), count, imagesInFlight.begin());
     }
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Device.h"
+#include "FrameContext.h"
 
 // vulkan headers
 #include <vulkan/vulkan.h>
@@ -13,8 +14,14 @@
 
 class SwapChain {
 public:
-    static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
-
+    // While resizing, depth images are allocated this much larger than the swap chain, rounded up to
+    // DEPTH_SIZE_ALIGNMENT, so the next few sizes can reuse them. Only the device's image and framebuffer
+    // limits cap this, the surface's maxImageExtent applies to swap chain images alone
+    static constexpr float DEPTH_OVERSIZE = 1.25f;
+    static constexpr uint32_t DEPTH_SIZE_ALIGNMENT = 64;
+
+    // A previous swap chain is retired through the device's deletion queue instead of waiting for the device to idle,
+    // its render pass and, when they are still large enough, its depth images are taken over
     SwapChain(Device& deviceRef, VkExtent2D windowExtent);
     SwapChain(Device& deviceRef, VkExtent2D windowExtent, std::shared_ptr<SwapChain> previousSwapChain);
     ~SwapChain();
@@ -36,8 +43,12 @@ public:
     }
     VkFormat findDepthFormat();
 
-    VkResult acquireNextImage(uint32_t* imageIndex);
-    VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
+    // The frame must already have been waited on, its semaphores are used for the submit
+    VkResult acquireNextImage(FrameContext& frame, uint32_t* imageIndex);
+    VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex, FrameContext& frame);
+
+    // False when the depth images were taken over from the previous swap chain
+    bool allocatedDepthImages() const { return m_AllocatedDepthImages; }
 
     // Checks if a swapchain is compatible with a render pass
     bool compareSwapFormats(const SwapChain& swapChain) const {
@@ -54,8 +65,10 @@ private:
     VkRenderPass renderPass;
 
     std::vector<VkImage> depthImages;
-    std::vector<VkDeviceMemory> depthImageMemorys;
+    std::vector<Allocation> depthImageAllocations;
     std::vector<VkImageView> depthImageViews;
+    VkExtent2D m_DepthExtent{};         // Size the depth images were allocated at, at least the swap chain extent
+    bool m_AllocatedDepthImages = true;
     std::vector<VkImage> swapChainImages;
     std::vector<VkImageView> swapChainImageViews;
 
@@ -65,19 +78,17 @@ private:
     VkSwapchainKHR swapChain;
     std::shared_ptr<SwapChain> m_OldSwapChain;
 
-    std::vector<VkSemaphore> imageAvailableSemaphores;
-    std::vector<VkSemaphore> renderFinishedSemaphores;
-    std::vector<VkFence> inFlightFences;
-    std::vector<VkFence> imagesInFlight;
-    size_t currentFrame = 0;
+    // Graphics timeline value of the frame that last rendered to each image, frames and images do not cycle in lockstep
+    std::vector<uint64_t> imagesInFlight;
 
     void m_Init();
     void createSwapChain();
     void createImageViews();
     void createDepthResources();
+    bool takeDepthResources();
     void createRenderPass();
     void createFramebuffers();
-    void createSyncObjects();
+    void createImageTimelines();
 
     // Helper functions
     VkSurfaceFormatKHR chooseSwapSurfaceFormat(
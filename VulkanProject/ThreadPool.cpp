@@ -0,0 +1,85 @@
+#include "ThreadPool.h"
+
+#include "Profiler.h"
+
+#include <string>
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	m_Workers.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; i++) {
+		m_Workers.emplace_back(&ThreadPool::m_WorkerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stopping = true;
+	}
+	m_WorkAvailable.notify_all();
+	for (auto& worker : m_Workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::run(uint32_t taskCount, const Task& task)
+{
+	if (taskCount == 0) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Task = &task;
+	m_TaskCount = taskCount;
+	m_NextTask = 0;
+	m_CompletedTasks = 0;
+	m_Exception = nullptr;
+	m_Generation++;
+	m_WorkAvailable.notify_all();
+
+	m_WorkDone.wait(lock, [&] { return m_CompletedTasks == m_TaskCount; });
+	m_Task = nullptr;
+
+	if (m_Exception) {
+		std::rethrow_exception(m_Exception);
+	}
+}
+
+void ThreadPool::m_WorkerLoop(uint32_t workerIndex)
+{
+	Profiler::setThreadName("Worker " + std::to_string(workerIndex));
+
+	uint64_t seenGeneration = 0;
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	while (true) {
+		m_WorkAvailable.wait(lock, [&] { return m_Stopping || m_Generation != seenGeneration; });
+		if (m_Stopping) {
+			return;
+		}
+		seenGeneration = m_Generation;
+
+		while (m_NextTask < m_TaskCount) {
+			const uint32_t taskIndex = m_NextTask++;
+			const Task& task = *m_Task;
+
+			lock.unlock();
+			std::exception_ptr exception;
+			try {
+				task(taskIndex, workerIndex);
+			}
+			catch (...) {
+				exception = std::current_exception();
+			}
+			lock.lock();
+
+			if (exception && !m_Exception) {
+				m_Exception = exception;
+			}
+			if (++m_CompletedTasks == m_TaskCount) {
+				m_WorkDone.notify_one();
+			}
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run a batch of indexed tasks and wait for all of them.
+// Tasks are handed out from one shared counter under a mutex.
+class ThreadPool
+{
+public:
+	// Called as task(taskIndex, workerIndex), workerIndex is stable per thread and below threadCount()
+	using Task = std::function<void(uint32_t, uint32_t)>;
+
+	explicit ThreadPool(uint32_t threadCount);
+	~ThreadPool();
+
+	// Not copyable or movable
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	uint32_t threadCount() const { return static_cast<uint32_t>(m_Workers.size()); }
+
+	// Blocks until every task has run, rethrows the first exception a task threw
+	void run(uint32_t taskCount, const Task& task);
+
+private:
+	std::vector<std::thread> m_Workers;
+	std::mutex m_Mutex;
+	std::condition_variable m_WorkAvailable;
+	std::condition_variable m_WorkDone;
+
+	const Task* m_Task{ nullptr };
+	uint32_t m_TaskCount{ 0 };
+	uint32_t m_NextTask{ 0 };
+	uint32_t m_CompletedTasks{ 0 };
+	uint64_t m_Generation{ 0 };
+	bool m_Stopping{ false };
+	std::exception_ptr m_Exception;
+
+	void m_WorkerLoop(uint32_t workerIndex);
+};
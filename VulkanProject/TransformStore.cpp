@@ -0,0 +1,287 @@
+#include "TransformStore.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TRANSFORM_STORE_AVX2
+#elif defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRANSFORM_STORE_SSE2
+#endif
+
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+	// sincos after Cephes' sinf/cosf: reduce to [-pi/4, pi/4] by octant, then pick the sin or cos
+	// polynomial per lane and fix up the signs. Accurate to a couple of ulp for |x| below ~8192.
+	constexpr float FOUR_OVER_PI = 1.27323954473516f;
+	constexpr float DP1 = -0.78515625f;
+	constexpr float DP2 = -2.4187564849853515625e-4f;
+	constexpr float DP3 = -3.77489497744594108e-8f;
+	constexpr float SIN_P0 = -1.9515295891e-4f;
+	constexpr float SIN_P1 = 8.3321608736e-3f;
+	constexpr float SIN_P2 = -1.6666654611e-1f;
+	constexpr float COS_P0 = 2.443315711809948e-5f;
+	constexpr float COS_P1 = -1.388731625493765e-3f;
+	constexpr float COS_P2 = 4.166664568298827e-2f;
+
+#if defined(TRANSFORM_STORE_SSE2)
+	struct Sse2 {
+		using Float = __m128;
+		using Int = __m128i;
+		static constexpr size_t WIDTH = 4;
+
+		static Float set(float value) { return _mm_set1_ps(value); }
+		static Int seti(int value) { return _mm_set1_epi32(value); }
+		static Float load(const float* data) { return _mm_loadu_ps(data); }
+		static void store(float* data, Float value) { _mm_storeu_ps(data, value); }
+		static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+		static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+		static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+		static Float mulAdd(Float a, Float b, Float c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+		static Float bitAnd(Float a, Float b) { return _mm_and_ps(a, b); }
+		static Float bitAndNot(Float a, Float b) { return _mm_andnot_ps(a, b); }
+		static Float bitOr(Float a, Float b) { return _mm_or_ps(a, b); }
+		static Float bitXor(Float a, Float b) { return _mm_xor_ps(a, b); }
+		static Int truncate(Float value) { return _mm_cvttps_epi32(value); }
+		static Float toFloat(Int value) { return _mm_cvtepi32_ps(value); }
+		static Int addi(Int a, Int b) { return _mm_add_epi32(a, b); }
+		static Int subi(Int a, Int b) { return _mm_sub_epi32(a, b); }
+		static Int andi(Int a, Int b) { return _mm_and_si128(a, b); }
+		static Int andNoti(Int a, Int b) { return _mm_andnot_si128(a, b); }
+		static Int shiftToSign(Int value) { return _mm_slli_epi32(value, 29); }
+		static Float equalMask(Int a, Int b) { return _mm_castsi128_ps(_mm_cmpeq_epi32(a, b)); }
+		static Float asFloat(Int value) { return _mm_castsi128_ps(value); }
+	};
+	using NativeSimd = Sse2;
+#elif defined(TRANSFORM_STORE_AVX2)
+	struct Avx2 {
+		using Float = __m256;
+		using Int = __m256i;
+		static constexpr size_t WIDTH = 8;
+
+		static Float set(float value) { return _mm256_set1_ps(value); }
+		static Int seti(int value) { return _mm256_set1_epi32(value); }
+		static Float load(const float* data) { return _mm256_loadu_ps(data); }
+		static void store(float* data, Float value) { _mm256_storeu_ps(data, value); }
+		static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+		static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+		static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+		static Float mulAdd(Float a, Float b, Float c) { return _mm256_fmadd_ps(a, b, c); }
+		static Float bitAnd(Float a, Float b) { return _mm256_and_ps(a, b); }
+		static Float bitAndNot(Float a, Float b) { return _mm256_andnot_ps(a, b); }
+		static Float bitOr(Float a, Float b) { return _mm256_or_ps(a, b); }
+		static Float bitXor(Float a, Float b) { return _mm256_xor_ps(a, b); }
+		static Int truncate(Float value) { return _mm256_cvttps_epi32(value); }
+		static Float toFloat(Int value) { return _mm256_cvtepi32_ps(value); }
+		static Int addi(Int a, Int b) { return _mm256_add_epi32(a, b); }
+		static Int subi(Int a, Int b) { return _mm256_sub_epi32(a, b); }
+		static Int andi(Int a, Int b) { return _mm256_and_si256(a, b); }
+		static Int andNoti(Int a, Int b) { return _mm256_andnot_si256(a, b); }
+		static Int shiftToSign(Int value) { return _mm256_slli_epi32(value, 29); }
+		static Float equalMask(Int a, Int b) { return _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)); }
+		static Float asFloat(Int value) { return _mm256_castsi256_ps(value); }
+	};
+	using NativeSimd = Avx2;
+#endif
+
+#if defined(TRANSFORM_STORE_SSE2) || defined(TRANSFORM_STORE_AVX2)
+	template <typename S>
+	void sinCos(typename S::Float x, typename S::Float& outSin, typename S::Float& outCos)
+	{
+		using Float = typename S::Float;
+		using Int = typename S::Int;
+
+		const Float signMask = S::asFloat(S::seti(static_cast<int>(0x80000000u)));
+		Float sinSign = S::bitAnd(x, signMask);
+		x = S::bitAndNot(signMask, x);
+
+		// Octant index, rounded up to even so the remainder lands in [-pi/4, pi/4]
+		Int octant = S::truncate(S::mul(x, S::set(FOUR_OVER_PI)));
+		octant = S::andi(S::addi(octant, S::seti(1)), S::seti(~1));
+		const Float y = S::toFloat(octant);
+
+		sinSign = S::bitXor(sinSign, S::asFloat(S::shiftToSign(S::andi(octant, S::seti(4)))));
+		const Float cosSign = S::asFloat(S::shiftToSign(S::andNoti(S::subi(octant, S::seti(2)), S::seti(4))));
+		const Float useSinPoly = S::equalMask(S::andi(octant, S::seti(2)), S::seti(0));
+
+		// Extended precision subtraction of y * pi/4
+		x = S::mulAdd(y, S::set(DP1), x);
+		x = S::mulAdd(y, S::set(DP2), x);
+		x = S::mulAdd(y, S::set(DP3), x);
+		const Float z = S::mul(x, x);
+
+		Float cosPoly = S::mulAdd(S::set(COS_P0), z, S::set(COS_P1));
+		cosPoly = S::mulAdd(cosPoly, z, S::set(COS_P2));
+		cosPoly = S::mul(S::mul(cosPoly, z), z);
+		cosPoly = S::sub(cosPoly, S::mul(z, S::set(0.5f)));
+		cosPoly = S::add(cosPoly, S::set(1.0f));
+
+		Float sinPoly = S::mulAdd(S::set(SIN_P0), z, S::set(SIN_P1));
+		sinPoly = S::mulAdd(sinPoly, z, S::set(SIN_P2));
+		sinPoly = S::mulAdd(S::mul(sinPoly, z), x, x);
+
+		const Float sinValue = S::bitOr(S::bitAnd(useSinPoly, sinPoly), S::bitAndNot(useSinPoly, cosPoly));
+		const Float cosValue = S::bitOr(S::bitAnd(useSinPoly, cosPoly), S::bitAndNot(useSinPoly, sinPoly));
+		outSin = S::bitXor(sinValue, sinSign);
+		outCos = S::bitXor(cosValue, cosSign);
+	}
+#endif
+}
+
+void TransformStore::resize(size_t count)
+{
+	m_TranslationX.resize(count, 0.0f);
+	m_TranslationY.resize(count, 0.0f);
+	m_ScaleX.resize(count, 1.0f);
+	m_ScaleY.resize(count, 1.0f);
+	m_Rotation.resize(count, 0.0f);
+}
+
+void TransformStore::set(size_t index, const Transform2DComponent& transform)
+{
+	m_TranslationX[index] = transform.translation.x;
+	m_TranslationY[index] = transform.translation.y;
+	m_ScaleX[index] = transform.scale.x;
+	m_ScaleY[index] = transform.scale.y;
+	m_Rotation[index] = transform.rotation;
+}
+
+Transform2DComponent TransformStore::get(size_t index) const
+{
+	Transform2DComponent transform{};
+	transform.translation = { m_TranslationX[index], m_TranslationY[index] };
+	transform.scale = { m_ScaleX[index], m_ScaleY[index] };
+	transform.rotation = m_Rotation[index];
+	return transform;
+}
+
+void TransformStore::buildMatrices(size_t first, size_t count, void* out, size_t stride, float matrixScale) const
+{
+	assert(first + count <= size() && "Transform range out of bounds");
+#if defined(TRANSFORM_STORE_SSE2) || defined(TRANSFORM_STORE_AVX2)
+	m_Build<NativeSimd>(nullptr, first, count, static_cast<uint8_t*>(out), stride, matrixScale);
+#else
+	auto* bytes = static_cast<uint8_t*>(out);
+	for (size_t i = 0; i < count; i++) {
+		m_BuildScalar(first + i, bytes + i * stride, matrixScale);
+	}
+#endif
+}
+
+void TransformStore::buildMatricesIndexed(const uint32_t* indices, size_t count, void* out, size_t stride, float matrixScale) const
+{
+#if defined(TRANSFORM_STORE_SSE2) || defined(TRANSFORM_STORE_AVX2)
+	m_Build<NativeSimd>(indices, 0, count, static_cast<uint8_t*>(out), stride, matrixScale);
+#else
+	auto* bytes = static_cast<uint8_t*>(out);
+	for (size_t i = 0; i < count; i++) {
+		m_BuildScalar(indices[i], bytes + i * stride, matrixScale);
+	}
+#endif
+}
+
+void TransformStore::buildMatricesScalar(size_t first, size_t count, void* out, size_t stride) const
+{
+	auto* bytes = static_cast<uint8_t*>(out);
+	for (size_t i = 0; i < count; i++) {
+		m_BuildScalar(first + i, bytes + i * stride);
+	}
+}
+
+void TransformStore::buildMatricesIndexedScalar(const uint32_t* indices, size_t count, void* out, size_t stride) const
+{
+	auto* bytes = static_cast<uint8_t*>(out);
+	for (size_t i = 0; i < count; i++) {
+		m_BuildScalar(indices[i], bytes + i * stride);
+	}
+}
+
+const char* TransformStore::simdName()
+{
+#if defined(TRANSFORM_STORE_AVX2)
+	return "AVX2";
+#elif defined(TRANSFORM_STORE_SSE2)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
+template <typename Simd>
+void TransformStore::m_Build(const uint32_t* indices, size_t first, size_t count, uint8_t* out, size_t stride, float matrixScale) const
+{
+#if defined(TRANSFORM_STORE_SSE2) || defined(TRANSFORM_STORE_AVX2)
+	using Float = typename Simd::Float;
+	constexpr size_t WIDTH = Simd::WIDTH;
+
+	alignas(32) float gathered[5][WIDTH];
+	alignas(32) float lanes[6][WIDTH];
+	const Float matrixScaleLanes = Simd::set(matrixScale);
+
+	size_t i = 0;
+	for (; i + WIDTH <= count; i += WIDTH) {
+		Float translationX, translationY, scaleX, scaleY, rotation;
+		if (indices) {
+			// Scattered objects are gathered into lanes first, sin/cos is still the expensive part
+			for (size_t lane = 0; lane < WIDTH; lane++) {
+				const uint32_t index = indices[i + lane];
+				gathered[0][lane] = m_TranslationX[index];
+				gathered[1][lane] = m_TranslationY[index];
+				gathered[2][lane] = m_ScaleX[index];
+				gathered[3][lane] = m_ScaleY[index];
+				gathered[4][lane] = m_Rotation[index];
+			}
+			translationX = Simd::load(gathered[0]);
+			translationY = Simd::load(gathered[1]);
+			scaleX = Simd::load(gathered[2]);
+			scaleY = Simd::load(gathered[3]);
+			rotation = Simd::load(gathered[4]);
+		}
+		else {
+			translationX = Simd::load(&m_TranslationX[first + i]);
+			translationY = Simd::load(&m_TranslationY[first + i]);
+			scaleX = Simd::load(&m_ScaleX[first + i]);
+			scaleY = Simd::load(&m_ScaleY[first + i]);
+			rotation = Simd::load(&m_Rotation[first + i]);
+		}
+
+		Float sin, cos;
+		sinCos<Simd>(rotation, sin, cos);
+		scaleX = Simd::mul(scaleX, matrixScaleLanes);
+		scaleY = Simd::mul(scaleY, matrixScaleLanes);
+
+		// Same product as Transform2DComponent::mat2, rotation * scale
+		Simd::store(lanes[0], Simd::mul(cos, scaleX));
+		Simd::store(lanes[1], Simd::mul(sin, scaleX));
+		Simd::store(lanes[2], Simd::sub(Simd::set(0.0f), Simd::mul(sin, scaleY)));
+		Simd::store(lanes[3], Simd::mul(cos, scaleY));
+		Simd::store(lanes[4], translationX);
+		Simd::store(lanes[5], translationY);
+
+		for (size_t lane = 0; lane < WIDTH; lane++) {
+			const float packed[6] = { lanes[0][lane], lanes[1][lane], lanes[2][lane], lanes[3][lane], lanes[4][lane], lanes[5][lane] };
+			std::memcpy(out + (i + lane) * stride, packed, sizeof(packed));
+		}
+	}
+
+	for (; i < count; i++) {
+		m_BuildScalar(indices ? indices[i] : first + i, out + i * stride, matrixScale);
+	}
+#endif
+}
+
+void TransformStore::m_BuildScalar(size_t index, uint8_t* out, float matrixScale) const
+{
+	const float sin = glm::sin(m_Rotation[index]);
+	const float cos = glm::cos(m_Rotation[index]);
+	const float scaleX = m_ScaleX[index] * matrixScale;
+	const float scaleY = m_ScaleY[index] * matrixScale;
+
+	PackedTransform2D packed;
+	packed.column0 = { cos * scaleX, sin * scaleX };
+	packed.column1 = { -sin * scaleY, cos * scaleY };
+	packed.translation = { m_TranslationX[index], m_TranslationY[index] };
+	std::memcpy(out, &packed, sizeof(packed));
+}
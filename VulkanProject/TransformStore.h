@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Components.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// A 2D transform as the shaders read it, the mat2 columns followed by the translation.
+// InstanceData and ObjectData both start with this layout.
+struct PackedTransform2D {
+	glm::vec2 column0;
+	glm::vec2 column1;
+	glm::vec2 translation;
+};
+
+// Structure-of-arrays storage for 2D transforms, indexed like the array it was built for. Keeping each component in
+// its own array lets buildMatrices run sin/cos and the matrix product over several transforms at once.
+class TransformStore
+{
+public:
+	size_t size() const { return m_Rotation.size(); }
+	void resize(size_t count);
+
+	void set(size_t index, const Transform2DComponent& transform);
+	Transform2DComponent get(size_t index) const;
+
+	float* translationX() { return m_TranslationX.data(); }
+	float* translationY() { return m_TranslationY.data(); }
+	float* scaleX() { return m_ScaleX.data(); }
+	float* scaleY() { return m_ScaleY.data(); }
+	float* rotation() { return m_Rotation.data(); }
+	const float* translationX() const { return m_TranslationX.data(); }
+	const float* translationY() const { return m_TranslationY.data(); }
+	const float* scaleX() const { return m_ScaleX.data(); }
+	const float* scaleY() const { return m_ScaleY.data(); }
+	const float* rotation() const { return m_Rotation.data(); }
+
+	// Writes a PackedTransform2D for transforms [first, first + count) every stride bytes from out,
+	// so it can fill the transform part of a larger per-instance struct in a mapped buffer.
+	// matrixScale multiplies the mat2 part, used to fold in Model::getPositionScale without reading the output back
+	void buildMatrices(size_t first, size_t count, void* out, size_t stride, float matrixScale = 1.0f) const;
+	// Same for a list of transform indices, written in list order
+	void buildMatricesIndexed(const uint32_t* indices, size_t count, void* out, size_t stride, float matrixScale = 1.0f) const;
+
+	// Reference versions calling glm::sin and glm::cos once per transform, kept for the benchmark
+	void buildMatricesScalar(size_t first, size_t count, void* out, size_t stride) const;
+	void buildMatricesIndexedScalar(const uint32_t* indices, size_t count, void* out, size_t stride) const;
+
+	// Name of the instruction set buildMatrices was compiled for
+	static const char* simdName();
+
+private:
+	std::vector<float> m_TranslationX;
+	std::vector<float> m_TranslationY;
+	std::vector<float> m_ScaleX;
+	std::vector<float> m_ScaleY;
+	std::vector<float> m_Rotation;
+
+	template <typename Simd>
+	void m_Build(const uint32_t* indices, size_t first, size_t count, uint8_t* out, size_t stride, float matrixScale) const;
+	void m_BuildScalar(size_t index, uint8_t* out, float matrixScale = 1.0f) const;
+};
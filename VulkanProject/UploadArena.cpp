@@ -0,0 +1,50 @@
+#include "UploadArena.h"
+
+#include <algorithm>
+
+UploadArena::UploadArena(Device& device, VkDeviceSize capacity, VkBufferUsageFlags usage)
+	: m_Device(device), m_Usage(usage), m_Capacity(capacity)
+{
+	m_Block = m_CreateBlock(m_Capacity);
+}
+
+UploadArena::~UploadArena()
+{
+	reset();
+	m_Device.destroyBuffer(m_Block.buffer, m_Block.allocation);
+}
+
+UploadArena::Slice UploadArena::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+	VkDeviceSize offset = (m_Head + alignment - 1) / alignment * alignment;
+	if (offset + size > m_Capacity) {
+		m_Retired.push_back(m_Block);
+		m_Capacity = std::max(m_Capacity * 2, size);
+		m_Block = m_CreateBlock(m_Capacity);
+		offset = 0;
+	}
+
+	m_Head = offset + size;
+	return { m_Block.buffer, offset, static_cast<char*>(m_Block.allocation.mappedData) + offset };
+}
+
+void UploadArena::reset()
+{
+	for (auto& block : m_Retired) {
+		m_Device.destroyBuffer(block.buffer, block.allocation);
+	}
+	m_Retired.clear();
+	m_Head = 0;
+}
+
+UploadArena::Block UploadArena::m_CreateBlock(VkDeviceSize size)
+{
+	Block block{};
+	m_Device.createBuffer(
+		size,
+		m_Usage,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		block.buffer,
+		block.allocation);
+	return block;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Device.h"
+
+#include <vector>
+
+// Linear allocator over a persistently mapped host visible buffer for data that only lives for one
+// frame (instance data, per-frame uniforms). Everything is released at once by reset(), which the
+// owning FrameContext calls after that frame's timeline value has been reached.
+class UploadArena
+{
+public:
+	struct Slice {
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		void* data;
+	};
+
+	UploadArena(Device& device, VkDeviceSize capacity, VkBufferUsageFlags usage);
+	~UploadArena();
+
+	// Not copyable or movable
+	UploadArena(const UploadArena&) = delete;
+	UploadArena& operator=(const UploadArena&) = delete;
+
+	// Grows into a larger buffer when full, slices handed out earlier in the frame stay valid
+	Slice allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+	void reset();
+
+	VkDeviceSize capacity() const { return m_Capacity; }
+
+private:
+	struct Block {
+		VkBuffer buffer;
+		Allocation allocation;
+	};
+
+	Device& m_Device;
+	VkBufferUsageFlags m_Usage;
+	VkDeviceSize m_Capacity;
+	VkDeviceSize m_Head{ 0 };
+	Block m_Block;
+	std::vector<Block> m_Retired;		// Outgrown blocks still referenced by this frame's commands
+
+	Block m_CreateBlock(VkDeviceSize size);
+};
@@ -0,0 +1,231 @@
+#include "VertexLayout.h"
+
+#include <glm/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	VertexLayout s_ActiveLayout{};
+
+	uint32_t positionSize(VertexLayout::PositionFormat format)
+	{
+		return format == VertexLayout::PositionFormat::Float32 ? sizeof(glm::vec2) : sizeof(uint32_t);
+	}
+
+	VkFormat positionVkFormat(VertexLayout::PositionFormat format)
+	{
+		switch (format) {
+		case VertexLayout::PositionFormat::Half16: return VK_FORMAT_R16G16_SFLOAT;
+		case VertexLayout::PositionFormat::Snorm16: return VK_FORMAT_R16G16_SNORM;
+		default: return VK_FORMAT_R32G32_SFLOAT;
+		}
+	}
+}
+
+VertexLayout VertexLayout::fromName(const std::string& name)
+{
+	VertexLayout layout{};
+	if (name == "float") {
+		return layout;
+	}
+	layout.colour = ColourFormat::Unorm8;
+	if (name == "half") {
+		layout.position = PositionFormat::Half16;
+		return layout;
+	}
+	if (name == "snorm") {
+		layout.position = PositionFormat::Snorm16;
+		return layout;
+	}
+	throw std::runtime_error("Unknown vertex format: " + name);
+}
+
+const char* VertexLayout::name() const
+{
+	if (position == PositionFormat::Half16 && colour == ColourFormat::Unorm8) {
+		return "half";
+	}
+	if (position == PositionFormat::Snorm16 && colour == ColourFormat::Unorm8) {
+		return "snorm";
+	}
+	return position == PositionFormat::Float32 && colour == ColourFormat::Float32 ? "float" : "custom";
+}
+
+const VertexLayout& VertexLayout::active()
+{
+	return s_ActiveLayout;
+}
+
+void VertexLayout::setActive(const VertexLayout& layout)
+{
+	s_ActiveLayout = layout;
+}
+
+uint32_t VertexLayout::stride() const
+{
+	return colourOffset() + (colour == ColourFormat::Float32 ? sizeof(glm::vec3) : sizeof(uint32_t));
+}
+
+uint32_t VertexLayout::colourOffset() const
+{
+	return positionSize(position);
+}
+
+std::vector<VkVertexInputBindingDescription> VertexLayout::getBindingDescriptions() const
+{
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+	bindingDescriptions[0].binding = 0;
+	bindingDescriptions[0].stride = stride();
+	bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	return bindingDescriptions;
+}
+
+std::vector<VkVertexInputAttributeDescription> VertexLayout::getAttributeDescriptions() const
+{
+	// Normalized and half formats arrive in the shader as floats, so the shaders do not change with the layout
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions(2);
+	// Position
+	attributeDescriptions[0].binding = 0;
+	attributeDescriptions[0].location = 0;
+	attributeDescriptions[0].format = positionVkFormat(position);
+	attributeDescriptions[0].offset = 0;
+	// Colour
+	attributeDescriptions[1].binding = 0;
+	attributeDescriptions[1].location = 1;
+	attributeDescriptions[1].format = colour == ColourFormat::Float32 ? VK_FORMAT_R32G32B32_SFLOAT : VK_FORMAT_R8G8B8A8_UNORM;
+	attributeDescriptions[1].offset = colourOffset();
+
+	return attributeDescriptions;
+}
+
+float VertexLayout::positionScale(const Model::Vertex* vertices, size_t count) const
+{
+	if (position != PositionFormat::Snorm16) {
+		return 1.0f;
+	}
+
+	float largest = 0.0f;
+	for (size_t i = 0; i < count; i++) {
+		largest = std::max({ largest, std::abs(vertices[i].position.x), std::abs(vertices[i].position.y) });
+	}
+	return largest > 0.0f ? largest : 1.0f;
+}
+
+void VertexLayout::pack(const Model::Vertex* vertices, size_t count, float scale, void* out) const
+{
+	uint8_t* destination = static_cast<uint8_t*>(out);
+	const uint32_t vertexStride = stride();
+	const uint32_t colourStart = colourOffset();
+
+	for (size_t i = 0; i < count; i++, destination += vertexStride) {
+		const Model::Vertex& vertex = vertices[i];
+
+		if (position == PositionFormat::Float32) {
+			memcpy(destination, &vertex.position, sizeof(glm::vec2));
+		}
+		else {
+			const uint32_t packed = position == PositionFormat::Half16 ?
+				glm::packHalf2x16(vertex.position) : glm::packSnorm2x16(vertex.position / scale);
+			memcpy(destination, &packed, sizeof(packed));
+		}
+
+		if (colour == ColourFormat::Float32) {
+			memcpy(destination + colourStart, &vertex.colour, sizeof(glm::vec3));
+		}
+		else {
+			const uint32_t packed = glm::packUnorm4x8(glm::vec4(vertex.colour, 1.0f));
+			memcpy(destination + colourStart, &packed, sizeof(packed));
+		}
+	}
+}
+
+void VertexLayout::unpack(const void* data, size_t count, float scale, Model::Vertex* out) const
+{
+	const uint8_t* source = static_cast<const uint8_t*>(data);
+	const uint32_t vertexStride = stride();
+	const uint32_t colourStart = colourOffset();
+
+	for (size_t i = 0; i < count; i++, source += vertexStride) {
+		Model::Vertex& vertex = out[i];
+
+		if (position == PositionFormat::Float32) {
+			memcpy(&vertex.position, source, sizeof(glm::vec2));
+		}
+		else {
+			uint32_t packed;
+			memcpy(&packed, source, sizeof(packed));
+			vertex.position = position == PositionFormat::Half16 ?
+				glm::unpackHalf2x16(packed) : glm::unpackSnorm2x16(packed) * scale;
+		}
+
+		if (colour == ColourFormat::Float32) {
+			memcpy(&vertex.colour, source + colourStart, sizeof(glm::vec3));
+		}
+		else {
+			uint32_t packed;
+			memcpy(&packed, source + colourStart, sizeof(packed));
+			vertex.colour = glm::vec3(glm::unpackUnorm4x8(packed));
+		}
+	}
+}
+
+VertexLayout::QuantizationError VertexLayout::measureError(const Model::Vertex* vertices, size_t count) const
+{
+	QuantizationError error{};
+	if (count == 0) {
+		return error;
+	}
+
+	const float scale = positionScale(vertices, count);
+	std::vector<uint8_t> packed(size_t(stride()) * count);
+	std::vector<Model::Vertex> roundTrip(count);
+	pack(vertices, count, scale, packed.data());
+	unpack(packed.data(), count, scale, roundTrip.data());
+
+	double squaredSum = 0.0;
+	for (size_t i = 0; i < count; i++) {
+		const float positionError = glm::length(roundTrip[i].position - vertices[i].position);
+		const glm::vec3 colourError = glm::abs(roundTrip[i].colour - glm::clamp(vertices[i].colour, 0.0f, 1.0f));
+		error.maxPosition = std::max(error.maxPosition, positionError);
+		error.maxColour = std::max({ error.maxColour, colourError.r, colourError.g, colourError.b });
+		squaredSum += double(positionError) * positionError;
+	}
+	error.rmsPosition = static_cast<float>(std::sqrt(squaredSum / count));
+	return error;
+}
+
+glm::vec2 Octahedral::encode(glm::vec3 direction)
+{
+	// Project onto the octahedron |x| + |y| + |z| = 1, then fold the lower half over the diagonals
+	direction /= std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+	glm::vec2 encoded{ direction.x, direction.y };
+	if (direction.z < 0.0f) {
+		const glm::vec2 sign{ encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f };
+		encoded = (1.0f - glm::abs(glm::vec2{ encoded.y, encoded.x })) * sign;
+	}
+	return encoded;
+}
+
+glm::vec3 Octahedral::decode(glm::vec2 encoded)
+{
+	glm::vec3 direction{ encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y) };
+	const float fold = std::max(-direction.z, 0.0f);
+	direction.x += direction.x >= 0.0f ? -fold : fold;
+	direction.y += direction.y >= 0.0f ? -fold : fold;
+	return glm::normalize(direction);
+}
+
+uint32_t Octahedral::pack(glm::vec3 direction)
+{
+	return glm::packSnorm2x16(encode(direction));
+}
+
+glm::vec3 Octahedral::unpack(uint32_t packed)
+{
+	return decode(glm::unpackSnorm2x16(packed));
+}
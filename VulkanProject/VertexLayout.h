@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Model.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// How Model::Vertex is stored in vertex buffers. Builders, loaders and the mesh cache always work with the
+// float Model::Vertex, packing into the active layout happens when the buffers are filled. Pipelines read their
+// vertex input state from the active layout too, so set it once at start-up before any Model or Pipeline exists.
+struct VertexLayout
+{
+	enum class PositionFormat {
+		Float32,	// R32G32_SFLOAT, 8 bytes
+		Half16,		// R16G16_SFLOAT, 4 bytes, error grows with distance from the origin
+		Snorm16,	// R16G16_SNORM, 4 bytes, relative to the model's largest coordinate, see Model::getPositionScale
+	};
+	enum class ColourFormat {
+		Float32,	// R32G32B32_SFLOAT, 12 bytes
+		Unorm8,		// R8G8B8A8_UNORM, 4 bytes
+	};
+
+	PositionFormat position = PositionFormat::Float32;
+	ColourFormat colour = ColourFormat::Float32;
+
+	// Largest error of a layout over a set of vertices, in model space for positions
+	struct QuantizationError {
+		float maxPosition = 0.0f;
+		float rmsPosition = 0.0f;
+		float maxColour = 0.0f;
+	};
+
+	// "float" (the original 20 byte vertex), "half" or "snorm", the last two with 8-bit colours
+	static VertexLayout fromName(const std::string& name);
+	const char* name() const;
+
+	static const VertexLayout& active();
+	static void setActive(const VertexLayout& layout);
+
+	uint32_t stride() const;
+	uint32_t colourOffset() const;
+	std::vector<VkVertexInputBindingDescription> getBindingDescriptions() const;
+	std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions() const;
+
+	// Multiplier that takes stored positions back to model space, 1 unless positions are normalized
+	float positionScale(const Model::Vertex* vertices, size_t count) const;
+	// Writes count vertices, stride() bytes apart, into out
+	void pack(const Model::Vertex* vertices, size_t count, float scale, void* out) const;
+	void unpack(const void* data, size_t count, float scale, Model::Vertex* out) const;
+	// Round trips the vertices through the layout and compares
+	QuantizationError measureError(const Model::Vertex* vertices, size_t count) const;
+
+	bool operator==(const VertexLayout& other) const { return position == other.position && colour == other.colour; }
+};
+
+// Octahedral unit vector encoding: maps a direction onto the [-1, 1] square so a normal fits in two snorm
+// components, 4 bytes at 16 bits each. Nothing draws 3D meshes yet, the encoding is here for when they do.
+namespace Octahedral
+{
+	glm::vec2 encode(glm::vec3 direction);
+	glm::vec3 decode(glm::vec2 encoded);
+	// Both components as R16G16_SNORM
+	uint32_t pack(glm::vec3 direction);
+	glm::vec3 unpack(uint32_t packed);
+}
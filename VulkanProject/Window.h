@@ -20,6 +20,9 @@ public:
 	bool wasWindowResized() { return m_FramebufferResized; };
 	void resetWindowResizedFlag() { m_FramebufferResized = false; }
 	VkExtent2D getExtent() { return { static_cast<uint32_t>(m_Width), static_cast<uint32_t>(m_Height) }; };
+	bool isKeyPressed(int key) { return glfwGetKey(m_Window, key) == GLFW_PRESS; }
+	// The new size arrives through the resize callback on the next poll
+	void setSize(int width, int height) { glfwSetWindowSize(m_Window, width, height); }
 
 private:
 	GLFWwindow* m_Window;
@@ -5,12 +5,23 @@
 #include <stdexcept>
 
 #include "Application.h"
+#include "Benchmarks.h"
+#include "VertexLayout.h"
+#include "Pipeline.h"
 
-int main() {
+int main(int argc, char* argv[]) {
 	std::cout << "Vulkan Application" << std::endl;
 
 	try {
-		Application app;
+		Settings settings = Settings::fromCommandLine(argc, argv);
+		// Before anything creates a Model or a Pipeline
+		VertexLayout::setActive(VertexLayout::fromName(settings.vertexFormat));
+		Pipeline::setShaderDirectory(settings.shaderDirectory);
+		if (!settings.benchmark.empty()) {
+			return Benchmarks::run(settings);
+		}
+
+		Application app{ settings };
 		app.run();
 	}
 	catch (const std::string& error)
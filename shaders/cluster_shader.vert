@@ -0,0 +1,76 @@
+#version 450
+
+layout(location = 0) out vec3 fragColour;
+
+struct ClusterObject {
+	vec4 transform;
+	vec2 offset;
+	float radiusScale;
+	float boundsScale;
+	vec3 colour;
+	uint padding;
+};
+
+struct Meshlet {
+	vec2 center;
+	float radius;
+	float coneCutoff;
+	vec3 coneAxis;
+	uint firstIndex;
+	uint triangleCount;
+	uint vertexOffset;
+	uint vertexCount;
+	uint triangleOffset;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Objects {
+	ClusterObject objects[];
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Meshlets {
+	Meshlet meshlets[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer MeshletVertices {
+	uint meshletVertices[];
+};
+
+// The Model's vertex buffer in the active VertexLayout
+layout(std430, set = 0, binding = 4) readonly buffer Vertices {
+	uint vertexWords[];
+};
+
+layout(push_constant) uniform Push {
+	uint objectBase;
+	uint objectCount;
+	uint meshletCount;
+	uint drawIndex;
+	uint firstObject;
+	uint vertexStride;
+	uint positionFormat;
+	uint backfaceCulling;
+} push;
+
+vec2 loadPosition(uint vertexIndex) {
+	uint word = vertexIndex * push.vertexStride;
+	if (push.positionFormat == 0) {
+		return uintBitsToFloat(uvec2(vertexWords[word], vertexWords[word + 1]));
+	}
+	if (push.positionFormat == 1) {
+		return unpackHalf2x16(vertexWords[word]);
+	}
+	return unpackSnorm2x16(vertexWords[word]);
+}
+
+void main() {
+	// Indices written by cluster_cull.comp, the cluster above the meshlet's local vertex
+	uint cluster = uint(gl_VertexIndex) >> 6;
+	uint local = uint(gl_VertexIndex) & 63;
+	Meshlet meshlet = meshlets[cluster % push.meshletCount];
+	ClusterObject object = objects[push.objectBase + cluster / push.meshletCount];
+
+	vec2 position = loadPosition(meshletVertices[meshlet.vertexOffset + local]);
+	mat2 transform = mat2(object.transform.xy, object.transform.zw);
+	gl_Position = vec4(transform * position + object.offset, 0.0, 1.0);
+	fragColour = object.colour;
+}
@@ -1,3 +1,11 @@
 C:\VulkanSDK\1.4.309.0\Bin\glslc.exe "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\simple_shader.vert" -o "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\simple_shader.vert.spv"
 C:\VulkanSDK\1.4.309.0\Bin\glslc.exe "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\simple_shader.frag" -o "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\simple_shader.frag.spv"
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\instanced_shader.vert" -o "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\instanced_shader.vert.spv"
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\instanced_shader.frag" -o "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\instanced_shader.frag.spv"
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\cull.comp" -o "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\cull.comp.spv"
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\indirect_shader.vert" -o "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\indirect_shader.vert.spv"
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\cluster_cull.comp" -o "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\cluster_cull.comp.spv"
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\cluster_shader.vert" -o "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\cluster_shader.vert.spv"
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe --target-env=vulkan1.2 "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\cluster.task" -o "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\cluster.task.spv"
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe --target-env=vulkan1.2 "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\cluster.mesh" -o "C:\Users\joebi\Documents\Projects\VulkanProject\shaders\cluster.mesh.spv"
 pause
\ No newline at end of file
@@ -0,0 +1,34 @@
+#version 450
+
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec3 colour;
+
+layout(location = 0) out vec3 fragColour;
+
+struct ObjectData {
+	vec4 transform;
+	vec2 offset;
+	float radius;
+	uint drawIndex;
+	vec3 colour;
+	uint visibleBase;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Objects {
+	ObjectData objects[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer Visible {
+	uint visibleIndices[];
+};
+
+layout(push_constant) uniform Push {
+	uint visibleBase;
+} push;
+
+void main() {
+	ObjectData object = objects[visibleIndices[push.visibleBase + gl_InstanceIndex]];
+	mat2 transform = mat2(object.transform.xy, object.transform.zw);
+	gl_Position = vec4(transform * position + object.offset, 0.0, 1.0);
+	fragColour = object.colour;
+}